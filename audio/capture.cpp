@@ -0,0 +1,155 @@
+#include "capture.h"
+#include <cassert>
+#include <string_view>
+#include <emscripten.h>
+#include "encoder.h"
+
+namespace audio {
+
+namespace {
+unsigned int constexpr worker_stack_size{64 * 1024};
+int64_t constexpr drain_interval_ns{10'000'000};                                // 10ms, giving plenty of headroom before a 65536 frame ring fills
+}
+
+capture::capture(unsigned int const this_channels, size_t const ring_frames)
+  : channels{this_channels},
+    ring{ring_frames * this_channels} {
+  /// Preallocate the capture ring, so the audio thread never allocates
+  assert(channels != 0 && "capture requires at least one channel");
+}
+
+void capture::set_sample_rate(unsigned int const new_sample_rate) {
+  sample_rate = new_sample_rate;
+}
+void capture::set_format(formats const new_format) {
+  format = new_format;
+}
+capture::formats capture::get_format() const {
+  return format;
+}
+
+void capture::start() {
+  /// Begin recording the output - main thread only
+  if(state.load(std::memory_order_acquire) != states::idle) return;
+  assert(sample_rate != 0 && "capture sample rate must be set before recording");
+
+  if(!worker) worker = emscripten_malloc_wasm_worker(worker_stack_size);
+  ring.clear();
+  recorded.clear();
+  encoded.clear();
+  recorded_frames.store(0, std::memory_order_relaxed);
+  dropped_frames.store(0, std::memory_order_relaxed);
+  state.store(states::recording, std::memory_order_release);
+
+  emscripten_wasm_worker_post_function_vi(worker, [](int data){
+    /// Worker entry point, running until recording stops
+    reinterpret_cast<capture*>(static_cast<intptr_t>(data))->worker_main();
+  }, static_cast<int>(reinterpret_cast<intptr_t>(this)));
+}
+
+void capture::stop() {
+  /// Stop recording, and let the worker encode what was captured - main thread only
+  states expected{states::recording};
+  state.compare_exchange_strong(expected, states::encoding, std::memory_order_acq_rel);
+}
+
+void capture::push(std::span<AudioSampleFrame const> const outputs) {
+  /// Copy the final mix of the first output into the ring - called on the audio thread, never blocks or allocates
+  if(state.load(std::memory_order_relaxed) != states::recording) return;
+  if(outputs.empty()) return;
+  auto const &output{outputs.front()};
+  auto const frames{static_cast<size_t>(output.samplesPerChannel)};
+  auto const output_channels{static_cast<unsigned int>(output.numberOfChannels)};
+
+  bool const written{ring.write_generate(frames * channels, [&](std::span<float> region, size_t offset){
+    for(size_t i{0}; i != region.size(); ++i) {                                 // interleave from planar, padding any missing channels with silence
+      size_t const frame{(offset + i) / channels};
+      auto const channel{static_cast<unsigned int>((offset + i) % channels)};
+      region[i] = channel < output_channels ? output.data[channel * frames + frame] : 0.0f;
+    }
+  })};
+  if(!written) dropped_frames.fetch_add(frames, std::memory_order_relaxed);
+}
+
+bool capture::poll() {
+  /// Collect a finished recording and offer it to the user as a download - main thread, once per frame
+  /// Returns true if a download was triggered
+  if(state.load(std::memory_order_acquire) != states::ready) return false;
+  download();
+  encoded.clear();
+  encoded.shrink_to_fit();
+  state.store(states::idle, std::memory_order_release);
+  return true;
+}
+
+std::vector<uint8_t> capture::take_encoded() {
+  /// Take ownership of a finished recording instead of downloading it - main thread only
+  if(state.load(std::memory_order_acquire) != states::ready) return {};
+  std::vector<uint8_t> result{std::move(encoded)};
+  encoded.clear();
+  state.store(states::idle, std::memory_order_release);
+  return result;
+}
+
+capture::states capture::get_state() const {
+  return state.load(std::memory_order_acquire);
+}
+
+float capture::get_recorded_seconds() const {
+  if(sample_rate == 0) return 0.0f;
+  return static_cast<float>(recorded_frames.load(std::memory_order_relaxed)) / static_cast<float>(sample_rate);
+}
+
+size_t capture::get_dropped_frames() const {
+  return dropped_frames.load(std::memory_order_relaxed);
+}
+
+void capture::worker_main() {
+  /// Drain the ring on the worker until recording stops, then encode the result in memory
+  while(state.load(std::memory_order_acquire) == states::recording) {
+    drain();
+    emscripten_wasm_worker_sleep(drain_interval_ns);
+  }
+  drain();                                                                      // collect anything written before the stop was observed
+
+  switch(format) {
+  case formats::wav_pcm16:
+    encoded = encoder::wav(recorded, channels, sample_rate, encoder::sample_formats::pcm16);
+    break;
+  case formats::wav_float32:
+    encoded = encoder::wav(recorded, channels, sample_rate, encoder::sample_formats::float32);
+    break;
+  case formats::flac_pcm16:
+    encoded = encoder::flac(recorded, channels, sample_rate);
+    break;
+  }
+  recorded.clear();
+  recorded.shrink_to_fit();                                                     // recordings can be large, don't hold on to the memory
+  state.store(states::ready, std::memory_order_release);
+}
+
+void capture::drain() {
+  /// Move everything currently in the ring to the end of the recording
+  size_t const available{ring.get_size()};
+  if(available == 0) return;
+  size_t const previous_size{recorded.size()};
+  recorded.resize(previous_size + available);
+  ring.read(std::span{recorded}.subspan(previous_size));
+  recorded_frames.store(recorded.size() / channels, std::memory_order_relaxed);
+}
+
+void capture::download() const {
+  /// Hand the encoded file to the browser as a download
+  std::string_view const filename{format == formats::flac_pcm16 ? "capture.flac" : "capture.wav"};
+  std::string_view const mime_type{format == formats::flac_pcm16 ? "audio/flac" : "audio/wav"};
+  EM_ASM({
+    var blob = new Blob([HEAPU8.slice($0, $0 + $1)], {type: UTF8ToString($2, $3)}); // slice copies out of the shared heap, which Blob can't reference directly
+    var link = document.createElement("a");
+    link.href = URL.createObjectURL(blob);
+    link.download = UTF8ToString($4, $5);
+    link.click();
+    setTimeout(() => URL.revokeObjectURL(link.href), 0);
+  }, encoded.data(), encoded.size(), mime_type.data(), mime_type.size(), filename.data(), filename.size());
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <emscripten/wasm_worker.h>
+#include <emscripten/webaudio.h>
+#include "ring_buffer.h"
+
+namespace audio {
+
+class capture {
+  /// Records the final output mix without disturbing the audio worklet:
+  /// the worklet copies each block into a preallocated lock-free ring, a Wasm Worker drains it and encodes the result, and the main thread offers it for download
+public:
+  enum class formats {
+    wav_pcm16,
+    wav_float32,
+    flac_pcm16,
+  };
+
+  enum class states {
+    idle,
+    recording,                                                                  // the audio thread is filling the ring and the worker is draining it
+    encoding,                                                                   // recording stopped, the worker is encoding
+    ready,                                                                      // encoded data is waiting to be collected on the main thread
+  };
+
+private:
+  unsigned int const channels;                                                  // number of channels captured from the first output
+  unsigned int sample_rate{0};
+  formats format{formats::wav_pcm16};
+
+  ring_buffer<float> ring;                                                      // interleaved samples, audio thread to worker
+  std::atomic<states> state{states::idle};
+  std::atomic<size_t> recorded_frames{0};                                       // progress, published by the worker
+  std::atomic<size_t> dropped_frames{0};                                        // frames lost because the worker fell behind
+
+  std::vector<float> recorded;                                                  // owned by the worker while recording
+  std::vector<uint8_t> encoded;                                                 // owned by the worker until ready, then by the main thread
+
+  emscripten_wasm_worker_t worker{0};                                           // created on first use
+
+public:
+  explicit capture(unsigned int channels, size_t ring_frames = 65'536);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void set_format(formats new_format);
+  formats get_format() const;
+
+  void start();
+  void stop();
+
+  void push(std::span<AudioSampleFrame const> outputs);
+
+  bool poll();
+  std::vector<uint8_t> take_encoded();
+
+  states get_state() const;
+  float get_recorded_seconds() const;
+  size_t get_dropped_frames() const;
+
+private:
+  void worker_main();
+  void drain();
+
+  void download() const;
+};
+
+}
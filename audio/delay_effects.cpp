@@ -0,0 +1,323 @@
+#include "delay_effects.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include "denormal.h"
+#include "mix.h"
+
+namespace audio::effects {
+
+namespace {
+
+float lfo_sine(float const phase) {
+  /// Parabolic approximation of one sine cycle over a phase of 0 to 1, smooth enough for delay modulation
+  float const bipolar{phase * 2.0f - 1.0f};
+  return 4.0f * bipolar * (std::abs(bipolar) - 1.0f);
+}
+
+size_t to_samples(float const seconds, float const sample_rate, size_t const max_delay) {
+  /// Convert a delay time to a whole number of samples within the delay line's range
+  return std::clamp(static_cast<size_t>(seconds * sample_rate + 0.5f), size_t{1}, max_delay);
+}
+
+void allocate(std::vector<delay_line> &lines, float const max_time, float const sample_rate) {
+  /// Size every channel's delay line for the longest delay at this sample rate
+  for(auto &line : lines) {
+    line.resize(static_cast<size_t>(std::ceil(max_time * sample_rate)) + 1);
+  }
+}
+
+}
+
+echo::echo(unsigned int const channels, unsigned int const max_frames_per_quantum)
+  : lines(channels),
+    delayed(max_frames_per_quantum),
+    recirculated(max_frames_per_quantum) {
+}
+
+void echo::set_sample_rate(unsigned int const new_sample_rate) {
+  sample_rate = static_cast<float>(new_sample_rate);
+  allocate(lines, max_time, sample_rate);
+}
+void echo::set_enabled(bool const new_enabled) {
+  enabled.store(new_enabled, std::memory_order_relaxed);
+}
+bool echo::is_enabled() const {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void echo::set_parameters(parameters const &params) {
+  /// Change parameters, which take effect from the next quantum - main thread
+  time.store(    std::clamp(params.time, 0.0f, max_time),  std::memory_order_relaxed);
+  feedback.store(std::clamp(params.feedback, 0.0f, 0.99f), std::memory_order_relaxed);
+  mix.store(     params.mix,                               std::memory_order_relaxed);
+}
+echo::parameters echo::get_parameters() const {
+  return {
+    .time{    time.load(    std::memory_order_relaxed)},
+    .feedback{feedback.load(std::memory_order_relaxed)},
+    .mix{     mix.load(     std::memory_order_relaxed)},
+  };
+}
+
+void echo::output(std::span<AudioSampleFrame> const outputs) {
+  /// Add echoes to the first output in place - audio thread
+  if(!is_enabled() || outputs.empty() || sample_rate <= 0.0f) return;
+  auto const &output{outputs.front()};
+  auto const frames{static_cast<size_t>(output.samplesPerChannel)};
+  assert(frames <= delayed.size() && "quantum larger than echo was constructed for");
+  auto const current{get_parameters()};
+  unsigned int const channels{std::min(static_cast<unsigned int>(output.numberOfChannels), static_cast<unsigned int>(lines.size()))};
+
+  for(unsigned int channel{0}; channel != channels; ++channel) {
+    auto &line{lines[channel]};
+    auto const data{mix::channel(output, channel)};
+    size_t const delay{to_samples(current.time, sample_rate, line.get_max_delay())};
+    for(size_t done{0}; done != frames;) {                                      // delays shorter than a quantum are processed in several chunks
+      size_t const chunk{std::min(frames - done, delay)};
+      auto const dry{data.subspan(done, chunk)};
+      auto const delayed_chunk{std::span{delayed}.first(chunk)};
+      auto const recirculated_chunk{std::span{recirculated}.first(chunk)};
+      line.read(delay, delayed_chunk);
+      mix::copy(dry, recirculated_chunk);
+      mix::accumulate(delayed_chunk, recirculated_chunk, current.feedback);
+      for(auto &sample : recirculated_chunk) {                                  // after the input falls silent, the recirculating tail decays towards subnormals
+        sample = denormal::snap(sample);
+      }
+      line.write(recirculated_chunk);
+      mix::accumulate(delayed_chunk, dry, current.mix);
+      done += chunk;
+    }
+  }
+}
+
+chorus::chorus(unsigned int const channels)
+  : lines(channels),
+    phases(channels),
+    allpass_states(channels) {
+  /// Spread the LFO phase evenly across channels
+  for(unsigned int channel{0}; channel != channels; ++channel) {
+    phases[channel] = static_cast<float>(channel) / static_cast<float>(channels) * 0.5f;
+  }
+}
+
+void chorus::set_sample_rate(unsigned int const new_sample_rate) {
+  sample_rate = static_cast<float>(new_sample_rate);
+  allocate(lines, max_time, sample_rate);
+}
+void chorus::set_enabled(bool const new_enabled) {
+  enabled.store(new_enabled, std::memory_order_relaxed);
+}
+bool chorus::is_enabled() const {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void chorus::set_parameters(parameters const &params) {
+  /// Change parameters, which take effect from the next quantum - main thread
+  float const clamped_delay{std::clamp(params.delay, 0.001f, max_time * 0.5f)};
+  rate.store(         params.rate,                                              std::memory_order_relaxed);
+  delay.store(        clamped_delay,                                            std::memory_order_relaxed);
+  depth.store(        std::clamp(params.depth, 0.0f, clamped_delay * 0.9f),     std::memory_order_relaxed);
+  mix.store(          std::clamp(params.mix, 0.0f, 1.0f),                       std::memory_order_relaxed);
+  interpolation.store(params.interpolation,                                     std::memory_order_relaxed);
+}
+chorus::parameters chorus::get_parameters() const {
+  return {
+    .rate{         rate.load(         std::memory_order_relaxed)},
+    .delay{        delay.load(        std::memory_order_relaxed)},
+    .depth{        depth.load(        std::memory_order_relaxed)},
+    .mix{          mix.load(          std::memory_order_relaxed)},
+    .interpolation{interpolation.load(std::memory_order_relaxed)},
+  };
+}
+
+void chorus::output(std::span<AudioSampleFrame> const outputs) {
+  /// Apply chorus to the first output in place - audio thread
+  if(!is_enabled() || outputs.empty() || sample_rate <= 0.0f) return;
+  auto const &output{outputs.front()};
+  auto const current{get_parameters()};
+  float const phase_increment{current.rate / sample_rate};
+  float const centre{current.delay * sample_rate};
+  float const sweep{current.depth * sample_rate};
+  float const max_delay{static_cast<float>(lines.front().get_max_delay() - 1)};
+  unsigned int const channels{std::min(static_cast<unsigned int>(output.numberOfChannels), static_cast<unsigned int>(lines.size()))};
+
+  for(unsigned int channel{0}; channel != channels; ++channel) {
+    auto &line{lines[channel]};
+    float phase{phases[channel]};
+    for(auto &sample : mix::channel(output, channel)) {                         // modulated taps move every sample, so this is inherently scalar
+      float const tap{std::clamp(centre + sweep * lfo_sine(phase), 2.0f, max_delay)};
+      float const wet{line.read(tap, current.interpolation, allpass_states[channel])};
+      line.push(sample);
+      sample += (wet - sample) * current.mix;
+      phase += phase_increment;
+      if(phase >= 1.0f) phase -= 1.0f;
+    }
+    phases[channel] = phase;
+  }
+}
+
+flanger::flanger(unsigned int const channels)
+  : lines(channels),
+    phases(channels),
+    allpass_states(channels) {
+  /// Offset the right channel's sweep slightly for a wider image
+  for(unsigned int channel{0}; channel != channels; ++channel) {
+    phases[channel] = static_cast<float>(channel) / static_cast<float>(channels) * 0.25f;
+  }
+}
+
+void flanger::set_sample_rate(unsigned int const new_sample_rate) {
+  sample_rate = static_cast<float>(new_sample_rate);
+  allocate(lines, max_time, sample_rate);
+}
+void flanger::set_enabled(bool const new_enabled) {
+  enabled.store(new_enabled, std::memory_order_relaxed);
+}
+bool flanger::is_enabled() const {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void flanger::set_parameters(parameters const &params) {
+  /// Change parameters, which take effect from the next quantum - main thread
+  float const clamped_delay{std::clamp(params.delay, 0.0002f, max_time * 0.5f)};
+  rate.store(         params.rate,                                              std::memory_order_relaxed);
+  delay.store(        clamped_delay,                                            std::memory_order_relaxed);
+  depth.store(        std::clamp(params.depth, 0.0f, clamped_delay),            std::memory_order_relaxed);
+  feedback.store(     std::clamp(params.feedback, -0.95f, 0.95f),               std::memory_order_relaxed);
+  mix.store(          std::clamp(params.mix, 0.0f, 1.0f),                       std::memory_order_relaxed);
+  interpolation.store(params.interpolation,                                     std::memory_order_relaxed);
+}
+flanger::parameters flanger::get_parameters() const {
+  return {
+    .rate{         rate.load(         std::memory_order_relaxed)},
+    .delay{        delay.load(        std::memory_order_relaxed)},
+    .depth{        depth.load(        std::memory_order_relaxed)},
+    .feedback{     feedback.load(     std::memory_order_relaxed)},
+    .mix{          mix.load(          std::memory_order_relaxed)},
+    .interpolation{interpolation.load(std::memory_order_relaxed)},
+  };
+}
+
+void flanger::output(std::span<AudioSampleFrame> const outputs) {
+  /// Apply flanging to the first output in place - audio thread
+  if(!is_enabled() || outputs.empty() || sample_rate <= 0.0f) return;
+  auto const &output{outputs.front()};
+  auto const current{get_parameters()};
+  float const phase_increment{current.rate / sample_rate};
+  float const centre{current.delay * sample_rate};
+  float const sweep{current.depth * sample_rate};
+  float const max_delay{static_cast<float>(lines.front().get_max_delay() - 1)};
+  unsigned int const channels{std::min(static_cast<unsigned int>(output.numberOfChannels), static_cast<unsigned int>(lines.size()))};
+
+  for(unsigned int channel{0}; channel != channels; ++channel) {
+    auto &line{lines[channel]};
+    float phase{phases[channel]};
+    for(auto &sample : mix::channel(output, channel)) {
+      float const tap{std::clamp(centre + sweep * lfo_sine(phase), 2.0f, max_delay)};
+      float const wet{line.read(tap, current.interpolation, allpass_states[channel])};
+      line.push(denormal::snap(sample + wet * current.feedback));               // keep the decaying feedback tail out of the subnormal range
+      sample += (wet - sample) * current.mix;
+      phase += phase_increment;
+      if(phase >= 1.0f) phase -= 1.0f;
+    }
+    phases[channel] = phase;
+  }
+}
+
+multi_tap::multi_tap(unsigned int const channels, unsigned int const max_frames_per_quantum)
+  : lines(channels),
+    dry(max_frames_per_quantum) {
+  /// Start with the default tap pattern
+  set_parameters({});
+}
+
+void multi_tap::set_sample_rate(unsigned int const new_sample_rate) {
+  sample_rate = static_cast<float>(new_sample_rate);
+  allocate(lines, max_time, sample_rate);
+}
+void multi_tap::set_enabled(bool const new_enabled) {
+  enabled.store(new_enabled, std::memory_order_relaxed);
+}
+bool multi_tap::is_enabled() const {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void multi_tap::set_parameters(parameters const &params) {
+  /// Change parameters, which take effect from the next quantum - main thread
+  for(unsigned int i{0}; i != max_taps; ++i) {
+    tap_controls[i].time.store(std::clamp(params.taps[i].time, 0.0f, max_time), std::memory_order_relaxed);
+    tap_controls[i].gain.store(params.taps[i].gain,                             std::memory_order_relaxed);
+  }
+  mix.store(params.mix, std::memory_order_relaxed);
+}
+multi_tap::parameters multi_tap::get_parameters() const {
+  parameters params{.mix{mix.load(std::memory_order_relaxed)}};
+  for(unsigned int i{0}; i != max_taps; ++i) {
+    params.taps[i] = {
+      .time{tap_controls[i].time.load(std::memory_order_relaxed)},
+      .gain{tap_controls[i].gain.load(std::memory_order_relaxed)},
+    };
+  }
+  return params;
+}
+
+void multi_tap::output(std::span<AudioSampleFrame> const outputs) {
+  /// Add delayed taps to the first output in place - audio thread
+  if(!is_enabled() || outputs.empty() || sample_rate <= 0.0f) return;
+  auto const &output{outputs.front()};
+  auto const frames{static_cast<size_t>(output.samplesPerChannel)};
+  assert(frames <= dry.size() && "quantum larger than multi_tap was constructed for");
+  auto const current{get_parameters()};
+  unsigned int const channels{std::min(static_cast<unsigned int>(output.numberOfChannels), static_cast<unsigned int>(lines.size()))};
+
+  std::array<size_t, max_taps> delays{};
+  size_t shortest_delay{frames};
+  for(unsigned int i{0}; i != max_taps; ++i) {
+    if(current.taps[i].time <= 0.0f) continue;
+    delays[i] = to_samples(current.taps[i].time, sample_rate, lines.front().get_max_delay());
+    shortest_delay = std::min(shortest_delay, delays[i]);
+  }
+
+  for(unsigned int channel{0}; channel != channels; ++channel) {
+    auto &line{lines[channel]};
+    auto const data{mix::channel(output, channel)};
+    for(size_t done{0}; done != frames;) {
+      size_t const chunk{std::min(frames - done, shortest_delay)};
+      auto const output_chunk{data.subspan(done, chunk)};
+      auto const dry_chunk{std::span{dry}.first(chunk)};
+      mix::copy(output_chunk, dry_chunk);
+      for(unsigned int i{0}; i != max_taps; ++i) {
+        if(delays[i] == 0) continue;
+        line.accumulate(delays[i], output_chunk, current.taps[i].gain * current.mix);
+      }
+      line.write(dry_chunk);
+      done += chunk;
+    }
+  }
+}
+
+chain::chain(unsigned int const channels)
+  : chorus_effect{channels},
+    flanger_effect{channels},
+    echo_effect{channels},
+    multi_tap_effect{channels} {
+}
+
+void chain::set_sample_rate(unsigned int const new_sample_rate) {
+  /// Allocate all delay lines for this sample rate - main thread, before processing starts
+  chorus_effect.set_sample_rate(new_sample_rate);
+  flanger_effect.set_sample_rate(new_sample_rate);
+  echo_effect.set_sample_rate(new_sample_rate);
+  multi_tap_effect.set_sample_rate(new_sample_rate);
+}
+
+void chain::output(std::span<AudioSampleFrame> const outputs) {
+  /// Run all enabled effects over the first output in place - audio thread
+  chorus_effect.output(outputs);
+  flanger_effect.output(outputs);
+  echo_effect.output(outputs);
+  multi_tap_effect.output(outputs);
+}
+
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <span>
+#include <vector>
+#include <emscripten/webaudio.h>
+#include "delay_line.h"
+
+namespace audio::effects {
+
+/// Delay-based effects for the output path, each processing the first output in place
+/// Parameters are set from the main thread at any time; set_sample_rate allocates, and must be called before processing starts
+
+class echo {
+  /// Feedback delay, processed in blocks no longer than the delay so every read is a contiguous vector copy
+public:
+  struct parameters {
+    float time{0.35f};                                                          // in seconds
+    float feedback{0.4f};
+    float mix{0.3f};                                                            // wet level added to the dry signal
+  };
+  static float constexpr max_time{2.0f};
+
+private:
+  std::atomic<bool> enabled{false};
+  std::atomic<float> time{parameters{}.time};
+  std::atomic<float> feedback{parameters{}.feedback};
+  std::atomic<float> mix{parameters{}.mix};
+
+  std::vector<delay_line> lines;                                                // one per channel
+  std::vector<float> delayed;                                                   // preallocated scratch for one quantum
+  std::vector<float> recirculated;
+  float sample_rate{0.0f};
+
+public:
+  explicit echo(unsigned int channels, unsigned int max_frames_per_quantum = 1024);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void set_enabled(bool new_enabled);
+  bool is_enabled() const;
+  void set_parameters(parameters const &params);
+  parameters get_parameters() const;
+
+  void output(std::span<AudioSampleFrame> outputs);
+};
+
+class chorus {
+  /// Short delay swept by a sine LFO, with the LFO phase spread across channels for stereo width
+public:
+  struct parameters {
+    float rate{0.8f};                                                           // LFO rate in Hz
+    float delay{0.015f};                                                        // centre delay in seconds
+    float depth{0.003f};                                                        // sweep either side of the centre delay, in seconds
+    float mix{0.5f};                                                            // crossfade from dry to wet
+    interpolations interpolation{interpolations::cubic};
+  };
+  static float constexpr max_time{0.05f};
+
+private:
+  std::atomic<bool> enabled{false};
+  std::atomic<float> rate{parameters{}.rate};
+  std::atomic<float> delay{parameters{}.delay};
+  std::atomic<float> depth{parameters{}.depth};
+  std::atomic<float> mix{parameters{}.mix};
+  std::atomic<interpolations> interpolation{parameters{}.interpolation};
+
+  std::vector<delay_line> lines;
+  std::vector<float> phases;                                                    // LFO phase per channel
+  std::vector<float> allpass_states;
+  float sample_rate{0.0f};
+
+public:
+  explicit chorus(unsigned int channels);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void set_enabled(bool new_enabled);
+  bool is_enabled() const;
+  void set_parameters(parameters const &params);
+  parameters get_parameters() const;
+
+  void output(std::span<AudioSampleFrame> outputs);
+};
+
+class flanger {
+  /// Very short swept delay with feedback, producing moving comb filter notches
+public:
+  struct parameters {
+    float rate{0.25f};                                                          // LFO rate in Hz
+    float delay{0.0025f};                                                       // centre delay in seconds
+    float depth{0.002f};                                                        // sweep either side of the centre delay, in seconds
+    float feedback{0.5f};                                                       // negative values move the notches
+    float mix{0.5f};
+    interpolations interpolation{interpolations::linear};
+  };
+  static float constexpr max_time{0.02f};
+
+private:
+  std::atomic<bool> enabled{false};
+  std::atomic<float> rate{parameters{}.rate};
+  std::atomic<float> delay{parameters{}.delay};
+  std::atomic<float> depth{parameters{}.depth};
+  std::atomic<float> feedback{parameters{}.feedback};
+  std::atomic<float> mix{parameters{}.mix};
+  std::atomic<interpolations> interpolation{parameters{}.interpolation};
+
+  std::vector<delay_line> lines;
+  std::vector<float> phases;
+  std::vector<float> allpass_states;
+  float sample_rate{0.0f};
+
+public:
+  explicit flanger(unsigned int channels);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void set_enabled(bool new_enabled);
+  bool is_enabled() const;
+  void set_parameters(parameters const &params);
+  parameters get_parameters() const;
+
+  void output(std::span<AudioSampleFrame> outputs);
+};
+
+class multi_tap {
+  /// Several fixed taps from one delay line without feedback, each tap a vectorised block accumulate
+public:
+  static unsigned int constexpr max_taps{4};
+  struct tap {
+    float time{0.0f};                                                           // in seconds, zero disables the tap
+    float gain{0.0f};
+  };
+  struct parameters {
+    std::array<tap, max_taps> taps{{
+      {.time{0.125f}, .gain{0.5f}},
+      {.time{0.25f},  .gain{0.35f}},
+      {.time{0.375f}, .gain{0.25f}},
+      {.time{0.5f},   .gain{0.15f}},
+    }};
+    float mix{0.5f};
+  };
+  static float constexpr max_time{2.0f};
+
+private:
+  struct tap_control {
+    std::atomic<float> time{0.0f};
+    std::atomic<float> gain{0.0f};
+  };
+
+  std::atomic<bool> enabled{false};
+  std::array<tap_control, max_taps> tap_controls;
+  std::atomic<float> mix{parameters{}.mix};
+
+  std::vector<delay_line> lines;
+  std::vector<float> dry;                                                       // preallocated scratch for one quantum
+  float sample_rate{0.0f};
+
+public:
+  explicit multi_tap(unsigned int channels, unsigned int max_frames_per_quantum = 1024);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void set_enabled(bool new_enabled);
+  bool is_enabled() const;
+  void set_parameters(parameters const &params);
+  parameters get_parameters() const;
+
+  void output(std::span<AudioSampleFrame> outputs);
+};
+
+struct chain {
+  /// All delay effects, declared in their fixed processing order
+  chorus chorus_effect;
+  flanger flanger_effect;
+  echo echo_effect;
+  multi_tap multi_tap_effect;
+
+  explicit chain(unsigned int channels);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void output(std::span<AudioSampleFrame> outputs);
+};
+
+}
@@ -0,0 +1,120 @@
+#include "delay_line.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include "denormal.h"
+#include "mix.h"
+
+namespace audio {
+
+delay_line::delay_line(size_t const max_delay) {
+  /// Allocate history for delays of up to max_delay samples
+  resize(max_delay);
+}
+
+void delay_line::resize(size_t const max_delay) {
+  /// Reallocate and clear the history - this allocates, so never call it on the audio thread
+  storage.assign(std::bit_ceil(max_delay + 4), 0.0f);                           // headroom for the extra points read by cubic interpolation
+  mask = storage.size() - 1;
+  position = 0;
+}
+
+void delay_line::clear() {
+  /// Silence the history without reallocating
+  mix::clear(storage);
+}
+
+size_t delay_line::get_max_delay() const {
+  /// Longest delay that can be read with any interpolation
+  return storage.empty() ? 0 : storage.size() - 4;
+}
+
+float delay_line::at(size_t const delay) const {
+  return storage[(position - delay) & mask];
+}
+
+void delay_line::push(float const sample) {
+  /// Write a single sample
+  storage[position & mask] = sample;
+  ++position;
+}
+
+void delay_line::write(std::span<float const> const block) {
+  /// Write a block of samples, as at most two contiguous copies either side of the wrap point
+  assert(block.size() <= storage.size() && "delay line block write larger than its history");
+  size_t const start{position & mask};
+  size_t const first{std::min(block.size(), storage.size() - start)};
+  mix::copy(block.first(first), std::span{storage}.subspan(start, first));
+  mix::copy(block.subspan(first), storage);
+  position += block.size();
+}
+
+void delay_line::read(size_t const delay, std::span<float> const block) const {
+  /// Read a block starting delay samples behind the write head, as at most two contiguous copies
+  assert(delay >= block.size() && "block reads must not overtake the write head");
+  assert(delay <= get_max_delay() && "delay longer than the delay line");
+  size_t const start{(position - delay) & mask};
+  size_t const first{std::min(block.size(), storage.size() - start)};
+  mix::copy(std::span<float const>{storage}.subspan(start, first), block.first(first));
+  mix::copy(storage, block.subspan(first));
+}
+
+void delay_line::accumulate(size_t const delay, std::span<float> const block, float const gain) const {
+  /// Add a block starting delay samples behind the write head into the destination with the given gain, as used by multi-tap delays
+  assert(delay >= block.size() && "block reads must not overtake the write head");
+  assert(delay <= get_max_delay() && "delay longer than the delay line");
+  size_t const start{(position - delay) & mask};
+  size_t const first{std::min(block.size(), storage.size() - start)};
+  mix::accumulate(std::span<float const>{storage}.subspan(start, first), block.first(first), gain);
+  mix::accumulate(storage, block.subspan(first), gain);
+}
+
+float delay_line::read_linear(float const delay) const {
+  /// Read a fractional delay of at least 1 sample, linearly interpolated
+  assert(delay >= 1.0f && static_cast<size_t>(delay) < get_max_delay() && "delay out of range for linear interpolation");
+  auto const whole{static_cast<size_t>(delay)};
+  float const fraction{delay - static_cast<float>(whole)};
+  float const newer{at(whole)};
+  return newer + (at(whole + 1) - newer) * fraction;
+}
+
+float delay_line::read_cubic(float const delay) const {
+  /// Read a fractional delay of at least 2 samples, with four-point Hermite interpolation
+  assert(delay >= 2.0f && static_cast<size_t>(delay) < get_max_delay() && "delay out of range for cubic interpolation");
+  auto const whole{static_cast<size_t>(delay)};
+  float const fraction{delay - static_cast<float>(whole)};
+  float const y0{at(whole - 1)};
+  float const y1{at(whole)};
+  float const y2{at(whole + 1)};
+  float const y3{at(whole + 2)};
+  float const c1{0.5f * (y2 - y0)};
+  float const c2{y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3};
+  float const c3{0.5f * (y3 - y0) + 1.5f * (y1 - y2)};
+  return ((c3 * fraction + c2) * fraction + c1) * fraction + y1;
+}
+
+float delay_line::read_allpass(float const delay, float &state) const {
+  /// Read a fractional delay of at least 1 sample through a first order allpass, which keeps state between calls
+  /// Works best with the fractional part kept away from zero, where the allpass coefficient approaches its pole
+  assert(delay >= 1.0f && static_cast<size_t>(delay) < get_max_delay() && "delay out of range for allpass interpolation");
+  auto const whole{static_cast<size_t>(delay)};
+  float const fraction{delay - static_cast<float>(whole)};
+  float const coefficient{(1.0f - fraction) / (1.0f + fraction)};
+  state = denormal::snap(coefficient * (at(whole) - state) + at(whole + 1));    // the state decays towards subnormals once the line falls silent
+  return state;
+}
+
+float delay_line::read(float const delay, interpolations const interpolation, float &allpass_state) const {
+  /// Read a fractional delay with a runtime choice of interpolation
+  switch(interpolation) {
+  case interpolations::linear:
+    return read_linear(delay);
+  case interpolations::allpass:
+    return read_allpass(delay, allpass_state);
+  case interpolations::cubic:
+    return read_cubic(delay);
+  }
+  return read_linear(delay);
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace audio {
+
+enum class interpolations : uint8_t {
+  linear,                                                                       // cheapest, slight high frequency loss for modulated taps
+  allpass,                                                                      // flat magnitude response, but only suited to slowly changing delays
+  cubic,                                                                        // four-point Hermite, the best quality for fast modulation
+};
+
+class delay_line {
+  /// Circular history of past samples, preallocated to a power of two so wrapping is a mask rather than a modulo
+  /// Delays count samples behind the write head, so a delay of 1 is the newest sample - read before writing the current block
+  std::vector<float> storage;
+  size_t mask{0};
+  size_t position{0};                                                           // total samples written, masked on access
+
+public:
+  delay_line() = default;
+  explicit delay_line(size_t max_delay);
+
+  void resize(size_t max_delay);
+  void clear();
+
+  size_t get_max_delay() const;
+
+  void push(float sample);
+  void write(std::span<float const> block);
+
+  void read(size_t delay, std::span<float> block) const;
+  void accumulate(size_t delay, std::span<float> block, float gain) const;
+
+  float read_linear(float delay) const;
+  float read_cubic(float delay) const;
+  float read_allpass(float delay, float &state) const;
+  float read(float delay, interpolations interpolation, float &allpass_state) const;
+
+private:
+  float at(size_t delay) const;
+};
+
+}
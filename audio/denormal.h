@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cmath>
+#if defined(__SSE__) && !defined(__wasm__)
+  #include <xmmintrin.h>
+#endif
+
+namespace audio::denormal {
+
+float constexpr snap_threshold{1.0e-15f};                                       // about -300dB: far below anything audible, far above the subnormal range starting at 1.2e-38
+
+inline float snap(float const value) {
+  /// Flush a decaying state variable to exact zero before it can become subnormal
+  /// Use this on feedback state (filter memories, envelope levels, smoothed gains) wherever hardware flushing is unavailable
+  return std::abs(value) < snap_threshold ? 0.0f : value;
+}
+
+class scoped_flush {
+  /// Enable flush-to-zero and denormals-are-zero for the lifetime of this object, restoring the previous mode afterwards
+  /// WebAssembly has no floating point control register and requires full IEEE subnormal support, so on wasm this is a
+  /// no-op and state variables must be kept out of the subnormal range with snap() instead
+  #if defined(__SSE__) && !defined(__wasm__)
+    static unsigned int constexpr flush_to_zero{0x8000};                        // MXCSR FTZ bit
+    static unsigned int constexpr denormals_are_zero{0x0040};                   // MXCSR DAZ bit
+    unsigned int saved_control{0};
+    bool const enabled{false};
+  #endif
+
+public:
+  explicit scoped_flush(bool enable = true);
+  ~scoped_flush();
+  scoped_flush(scoped_flush const&) = delete;
+  scoped_flush &operator=(scoped_flush const&) = delete;
+
+  static bool constexpr is_supported() {
+    /// Whether the hardware can flush subnormals on this target
+    #if defined(__SSE__) && !defined(__wasm__)
+      return true;
+    #else
+      return false;
+    #endif
+  }
+};
+
+#if defined(__SSE__) && !defined(__wasm__)
+  inline scoped_flush::scoped_flush(bool const enable)
+    : enabled{enable} {
+    /// Save the control register and set the flush bits
+    if(!enabled) return;
+    saved_control = _mm_getcsr();
+    _mm_setcsr(saved_control | flush_to_zero | denormals_are_zero);
+  }
+
+  inline scoped_flush::~scoped_flush() {
+    /// Restore the previous control register state
+    if(!enabled) return;
+    _mm_setcsr(saved_control);
+  }
+#else
+  inline scoped_flush::scoped_flush(bool /*enable*/) {
+    /// No floating point environment control on this target
+  }
+
+  inline scoped_flush::~scoped_flush() = default;
+#endif
+
+}
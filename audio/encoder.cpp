@@ -0,0 +1,363 @@
+#include "encoder.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+namespace audio::encoder {
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little, "WAV sample data is written directly from memory, which assumes a little-endian target");
+
+void append_le(std::vector<uint8_t> &bytes, uint32_t const value, unsigned int const byte_count) {
+  /// Append an unsigned integer in little-endian byte order
+  for(unsigned int i{0}; i != byte_count; ++i) {
+    bytes.emplace_back(static_cast<uint8_t>(value >> (i * 8)));
+  }
+}
+
+void append_tag(std::vector<uint8_t> &bytes, std::string_view const tag) {
+  /// Append a four-character chunk tag
+  assert(tag.size() == 4);
+  bytes.insert(bytes.end(), tag.begin(), tag.end());
+}
+
+class bit_writer {
+  /// Big-endian bitstream writer, as used by FLAC
+  std::vector<uint8_t> &bytes;
+  uint64_t accumulator{0};
+  unsigned int accumulated_bits{0};                                             // always less than 8 between calls
+
+public:
+  explicit bit_writer(std::vector<uint8_t> &this_bytes)
+    : bytes{this_bytes} {
+  }
+
+  void write(uint32_t const value, unsigned int const bits) {
+    /// Write the low bits of a value, most significant first
+    assert(bits <= 32);
+    if(bits == 0) return;
+    accumulator = (accumulator << bits) | (value & (0xFF'FF'FF'FFu >> (32 - bits)));
+    accumulated_bits += bits;
+    while(accumulated_bits >= 8) {
+      accumulated_bits -= 8;
+      bytes.emplace_back(static_cast<uint8_t>(accumulator >> accumulated_bits));
+    }
+  }
+
+  void write_signed(int32_t const value, unsigned int const bits) {
+    /// Write a two's complement signed value in the given number of bits
+    write(static_cast<uint32_t>(value), bits);
+  }
+
+  void write_unary(uint32_t zeros) {
+    /// Write a run of zeros terminated by a one
+    while(zeros >= 32) {
+      write(0, 32);
+      zeros -= 32;
+    }
+    write(1, zeros + 1);
+  }
+
+  void align() {
+    /// Zero-pad to the next byte boundary
+    if(accumulated_bits != 0) write(0, 8 - accumulated_bits);
+  }
+};
+
+uint8_t crc8(std::span<uint8_t const> const bytes) {
+  /// CRC-8 with polynomial x^8 + x^2 + x + 1, as used for FLAC frame headers
+  uint8_t crc{0};
+  for(auto const byte : bytes) {
+    crc ^= byte;
+    for(unsigned int bit{0}; bit != 8; ++bit) {
+      crc = static_cast<uint8_t>((crc & 0x80u) ? (crc << 1) ^ 0x07u : crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint16_t crc16(std::span<uint8_t const> const bytes) {
+  /// CRC-16 with polynomial x^16 + x^15 + x^2 + 1, as used for FLAC frames
+  uint16_t crc{0};
+  for(auto const byte : bytes) {
+    crc ^= static_cast<uint16_t>(byte << 8);
+    for(unsigned int bit{0}; bit != 8; ++bit) {
+      crc = static_cast<uint16_t>((crc & 0x80'00u) ? (crc << 1) ^ 0x80'05u : crc << 1);
+    }
+  }
+  return crc;
+}
+
+void write_utf8_coded(bit_writer &writer, uint32_t const value) {
+  /// Write a frame number using FLAC's extended UTF-8 style variable-length coding
+  if(value < 0x80u) {
+    writer.write(value, 8);
+    return;
+  }
+  unsigned int continuation_bytes{1};
+  while(continuation_bytes != 5 && value >= (1u << (5 * continuation_bytes + 6))) {
+    ++continuation_bytes;
+  }
+  uint32_t const lead_marker{(0xFF'00u >> (continuation_bytes + 1)) & 0xFFu};
+  writer.write(lead_marker | (value >> (6 * continuation_bytes)), 8);
+  for(unsigned int i{continuation_bytes}; i != 0; --i) {
+    writer.write(0x80u | ((value >> (6 * (i - 1))) & 0x3Fu), 8);
+  }
+}
+
+void write_subframe(bit_writer &writer, std::span<int32_t const> const samples, std::vector<int32_t> &residuals) {
+  /// Encode one channel of one block as the cheapest of a constant, fixed-predictor or verbatim subframe
+  unsigned int constexpr bits_per_sample{16};
+  size_t const block_size{samples.size()};
+
+  if(std::ranges::all_of(samples, [&](int32_t sample){return sample == samples.front();})) { // silence and DC compress to a single value
+    writer.write(0, 1);                                                         // zero padding
+    writer.write(0b000000, 6);                                                  // SUBFRAME_CONSTANT
+    writer.write(0, 1);                                                         // no wasted bits
+    writer.write_signed(samples.front(), bits_per_sample);
+    return;
+  }
+
+  // pick the fixed polynomial predictor order with the smallest total residual magnitude
+  unsigned int constexpr max_order{4};
+  unsigned int best_order{0};
+  uint64_t best_magnitude{std::numeric_limits<uint64_t>::max()};
+  auto const residual{[&](unsigned int order, size_t i)->int32_t {
+    switch(order) {
+    case 0:
+      return samples[i];
+    case 1:
+      return samples[i] - samples[i - 1];
+    case 2:
+      return samples[i] - 2 * samples[i - 1] + samples[i - 2];
+    case 3:
+      return samples[i] - 3 * samples[i - 1] + 3 * samples[i - 2] - samples[i - 3];
+    default:
+      return samples[i] - 4 * samples[i - 1] + 6 * samples[i - 2] - 4 * samples[i - 3] + samples[i - 4];
+    }
+  }};
+  for(unsigned int order{0}; order <= std::min<size_t>(max_order, block_size - 1); ++order) {
+    uint64_t magnitude{0};
+    for(size_t i{order}; i != block_size; ++i) {
+      magnitude += static_cast<uint64_t>(std::abs(residual(order, i)));
+    }
+    if(magnitude < best_magnitude) {
+      best_magnitude = magnitude;
+      best_order = order;
+    }
+  }
+
+  residuals.clear();
+  uint64_t folded_sum{0};
+  for(size_t i{best_order}; i != block_size; ++i) {
+    int32_t const value{residual(best_order, i)};
+    residuals.emplace_back(value);
+    folded_sum += (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+  }
+
+  // estimate the Rice parameter from the mean folded residual, then refine it by exact size
+  auto const rice_bits{[&](unsigned int parameter){
+    uint64_t bits{residuals.size() * (parameter + 1)};
+    for(auto const value : residuals) {
+      bits += ((static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31)) >> parameter;
+    }
+    return bits;
+  }};
+  unsigned int constexpr max_rice_parameter{14};                                // 15 is reserved as the escape code
+  unsigned int const estimate{std::min(max_rice_parameter, static_cast<unsigned int>(std::bit_width(folded_sum / std::max<size_t>(residuals.size(), 1))))};
+  unsigned int rice_parameter{estimate};
+  uint64_t rice_size{rice_bits(estimate)};
+  for(unsigned int const candidate : {estimate - 1, estimate + 1}) {
+    if(candidate > max_rice_parameter) continue;                                // also rejects the wrapped-around estimate - 1 when estimate is 0
+    if(uint64_t const size{rice_bits(candidate)}; size < rice_size) {
+      rice_size = size;
+      rice_parameter = candidate;
+    }
+  }
+
+  if(rice_size + best_order * bits_per_sample >= block_size * bits_per_sample) { // incompressible, e.g. noise
+    writer.write(0, 1);                                                         // zero padding
+    writer.write(0b000001, 6);                                                  // SUBFRAME_VERBATIM
+    writer.write(0, 1);                                                         // no wasted bits
+    for(auto const sample : samples) {
+      writer.write_signed(sample, bits_per_sample);
+    }
+    return;
+  }
+
+  writer.write(0, 1);                                                           // zero padding
+  writer.write(0b001000u | best_order, 6);                                      // SUBFRAME_FIXED with predictor order
+  writer.write(0, 1);                                                           // no wasted bits
+  for(size_t i{0}; i != best_order; ++i) {
+    writer.write_signed(samples[i], bits_per_sample);                           // warm-up samples
+  }
+  writer.write(0b00, 2);                                                        // residual coding method: Rice with 4-bit parameters
+  writer.write(0, 4);                                                           // partition order 0: a single partition
+  writer.write(rice_parameter, 4);
+  for(auto const value : residuals) {
+    uint32_t const folded{(static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31)}; // zigzag: interleave positive and negative values
+    writer.write_unary(folded >> rice_parameter);
+    writer.write(folded, rice_parameter);
+  }
+}
+
+}
+
+tpdf_dither::tpdf_dither(uint32_t const seed)
+  : state{seed == 0 ? 1 : seed} {
+  /// Seed the dither noise source - a fixed seed gives bit-reproducible output
+}
+
+int16_t tpdf_dither::convert(float const sample) {
+  /// Convert a single sample in the range -1 to 1, with +-1 LSB triangular dither added before rounding
+  float const dithered{sample * 32'767.0f + (next_uniform() - next_uniform())};
+  return static_cast<int16_t>(std::clamp(std::round(dithered), -32'768.0f, 32'767.0f));
+}
+
+void tpdf_dither::convert(std::span<float const> const samples, std::span<int16_t> const output) {
+  /// Convert a run of samples
+  assert(output.size() >= samples.size());
+  for(size_t i{0}; i != samples.size(); ++i) {
+    output[i] = convert(samples[i]);
+  }
+}
+
+float tpdf_dither::next_uniform() {
+  /// Uniform random value in the range 0 to 1, from a xorshift32 generator
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return static_cast<float>(state >> 8) * (1.0f / 16'777'216.0f);
+}
+
+std::vector<uint8_t> wav(std::span<float const> const interleaved_samples,
+                         unsigned int const channels,
+                         unsigned int const sample_rate,
+                         sample_formats const format) {
+  /// Encode interleaved float samples as a RIFF WAVE file in memory
+  assert(channels != 0);
+  bool const is_float{format == sample_formats::float32};
+  unsigned int const bytes_per_sample{is_float ? 4u : 2u};
+  auto const frames{static_cast<uint32_t>(interleaved_samples.size() / channels)};
+  auto const data_size{static_cast<uint32_t>(frames * channels * bytes_per_sample)};
+  unsigned int const format_chunk_size{is_float ? 18u : 16u};                   // non-PCM formats carry an extension size field
+  unsigned int const fact_chunk_size{is_float ? 12u : 0u};                      // non-PCM formats carry a fact chunk with the frame count
+
+  std::vector<uint8_t> bytes;
+  bytes.reserve(12 + 8 + format_chunk_size + fact_chunk_size + 8 + data_size);
+
+  append_tag(bytes, "RIFF");
+  append_le(bytes, 4 + 8 + format_chunk_size + fact_chunk_size + 8 + data_size, 4);
+  append_tag(bytes, "WAVE");
+
+  append_tag(bytes, "fmt ");
+  append_le(bytes, format_chunk_size, 4);
+  append_le(bytes, is_float ? 3 : 1, 2);                                        // WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM
+  append_le(bytes, channels, 2);
+  append_le(bytes, sample_rate, 4);
+  append_le(bytes, sample_rate * channels * bytes_per_sample, 4);               // byte rate
+  append_le(bytes, channels * bytes_per_sample, 2);                             // block align
+  append_le(bytes, bytes_per_sample * 8, 2);                                    // bits per sample
+  if(is_float) {
+    append_le(bytes, 0, 2);                                                     // extension size
+
+    append_tag(bytes, "fact");
+    append_le(bytes, 4, 4);
+    append_le(bytes, frames, 4);
+  }
+
+  append_tag(bytes, "data");
+  append_le(bytes, data_size, 4);
+  size_t const data_start{bytes.size()};
+  bytes.resize(data_start + data_size);
+  if(is_float) {
+    std::memcpy(&bytes[data_start], interleaved_samples.data(), data_size);
+  } else {
+    tpdf_dither dither;
+    for(size_t i{0}; i != frames * channels; ++i) {
+      auto const sample{static_cast<uint16_t>(dither.convert(interleaved_samples[i]))};
+      bytes[data_start + i * 2]     = static_cast<uint8_t>(sample);
+      bytes[data_start + i * 2 + 1] = static_cast<uint8_t>(sample >> 8);
+    }
+  }
+  return bytes;
+}
+
+std::vector<uint8_t> flac(std::span<float const> const interleaved_samples,
+                          unsigned int const channels,
+                          unsigned int const sample_rate) {
+  /// Encode interleaved float samples as a 16-bit FLAC file in memory, dithered
+  /// Uses fixed-blocksize frames of independently coded channels, each using the best of constant, fixed-predictor and verbatim subframes
+  assert(channels != 0 && channels <= 8 && "FLAC supports between 1 and 8 channels");
+  assert(sample_rate < (1u << 20) && "FLAC sample rate must fit in 20 bits");
+  unsigned int constexpr block_size{4096};
+  size_t const frames{interleaved_samples.size() / channels};
+
+  std::vector<int16_t> pcm(frames * channels);
+  tpdf_dither{}.convert(interleaved_samples.first(frames * channels), pcm);
+
+  std::vector<uint8_t> bytes;
+  bytes.reserve(frames * channels + 64);                                        // typical compression of tonal material is at least 2:1
+  bit_writer writer{bytes};
+
+  // stream marker and STREAMINFO metadata block
+  append_tag(bytes, "fLaC");
+  writer.write(1, 1);                                                           // last metadata block
+  writer.write(0, 7);                                                           // STREAMINFO
+  writer.write(34, 24);                                                         // block length
+  auto const stream_block_size{static_cast<uint32_t>(std::clamp<size_t>(frames, 16, block_size))};
+  writer.write(stream_block_size, 16);                                          // minimum block size, excluding the last block
+  writer.write(stream_block_size, 16);                                          // maximum block size
+  writer.write(0, 24);                                                          // minimum frame size: unknown
+  writer.write(0, 24);                                                          // maximum frame size: unknown
+  writer.write(sample_rate, 20);
+  writer.write(channels - 1, 3);
+  writer.write(16 - 1, 5);                                                      // bits per sample
+  writer.write(static_cast<uint32_t>(static_cast<uint64_t>(frames) >> 32), 4);  // total samples per channel, 36 bits
+  writer.write(static_cast<uint32_t>(frames), 32);
+  for(unsigned int i{0}; i != 4; ++i) {
+    writer.write(0, 32);                                                        // MD5 signature of the audio data: unknown
+  }
+
+  std::vector<int32_t> channel_samples(block_size);
+  std::vector<int32_t> residuals;
+  residuals.reserve(block_size);
+  uint32_t frame_number{0};
+  for(size_t block_start{0}; block_start < frames; block_start += block_size, ++frame_number) {
+    size_t const frame_start{bytes.size()};
+    auto const samples_in_block{static_cast<uint32_t>(std::min<size_t>(block_size, frames - block_start))};
+
+    // frame header
+    writer.write(0b11'1111'1111'1110, 14);                                      // sync code
+    writer.write(0, 1);                                                         // reserved
+    writer.write(0, 1);                                                         // fixed blocksize stream
+    writer.write(0b0111, 4);                                                    // block size stored as a 16-bit field at the end of the header
+    writer.write(0b0000, 4);                                                    // sample rate from STREAMINFO
+    writer.write(channels - 1, 4);                                              // independent channels
+    writer.write(0b100, 3);                                                     // 16 bits per sample
+    writer.write(0, 1);                                                         // reserved
+    write_utf8_coded(writer, frame_number);
+    writer.write(samples_in_block - 1, 16);
+    writer.write(crc8({bytes.begin() + static_cast<std::ptrdiff_t>(frame_start), bytes.end()}), 8);
+
+    for(unsigned int channel{0}; channel != channels; ++channel) {
+      for(size_t i{0}; i != samples_in_block; ++i) {
+        channel_samples[i] = pcm[(block_start + i) * channels + channel];
+      }
+      write_subframe(writer, std::span{channel_samples}.first(samples_in_block), residuals);
+    }
+
+    // frame footer
+    writer.align();
+    writer.write(crc16({bytes.begin() + static_cast<std::ptrdiff_t>(frame_start), bytes.end()}), 16);
+  }
+  return bytes;
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace audio::encoder {
+
+enum class sample_formats {
+  pcm16,                                                                        // 16-bit signed integer, dithered from float
+  float32,                                                                      // 32-bit IEEE float, bit-exact
+};
+
+class tpdf_dither {
+  /// Float to 16-bit conversion with triangular probability density dither, decorrelating quantisation error from the signal
+  uint32_t state;                                                               // xorshift32 state, must never be zero
+
+public:
+  explicit tpdf_dither(uint32_t seed = 0x9E'37'79'B9u);
+
+  int16_t convert(float sample);
+  void convert(std::span<float const> samples, std::span<int16_t> output);
+
+private:
+  float next_uniform();
+};
+
+std::vector<uint8_t> wav(std::span<float const> interleaved_samples, unsigned int channels, unsigned int sample_rate, sample_formats format);
+std::vector<uint8_t> flac(std::span<float const> interleaved_samples, unsigned int channels, unsigned int sample_rate);
+
+}
@@ -0,0 +1,99 @@
+#include "fft.h"
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <boost/math/constants/constants.hpp>
+
+namespace audio {
+
+fft::fft(unsigned int const new_size)
+  : size{new_size},
+    half_size{new_size / 2},
+    bit_reversal(new_size / 2),
+    twiddles(new_size / 4),
+    split_twiddles(new_size / 2 + 1),
+    scratch(new_size / 2) {
+  /// Precompute the permutation and twiddle tables
+  assert(std::has_single_bit(size) && size >= 4 && "fft size must be a power of two of at least 4");
+  double constexpr two_pi{boost::math::constants::two_pi<double>()};
+  auto const bits{static_cast<unsigned int>(std::countr_zero(half_size))};
+  for(unsigned int i{0}; i != half_size; ++i) {
+    unsigned int reversed{0};
+    for(unsigned int bit{0}; bit != bits; ++bit) {
+      reversed |= ((i >> bit) & 1u) << (bits - 1 - bit);
+    }
+    bit_reversal[i] = reversed;
+  }
+  for(unsigned int k{0}; k != twiddles.size(); ++k) {                           // computed in double so the tables are accurate to the last float bit
+    double const angle{-two_pi * static_cast<double>(k) / static_cast<double>(half_size)};
+    twiddles[k] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+  }
+  for(unsigned int k{0}; k != split_twiddles.size(); ++k) {
+    double const angle{-two_pi * static_cast<double>(k) / static_cast<double>(size)};
+    split_twiddles[k] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+  }
+}
+
+unsigned int fft::get_size() const {
+  return size;
+}
+unsigned int fft::get_bin_count() const {
+  /// Number of bins in a spectrum, from DC to Nyquist inclusive
+  return half_size + 1;
+}
+
+void fft::forward(std::span<float const> const input, std::span<std::complex<float>> const bins) {
+  /// Transform size real samples into size / 2 + 1 complex bins, unnormalised
+  assert(input.size() == size && bins.size() == get_bin_count());
+  for(unsigned int i{0}; i != half_size; ++i) {
+    scratch[bit_reversal[i]] = {input[2 * i], input[2 * i + 1]};
+  }
+  transform(scratch, false);
+
+  bins[0]         = {scratch[0].real() + scratch[0].imag(), 0.0f};              // DC and Nyquist are both real, packed in the first element
+  bins[half_size] = {scratch[0].real() - scratch[0].imag(), 0.0f};
+  for(unsigned int k{1}; k != half_size; ++k) {                                 // X[k] = E[k] + W^k O[k], with E and O recovered from the packed transform's symmetry
+    std::complex<float> const packed{scratch[k]};
+    std::complex<float> const mirrored{std::conj(scratch[half_size - k])};
+    std::complex<float> const even{(packed + mirrored) * 0.5f};
+    std::complex<float> const odd{(packed - mirrored) * std::complex<float>{0.0f, -0.5f}};
+    bins[k] = even + split_twiddles[k] * odd;
+  }
+}
+
+void fft::inverse(std::span<std::complex<float> const> const bins, std::span<float> const output) {
+  /// Transform size / 2 + 1 complex bins back into size real samples, scaled so that inverse(forward(x)) == x
+  assert(bins.size() == get_bin_count() && output.size() == size);
+  for(unsigned int k{0}; k != half_size; ++k) {                                 // invert the split: E[k] and O[k] from X[k] and conj(X[half_size - k]), repacked as E + iO
+    std::complex<float> const bin{bins[k]};
+    std::complex<float> const mirrored{std::conj(bins[half_size - k])};
+    std::complex<float> const even{(bin + mirrored) * 0.5f};
+    std::complex<float> const odd{(bin - mirrored) * 0.5f * std::conj(split_twiddles[k])};
+    scratch[bit_reversal[k]] = even + std::complex<float>{0.0f, 1.0f} * odd;
+  }
+  transform(scratch, true);
+
+  float const scale{1.0f / static_cast<float>(half_size)};
+  for(unsigned int i{0}; i != half_size; ++i) {
+    output[2 * i]     = scratch[i].real() * scale;
+    output[2 * i + 1] = scratch[i].imag() * scale;
+  }
+}
+
+void fft::transform(std::span<std::complex<float>> const data, bool const inverse) const {
+  /// In-place iterative radix-2 transform of bit-reversed input, unnormalised
+  for(unsigned int length{2}; length <= half_size; length *= 2) {
+    unsigned int const half_length{length / 2};
+    unsigned int const stride{half_size / length};                              // step through the twiddle table for this stage
+    for(unsigned int start{0}; start != half_size; start += length) {
+      for(unsigned int j{0}; j != half_length; ++j) {
+        std::complex<float> const twiddle{inverse ? std::conj(twiddles[j * stride]) : twiddles[j * stride]};
+        std::complex<float> const product{data[start + j + half_length] * twiddle};
+        data[start + j + half_length] = data[start + j] - product;
+        data[start + j] += product;
+      }
+    }
+  }
+}
+
+}
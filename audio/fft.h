@@ -0,0 +1,32 @@
+#pragma once
+
+#include <complex>
+#include <span>
+#include <vector>
+
+namespace audio {
+
+class fft {
+  /// Real-input fast Fourier transform of a fixed power-of-two size, with all tables and scratch preallocated so it can run on the audio thread
+  /// Computed as a complex transform of half the size, packing even samples into the real part and odd samples into the imaginary part
+  unsigned int const size;
+  unsigned int const half_size;
+  std::vector<unsigned int> bit_reversal;                                       // permutation of the half size transform's input
+  std::vector<std::complex<float>> twiddles;                                    // half size transform roots of unity, e^(-2 pi i k / half_size)
+  std::vector<std::complex<float>> split_twiddles;                              // full size roots, e^(-2 pi i k / size), to separate the even and odd halves
+  std::vector<std::complex<float>> scratch;
+
+public:
+  explicit fft(unsigned int size);
+
+  unsigned int get_size() const;
+  unsigned int get_bin_count() const;
+
+  void forward(std::span<float const> input, std::span<std::complex<float>> bins);
+  void inverse(std::span<std::complex<float> const> bins, std::span<float> output);
+
+private:
+  void transform(std::span<std::complex<float>> data, bool inverse) const;
+};
+
+}
@@ -0,0 +1,287 @@
+#include "fm_synth.h"
+#include <algorithm>
+#include <cassert>
+#include <boost/math/constants/constants.hpp>
+#include "mix.h"
+#include "simd/simd.h"
+
+namespace audio {
+
+namespace {
+
+struct routing {
+  std::array<uint8_t, fm_synth::operator_count> modulators;                     // bit n set if operator n + 1 modulates this operator
+  uint8_t carriers;                                                             // bit n set if operator n + 1 is heard
+};
+
+std::array<routing, static_cast<size_t>(fm_synth::algorithms::count)> constexpr routings{{ // modulators always have a higher index than what they modulate, so operators are computed from 4 down to 1
+  {.modulators{0b0010, 0b0100, 0b1000, 0b0000}, .carriers{0b0001}},             // stack
+  {.modulators{0b0010, 0b1100, 0b0000, 0b0000}, .carriers{0b0001}},             // pair_into_stack
+  {.modulators{0b1010, 0b0100, 0b0000, 0b0000}, .carriers{0b0001}},             // branch_into_carrier
+  {.modulators{0b0110, 0b0000, 0b1000, 0b0000}, .carriers{0b0001}},             // stack_and_branch
+  {.modulators{0b0010, 0b0000, 0b1000, 0b0000}, .carriers{0b0101}},             // two_stacks
+  {.modulators{0b1000, 0b1000, 0b1000, 0b0000}, .carriers{0b0111}},             // one_to_three
+  {.modulators{0b0000, 0b0000, 0b1000, 0b0000}, .carriers{0b0111}},             // stack_and_two_carriers
+  {.modulators{0b0000, 0b0000, 0b0000, 0b0000}, .carriers{0b1111}},             // additive
+}};
+
+inline simd::batch sine(simd::batch const cycles) noexcept __attribute__((__always_inline__));
+inline simd::batch sine(simd::batch const cycles) noexcept {
+  /// sin(2 pi x) to within 7e-6, about -100dB, from an odd polynomial over half a cycle with exact zeros at its ends
+  simd::batch const half{simd::broadcast(0.5f)};
+  simd::batch const one{simd::broadcast(1.0f)};
+  simd::batch const two{simd::broadcast(2.0f)};
+  simd::batch const x{(cycles - simd::floor(cycles + half)) * two};             // -1 to 1, for sin(pi x)
+  simd::batch const x2{x * x};
+  simd::batch polynomial{simd::broadcast(-0.06368988f)};                        // minimax coefficients of sin(pi x) / (x (1 - x^2)) in powers of x^2
+  polynomial = simd::multiply_add(polynomial, x2, simd::broadcast( 0.51749134f));
+  polynomial = simd::multiply_add(polynomial, x2, simd::broadcast(-2.02477312f));
+  polynomial = simd::multiply_add(polynomial, x2, simd::broadcast( 3.14152122f));
+  return x * (one - x2) * polynomial;
+}
+
+}
+
+fm_synth::fm_synth(unsigned int const new_voice_count, unsigned int const max_frames_per_quantum)
+  : voice_count{new_voice_count},
+    lane_count{static_cast<unsigned int>((new_voice_count + simd::width - 1) / simd::width * simd::width)},
+    voice_controls(new_voice_count),
+    envelopes{new_voice_count, operator_count, 0},
+    phases(operator_count * lane_count),
+    increments(operator_count * lane_count),
+    amplitudes(operator_count * lane_count),
+    amplitude_targets(operator_count * lane_count),
+    feedback_history(2 * lane_count),
+    note_increments(lane_count),
+    velocities(lane_count),
+    gates(new_voice_count, false),
+    batch_sounding(lane_count / simd::width, false),
+    lane_mix(max_frames_per_quantum * simd::width),
+    mix_buffer(max_frames_per_quantum) {
+  /// Preallocate all per-voice state, and apply the default patch
+  set_parameters({});
+}
+
+void fm_synth::set_sample_rate(unsigned int const new_sample_rate) {
+  sample_rate = static_cast<float>(new_sample_rate);
+}
+
+void fm_synth::set_parameters(parameters const &params) {
+  /// Change the patch for all voices, which takes effect from the next quantum - main thread
+  for(unsigned int index{0}; index != operator_count; ++index) {
+    auto const &source{params.operators[index]};
+    auto &control{operator_controls[index]};
+    control.ratio.store(  std::max(source.ratio, 0.0f), std::memory_order_relaxed);
+    control.level.store(  std::max(source.level, 0.0f), std::memory_order_relaxed);
+    control.attack.store( source.envelope.attack,       std::memory_order_relaxed);
+    control.decay.store(  source.envelope.decay,        std::memory_order_relaxed);
+    control.sustain.store(source.envelope.sustain,      std::memory_order_relaxed);
+    control.release.store(source.envelope.release,      std::memory_order_relaxed);
+    envelopes.set_envelope(index, source.envelope);
+  }
+  algorithm.store(params.algorithm == algorithms::count ? algorithms::stack : params.algorithm, std::memory_order_relaxed);
+  feedback.store( params.feedback, std::memory_order_relaxed);
+  gain.store(     params.gain,     std::memory_order_relaxed);
+}
+fm_synth::parameters fm_synth::get_parameters() const {
+  parameters result{
+    .algorithm{algorithm.load(std::memory_order_relaxed)},
+    .feedback{ feedback.load( std::memory_order_relaxed)},
+    .gain{     gain.load(     std::memory_order_relaxed)},
+  };
+  for(unsigned int index{0}; index != operator_count; ++index) {
+    auto const &control{operator_controls[index]};
+    result.operators[index] = {
+      .ratio{control.ratio.load(std::memory_order_relaxed)},
+      .level{control.level.load(std::memory_order_relaxed)},
+      .envelope{
+        .attack{ control.attack.load( std::memory_order_relaxed)},
+        .decay{  control.decay.load(  std::memory_order_relaxed)},
+        .sustain{control.sustain.load(std::memory_order_relaxed)},
+        .release{control.release.load(std::memory_order_relaxed)},
+      },
+    };
+  }
+  return result;
+}
+
+unsigned int fm_synth::get_voice_count() const {
+  return voice_count;
+}
+unsigned int fm_synth::get_sounding_voices() const {
+  return sounding_voices.load(std::memory_order_relaxed);
+}
+
+void fm_synth::note_on(unsigned int const voice, float const frequency, float const velocity) {
+  /// Start a note on one voice, or change the pitch of one already playing without retriggering it - main thread
+  assert(voice < voice_count && "voice index out of range in note_on");
+  auto &control{voice_controls[voice]};
+  control.frequency.store(frequency, std::memory_order_relaxed);
+  control.velocity.store( velocity,  std::memory_order_relaxed);
+  control.active.store(true, std::memory_order_release);
+}
+
+void fm_synth::note_off(unsigned int const voice) {
+  /// Release a note, which sounds on through its envelopes' release - main thread
+  assert(voice < voice_count && "voice index out of range in note_off");
+  voice_controls[voice].active.store(false, std::memory_order_release);
+}
+
+void fm_synth::output(std::span<AudioSampleFrame> const outputs) {
+  /// Mix all sounding voices into all outputs - audio thread
+  if(outputs.empty() || sample_rate <= 0.0f) return;
+  auto const frames{static_cast<unsigned int>(outputs.front().samplesPerChannel)};
+  assert(frames <= mix_buffer.size() && "quantum larger than fm_synth was constructed for");
+
+  // trigger and release envelopes as notes start and stop, restarting the operators of voices that had fallen silent
+  for(unsigned int voice{0}; voice != voice_count; ++voice) {
+    auto const &control{voice_controls[voice]};
+    bool const active{control.active.load(std::memory_order_acquire)};
+    note_increments[voice] = control.frequency.load(std::memory_order_relaxed) / sample_rate;
+    velocities[voice] = control.velocity.load(std::memory_order_relaxed);
+    if(active == gates[voice]) continue;
+    if(active) {
+      bool silent{true};
+      for(unsigned int index{0}; index != operator_count; ++index) {
+        if(amplitudes[index * lane_count + voice] > 0.0f) silent = false;
+      }
+      if(silent) {
+        for(unsigned int index{0}; index != operator_count; ++index) phases[index * lane_count + voice] = 0.0f;
+        feedback_history[voice] = 0.0f;
+        feedback_history[lane_count + voice] = 0.0f;
+      }
+      envelopes.trigger(voice);
+    } else {
+      envelopes.release(voice);
+    }
+    gates[voice] = active;
+  }
+  envelopes.evaluate(frames, sample_rate);
+
+  // per-operator increments and amplitude targets for all voices at once; modulators are scaled from radians to cycles
+  auto const current_algorithm{algorithm.load(std::memory_order_relaxed)};
+  auto const &route{routings[static_cast<size_t>(current_algorithm)]};
+  float constexpr two_pi{2.0f * boost::math::constants::pi<float>()};
+  for(unsigned int index{0}; index != operator_count; ++index) {
+    auto const &control{operator_controls[index]};
+    bool const carrier{(route.carriers & (1u << index)) != 0};
+    simd::batch const ratio{simd::broadcast(control.ratio.load(std::memory_order_relaxed))};
+    simd::batch const level{simd::broadcast(control.level.load(std::memory_order_relaxed) / (carrier ? 1.0f : two_pi))};
+    auto const envelope{envelopes.get_envelope(index)};
+    float *operator_increments{&increments[index * lane_count]};
+    float *targets{&amplitude_targets[index * lane_count]};
+    for(unsigned int lane{0}; lane != lane_count; lane += simd::width) {
+      simd::store(&operator_increments[lane], simd::load(&note_increments[lane]) * ratio);
+      simd::store(&targets[lane], simd::load(&envelope[lane]) * simd::load(&velocities[lane]) * level);
+    }
+  }
+
+  // skip whole batches of voices that are silent throughout the quantum
+  unsigned int sounding_count{0};
+  for(unsigned int lane{0}; lane != lane_count; lane += simd::width) {
+    bool batch_audible{false};
+    for(unsigned int voice{lane}; voice != std::min(lane + static_cast<unsigned int>(simd::width), voice_count); ++voice) {
+      bool audible{false};
+      for(unsigned int index{0}; index != operator_count; ++index) {
+        if((route.carriers & (1u << index)) == 0) continue;
+        if(amplitudes[index * lane_count + voice] > 0.0f || amplitude_targets[index * lane_count + voice] > 0.0f) audible = true;
+      }
+      if(audible) ++sounding_count;
+      batch_audible = batch_audible || audible;
+    }
+    batch_sounding[lane / simd::width] = batch_audible;
+  }
+  sounding_voices.store(sounding_count, std::memory_order_relaxed);
+  if(sounding_count == 0) {
+    std::copy(amplitude_targets.begin(), amplitude_targets.end(), amplitudes.begin()); // modulators of silent voices may still be moving
+    return;
+  }
+
+  mix::clear(std::span{lane_mix}.first(frames * simd::width));
+  float const feedback_scale{feedback.load(std::memory_order_relaxed) / two_pi * 0.5f}; // applied to the sum of the last two values
+  switch(current_algorithm) {
+  case algorithms::stack:                  render<algorithms::stack>(                 frames, feedback_scale); break;
+  case algorithms::pair_into_stack:        render<algorithms::pair_into_stack>(       frames, feedback_scale); break;
+  case algorithms::branch_into_carrier:    render<algorithms::branch_into_carrier>(   frames, feedback_scale); break;
+  case algorithms::stack_and_branch:       render<algorithms::stack_and_branch>(      frames, feedback_scale); break;
+  case algorithms::two_stacks:             render<algorithms::two_stacks>(            frames, feedback_scale); break;
+  case algorithms::one_to_three:           render<algorithms::one_to_three>(          frames, feedback_scale); break;
+  case algorithms::stack_and_two_carriers: render<algorithms::stack_and_two_carriers>(frames, feedback_scale); break;
+  case algorithms::additive:               render<algorithms::additive>(              frames, feedback_scale); break;
+  case algorithms::count:                  break;
+  }
+  std::copy(amplitude_targets.begin(), amplitude_targets.end(), amplitudes.begin()); // land exactly on the targets, so released voices reach zero and are skipped
+
+  // sum the lanes, then mix into every channel
+  float const output_gain{gain.load(std::memory_order_relaxed)};
+  for(unsigned int frame{0}; frame != frames; ++frame) {
+    float sum{0.0f};
+    for(unsigned int lane{0}; lane != simd::width; ++lane) sum += lane_mix[frame * simd::width + lane];
+    mix_buffer[frame] = sum;
+  }
+  for(auto const &output : outputs) {
+    for(unsigned int channel{0}; channel != static_cast<unsigned int>(output.numberOfChannels); ++channel) {
+      mix::accumulate({mix_buffer.data(), frames}, mix::channel(output, channel), output_gain);
+    }
+  }
+}
+
+template<fm_synth::algorithms algorithm>
+void fm_synth::render(unsigned int const frames, float const feedback_scale) {
+  /// Render every sounding batch of voices into the per-lane mix, with the routing fixed at compile time so the operator loop unrolls to straight-line SIMD
+  /// Each batch keeps its operators' state in registers for the whole quantum, so state memory is touched once per quantum rather than once per sample
+  auto constexpr route{routings[static_cast<size_t>(algorithm)]};
+  unsigned int constexpr feedback_operator{operator_count - 1};
+  simd::batch const zero{simd::broadcast(0.0f)};
+  simd::batch const feedback_amount{simd::broadcast(feedback_scale)};
+  simd::batch const inverse_frames{simd::broadcast(1.0f / static_cast<float>(frames))};
+
+  for(unsigned int lane{0}; lane != lane_count; lane += simd::width) {
+    if(!batch_sounding[lane / simd::width]) continue;
+    std::array<simd::batch, operator_count> phase;
+    std::array<simd::batch, operator_count> increment;
+    std::array<simd::batch, operator_count> amplitude;
+    std::array<simd::batch, operator_count> amplitude_step;
+    for(unsigned int index{0}; index != operator_count; ++index) {
+      size_t const offset{index * lane_count + lane};
+      phase[index]          = simd::load(&phases[offset]);
+      increment[index]      = simd::load(&increments[offset]);
+      amplitude[index]      = simd::load(&amplitudes[offset]);
+      amplitude_step[index] = (simd::load(&amplitude_targets[offset]) - amplitude[index]) * inverse_frames;
+    }
+    simd::batch feedback_1{simd::load(&feedback_history[lane])};
+    simd::batch feedback_2{simd::load(&feedback_history[lane_count + lane])};
+
+    for(unsigned int frame{0}; frame != frames; ++frame) {
+      std::array<simd::batch, operator_count> operator_output;
+      simd::batch carrier_sum{zero};
+      for(unsigned int index{operator_count}; index-- != 0;) {
+        simd::batch modulation_input{zero};
+        if(index == feedback_operator) modulation_input = (feedback_1 + feedback_2) * feedback_amount; // averaging two values tames the feedback loop's tendency to oscillate
+        for(unsigned int source{index + 1}; source != operator_count; ++source) {
+          if((route.modulators[index] & (1u << source)) != 0) modulation_input = modulation_input + operator_output[source];
+        }
+        simd::batch const value{sine(phase[index] + modulation_input)};
+        if(index == feedback_operator) {
+          feedback_2 = feedback_1;
+          feedback_1 = value;
+        }
+        amplitude[index] = amplitude[index] + amplitude_step[index];
+        operator_output[index] = value * amplitude[index];
+        if((route.carriers & (1u << index)) != 0) carrier_sum = carrier_sum + operator_output[index];
+        phase[index] = phase[index] + increment[index];
+        phase[index] = phase[index] - simd::floor(phase[index]);                // wrap every sample, keeping full precision in the phase
+      }
+      float *mixed{&lane_mix[frame * simd::width]};
+      simd::store(mixed, simd::load(mixed) + carrier_sum);
+    }
+
+    for(unsigned int index{0}; index != operator_count; ++index) {
+      simd::store(&phases[index * lane_count + lane], phase[index]);
+    }
+    simd::store(&feedback_history[lane],              feedback_1);
+    simd::store(&feedback_history[lane_count + lane], feedback_2);
+  }
+}
+
+}
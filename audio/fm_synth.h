@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <emscripten/webaudio.h>
+#include "modulation.h"
+
+namespace audio {
+
+class fm_synth {
+  /// Polyphonic phase modulation synthesiser: four sine operators per voice, routed into each other by one of the eight classic four-operator algorithms
+  /// Operator state is structure-of-arrays, one contiguous lane per voice for each operator, so every operator is computed for several voices at once with a polynomial sine
+public:
+  static unsigned int constexpr operator_count{4};
+
+  enum class algorithms : uint8_t {                                             // operator 4 has feedback, operator 1 is always a carrier; "a>b" means a modulates b
+    stack,                                                                      // 4>3>2>1
+    pair_into_stack,                                                            // (3 + 4)>2>1
+    branch_into_carrier,                                                        // 3>2>1 and 4>1
+    stack_and_branch,                                                           // 4>3>1 and 2>1
+    two_stacks,                                                                 // 2>1 and 4>3
+    one_to_three,                                                               // 4>1, 4>2 and 4>3
+    stack_and_two_carriers,                                                     // 4>3, with 1 and 2 unmodulated
+    additive,                                                                   // four carriers
+    count,
+  };
+
+  struct operator_parameters {
+    float ratio{1.0f};                                                          // frequency as a multiple of the note
+    float level{1.0f};                                                          // amplitude for a carrier, peak modulation index in radians for a modulator
+    modulation::envelope_parameters envelope{};
+  };
+  struct parameters {
+    algorithms algorithm{algorithms::stack};
+    float feedback{0.0f};                                                       // operator 4's self-modulation index, in radians
+    float gain{0.25f};                                                          // linear output gain, shared by all voices
+    std::array<operator_parameters, operator_count> operators{};
+  };
+
+private:
+  struct voice_control {                                                        // written by the main thread, read by the audio thread
+    std::atomic<bool> active{false};
+    std::atomic<float> frequency{440.0f};
+    std::atomic<float> velocity{1.0f};
+  };
+  struct operator_control {
+    std::atomic<float> ratio{operator_parameters{}.ratio};
+    std::atomic<float> level{operator_parameters{}.level};
+    std::atomic<float> attack{operator_parameters{}.envelope.attack};
+    std::atomic<float> decay{operator_parameters{}.envelope.decay};
+    std::atomic<float> sustain{operator_parameters{}.envelope.sustain};
+    std::atomic<float> release{operator_parameters{}.envelope.release};
+  };
+
+  unsigned int const voice_count;
+  unsigned int const lane_count;                                                // voice count rounded up to a whole number of SIMD batches, so no kernel needs a scalar tail
+
+  std::vector<voice_control> voice_controls;
+  std::array<operator_control, operator_count> operator_controls;
+  std::atomic<algorithms> algorithm{parameters{}.algorithm};
+  std::atomic<float> feedback{parameters{}.feedback};
+  std::atomic<float> gain{parameters{}.gain};
+
+  modulation envelopes;                                                         // one envelope slot per operator
+
+  // per-voice state owned by the audio thread, indexed [operator * lane_count + voice]
+  std::vector<float> phases;                                                    // in cycles, 0 to 1
+  std::vector<float> increments;                                                // scratch: cycles per sample for this quantum
+  std::vector<float> amplitudes;                                                // amplitude reached at the end of the last quantum, each quantum ramps from here to avoid zipper noise
+  std::vector<float> amplitude_targets;                                         // scratch: amplitude to reach by the end of this quantum
+
+  // per-voice state indexed [voice]
+  std::vector<float> feedback_history;                                          // operator 4's last two sine values, indexed [age * lane_count + voice]
+  std::vector<float> note_increments;                                           // scratch: cycles per sample of each voice's note
+  std::vector<float> velocities;                                                // scratch
+  std::vector<bool> gates;                                                      // last active state seen, to trigger and release envelopes
+  std::vector<bool> batch_sounding;                                             // scratch: whether any voice in each SIMD batch is audible this quantum, indexed [lane / simd::width]
+
+  std::vector<float> lane_mix;                                                  // preallocated per-lane mix for one quantum, indexed [frame * simd::width + lane], summed across lanes at the end
+  std::vector<float> mix_buffer;                                                // preallocated mono mix for one quantum
+
+  float sample_rate{0.0f};
+  std::atomic<unsigned int> sounding_voices{0};                                 // telemetry published by the audio thread
+
+public:
+  explicit fm_synth(unsigned int voice_count, unsigned int max_frames_per_quantum = 1024);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void set_parameters(parameters const &params);
+  parameters get_parameters() const;
+
+  unsigned int get_voice_count() const;
+  unsigned int get_sounding_voices() const;
+
+  void note_on(unsigned int voice, float frequency, float velocity = 1.0f);
+  void note_off(unsigned int voice);
+
+  void output(std::span<AudioSampleFrame> outputs);
+
+private:
+  template<algorithms algorithm>
+  void render(unsigned int frames, float feedback_scale);
+};
+
+}
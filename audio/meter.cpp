@@ -0,0 +1,263 @@
+#include "meter.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <boost/math/constants/constants.hpp>
+#include "denormal.h"
+#include "mix.h"
+#include "simd/simd.h"
+
+namespace audio {
+
+namespace {
+
+float horizontal_max(simd::batch const value) {
+  /// Largest lane of a batch
+  std::array<float, simd::width> lanes;
+  simd::store(lanes.data(), value);
+  return *std::max_element(lanes.begin(), lanes.end());
+}
+
+float horizontal_sum(simd::batch const value) {
+  /// Sum of all lanes of a batch
+  std::array<float, simd::width> lanes;
+  simd::store(lanes.data(), value);
+  float sum{0.0f};
+  for(float const lane : lanes) sum += lane;
+  return sum;
+}
+
+void store_max(std::atomic<float> &target, float const value) {
+  /// Raise an atomic to at least the given value, so the reader sees the highest value since it last reset it
+  float previous{target.load(std::memory_order_relaxed)};
+  while(previous < value && !target.compare_exchange_weak(previous, value, std::memory_order_relaxed));
+}
+
+float to_loudness(float const mean_square) {
+  /// BS.1770 loudness in LUFS from K-weighted mean square energy
+  return -0.691f + 10.0f * std::log10(mean_square);
+}
+
+}
+
+meter::meter(unsigned int const this_channels, unsigned int const max_frames_per_quantum)
+  : channels{this_channels},
+    channel_states(this_channels),
+    published(this_channels),
+    scratch(taps_per_phase - 1 + max_frames_per_quantum) {
+  /// Design the true peak interpolator: a Hann-windowed sinc split into polyphase rows, each normalised to unity gain
+  float constexpr pi{boost::math::constants::pi<float>()};
+  float constexpr length{static_cast<float>(taps_per_phase * oversampling)};
+  float constexpr centre{(length - 1.0f) * 0.5f};
+  for(unsigned int phase{0}; phase != oversampling; ++phase) {
+    float sum{0.0f};
+    for(unsigned int tap{0}; tap != taps_per_phase; ++tap) {
+      float const position{static_cast<float>(tap * oversampling + phase)};
+      float const x{(position - centre) / static_cast<float>(oversampling)};
+      float const sinc{std::abs(x) < 1.0e-6f ? 1.0f : std::sin(pi * x) / (pi * x)};
+      float const window{0.5f - 0.5f * std::cos(2.0f * pi * (position + 0.5f) / length)};
+      interpolator[phase][tap] = sinc * window;
+      sum += interpolator[phase][tap];
+    }
+    for(auto &coefficient : interpolator[phase]) coefficient /= sum;
+  }
+}
+
+void meter::set_sample_rate(unsigned int const new_sample_rate) {
+  /// Derive the K-weighting filters for this sample rate, using the analytic form of the BS.1770 filters - main thread, before processing starts
+  float constexpr pi{boost::math::constants::pi<float>()};
+  auto const sample_rate{static_cast<float>(new_sample_rate)};
+  {                                                                             // stage 1: high shelf modelling the acoustic effect of the head
+    float const k{std::tan(pi * 1'681.974'5f / sample_rate)};
+    float const q{0.707'175'24f};
+    float const gain_high{std::pow(10.0f, 3.999'843'9f / 20.0f)};
+    float const gain_band{std::pow(gain_high, 0.499'666'77f)};
+    float const a0{1.0f + k / q + k * k};
+    k_filter[0] = {
+      .b0{(gain_high + gain_band * k / q + k * k) / a0},
+      .b1{2.0f * (k * k - gain_high) / a0},
+      .b2{(gain_high - gain_band * k / q + k * k) / a0},
+      .a1{2.0f * (k * k - 1.0f) / a0},
+      .a2{(1.0f - k / q + k * k) / a0},
+    };
+  }
+  {                                                                             // stage 2: RLB high pass
+    float const k{std::tan(pi * 38.135'47f / sample_rate)};
+    float const q{0.500'327'04f};
+    float const a0{1.0f + k / q + k * k};
+    k_filter[1] = {
+      .b0{1.0f},
+      .b1{-2.0f},
+      .b2{1.0f},
+      .a1{2.0f * (k * k - 1.0f) / a0},
+      .a2{(1.0f - k / q + k * k) / a0},
+    };
+  }
+  block_frames = new_sample_rate * block_milliseconds / 1'000;
+  block_position = 0;
+  block_energy = 0.0f;
+  energy_count = 0;
+  for(auto &state : channel_states) state = {};
+}
+
+void meter::process(std::span<AudioSampleFrame const> const outputs) {
+  /// Measure one quantum of the first output - audio thread
+  if(outputs.empty() || block_frames == 0) return;
+  auto const &output{outputs.front()};
+  auto const frames{static_cast<size_t>(output.samplesPerChannel)};
+  assert(frames + taps_per_phase - 1 <= scratch.size() && "quantum larger than meter was constructed for");
+  unsigned int const measured_channels{std::min(channels, static_cast<unsigned int>(output.numberOfChannels))};
+
+  // sample peak and true peak, vectorised across time
+  for(unsigned int channel{0}; channel != measured_channels; ++channel) {
+    auto &state{channel_states[channel]};
+    auto const data{mix::channel(output, channel)};
+    std::copy(state.history.begin(), state.history.end(), scratch.begin());
+    mix::copy(data, std::span{scratch}.subspan(state.history.size()));
+    std::copy_n(scratch.begin() + static_cast<ptrdiff_t>(frames), state.history.size(), state.history.begin()); // keep the newest samples for the next quantum
+
+    simd::batch peak{simd::broadcast(0.0f)};
+    simd::batch true_peak{simd::broadcast(0.0f)};
+    float peak_tail{0.0f};
+    float true_peak_tail{0.0f};
+    float const *input{&scratch[state.history.size()]};                         // input[n - tap] reaches back into the history
+    size_t i{0};
+    for(; i + simd::width <= frames; i += simd::width) {
+      peak = simd::max(peak, simd::abs(simd::load(&input[i])));
+      for(auto const &phase : interpolator) {
+        simd::batch sum{simd::broadcast(0.0f)};
+        for(unsigned int tap{0}; tap != taps_per_phase; ++tap) {
+          sum = simd::multiply_add(simd::broadcast(phase[tap]), simd::load(&input[i - tap]), sum);
+        }
+        true_peak = simd::max(true_peak, simd::abs(sum));
+      }
+    }
+    for(; i != frames; ++i) {
+      peak_tail = std::max(peak_tail, std::abs(input[i]));
+      for(auto const &phase : interpolator) {
+        float sum{0.0f};
+        for(unsigned int tap{0}; tap != taps_per_phase; ++tap) {
+          sum += phase[tap] * input[i - tap];
+        }
+        true_peak_tail = std::max(true_peak_tail, std::abs(sum));
+      }
+    }
+    float const channel_peak{std::max(horizontal_max(peak), peak_tail)};
+    float const channel_true_peak{std::max({horizontal_max(true_peak), true_peak_tail, channel_peak})}; // the interpolator's phases don't all pass through the original samples exactly
+    store_max(published[channel].peak, channel_peak);
+    store_max(published[channel].true_peak, channel_true_peak);
+    store_max(max_true_peak, channel_true_peak);
+  }
+
+  // RMS and K-weighted energy, split at loudness block boundaries
+  for(size_t offset{0}; offset != frames;) {
+    size_t const count{std::min(frames - offset, static_cast<size_t>(block_frames - block_position))};
+    for(unsigned int channel{0}; channel != measured_channels; ++channel) {
+      auto &state{channel_states[channel]};
+      auto const data{mix::channel(output, channel).subspan(offset, count)};
+
+      simd::batch squares{simd::broadcast(0.0f)};
+      size_t i{0};
+      for(; i + simd::width <= count; i += simd::width) {
+        simd::batch const sample{simd::load(&data[i])};
+        squares = simd::multiply_add(sample, sample, squares);
+      }
+      float square_sum{horizontal_sum(squares)};
+      for(; i != count; ++i) {
+        square_sum += data[i] * data[i];
+      }
+      state.block_square_sum += square_sum;
+
+      float weighted_sum{0.0f};
+      for(float sample : data) {                                                // recursive filters can't be vectorised across time
+        for(unsigned int stage{0}; stage != k_filter.size(); ++stage) {
+          auto const &filter{k_filter[stage]};
+          auto &filter_state{state.k_weighting[stage]};
+          float const filtered{filter.b0 * sample + filter_state.z1};
+          filter_state.z1 = filter.b1 * sample - filter.a1 * filtered + filter_state.z2;
+          filter_state.z2 = filter.b2 * sample - filter.a2 * filtered;
+          sample = filtered;
+        }
+        weighted_sum += sample * sample;
+      }
+      block_energy += weighted_sum;                                             // all channel weights are 1 for mono and stereo
+    }
+    block_position += static_cast<unsigned int>(count);
+    offset += count;
+    if(block_position == block_frames) finish_block();
+  }
+}
+
+void meter::finish_block() {
+  /// Complete a 100ms block: update the sliding loudness windows and RMS, and publish them
+  auto const frames{static_cast<float>(block_frames)};
+  energy_history[energy_index] = block_energy / frames;
+  energy_index = (energy_index + 1) % short_term_blocks;
+  energy_count = std::min(energy_count + 1, short_term_blocks);
+  block_energy = 0.0f;
+  block_position = 0;
+
+  auto const window_mean{[&](unsigned int const blocks){
+    unsigned int const available{std::min(blocks, energy_count)};
+    float sum{0.0f};
+    for(unsigned int i{1}; i <= available; ++i) {
+      sum += energy_history[(energy_index + short_term_blocks - i) % short_term_blocks];
+    }
+    return sum / static_cast<float>(available);
+  }};
+  float const new_momentary{to_loudness(window_mean(momentary_blocks))};
+  float const new_short_term{to_loudness(window_mean(short_term_blocks))};
+  momentary.store(new_momentary, std::memory_order_relaxed);
+  short_term.store(new_short_term, std::memory_order_relaxed);
+  store_max(max_momentary, new_momentary);
+  if(energy_count == short_term_blocks) store_max(max_short_term, new_short_term); // only once the full 3s window is available
+
+  for(unsigned int channel{0}; channel != channels; ++channel) {
+    auto &state{channel_states[channel]};
+    state.square_sums[square_sum_index] = state.block_square_sum;
+    state.block_square_sum = 0.0f;
+    float total{0.0f};
+    for(float const sum : state.square_sums) total += sum;
+    published[channel].rms.store(std::sqrt(total / (frames * static_cast<float>(rms_blocks))), std::memory_order_relaxed);
+    for(auto &filter_state : state.k_weighting) {                               // silence decays the filter state towards subnormals
+      filter_state.z1 = denormal::snap(filter_state.z1);
+      filter_state.z2 = denormal::snap(filter_state.z2);
+    }
+  }
+  square_sum_index = (square_sum_index + 1) % rms_blocks;
+}
+
+meter::reading meter::collect() {
+  /// Read the latest measurements, resetting the peaks so each reading covers the time since the last - GUI thread, one reader only
+  reading result{
+    .channels{},
+    .momentary{     momentary.load(     std::memory_order_relaxed)},
+    .short_term{    short_term.load(    std::memory_order_relaxed)},
+    .max_momentary{ max_momentary.load( std::memory_order_relaxed)},
+    .max_short_term{max_short_term.load(std::memory_order_relaxed)},
+    .max_true_peak{ max_true_peak.load( std::memory_order_relaxed)},
+  };
+  result.channels.reserve(channels);
+  for(auto &channel : published) {
+    result.channels.emplace_back(channel_reading{
+      .peak{     channel.peak.exchange(     0.0f, std::memory_order_relaxed)},
+      .true_peak{channel.true_peak.exchange(0.0f, std::memory_order_relaxed)},
+      .rms{      channel.rms.load(                std::memory_order_relaxed)},
+    });
+  }
+  return result;
+}
+
+void meter::reset_maximums() {
+  /// Start measuring maximums afresh - GUI thread
+  max_momentary.store( -std::numeric_limits<float>::infinity(), std::memory_order_relaxed);
+  max_short_term.store(-std::numeric_limits<float>::infinity(), std::memory_order_relaxed);
+  max_true_peak.store(0.0f, std::memory_order_relaxed);
+}
+
+float meter::to_decibels(float const linear) {
+  /// Convert a linear level to decibels relative to full scale
+  return 20.0f * std::log10(linear);
+}
+
+}
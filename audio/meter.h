@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <limits>
+#include <span>
+#include <vector>
+#include <emscripten/webaudio.h>
+
+namespace audio {
+
+class meter {
+  /// Level and loudness meter for one bus: sample peak, 4x oversampled true peak, RMS, and EBU R128 momentary and short-term loudness
+  /// Measured on the audio thread and published through atomics, so the GUI can read it at any time without locking
+public:
+  static unsigned int constexpr oversampling{4};
+  static unsigned int constexpr taps_per_phase{12};                             // 48-tap interpolator, as recommended by ITU-R BS.1770 annex 2
+
+  struct channel_reading {                                                      // linear full-scale values
+    float peak{0.0f};                                                           // highest sample since the last reading
+    float true_peak{0.0f};                                                      // highest interpolated sample since the last reading
+    float rms{0.0f};                                                            // over the last 300ms
+  };
+  struct reading {
+    std::vector<channel_reading> channels;
+    float momentary{-std::numeric_limits<float>::infinity()};                   // LUFS over the last 400ms
+    float short_term{-std::numeric_limits<float>::infinity()};                  // LUFS over the last 3s
+    float max_momentary{-std::numeric_limits<float>::infinity()};               // highest since reset
+    float max_short_term{-std::numeric_limits<float>::infinity()};
+    float max_true_peak{0.0f};                                                  // highest since reset, linear
+  };
+
+private:
+  struct biquad {
+    float b0{1.0f};
+    float b1{0.0f};
+    float b2{0.0f};
+    float a1{0.0f};
+    float a2{0.0f};
+  };
+  struct biquad_state {                                                         // transposed direct form II
+    float z1{0.0f};
+    float z2{0.0f};
+  };
+
+  static unsigned int constexpr block_milliseconds{100};                        // loudness is measured in 100ms blocks, with 75% overlap for momentary
+  static unsigned int constexpr momentary_blocks{4};
+  static unsigned int constexpr short_term_blocks{30};
+  static unsigned int constexpr rms_blocks{3};
+
+  struct channel_state {                                                        // owned by the audio thread
+    std::array<biquad_state, 2> k_weighting;
+    std::array<float, taps_per_phase - 1> history{};                            // last input samples, to continue the interpolator across quanta
+    float block_square_sum{0.0f};
+    std::array<float, rms_blocks> square_sums{};
+  };
+  struct channel_publication {                                                  // written by the audio thread, read by the GUI
+    std::atomic<float> peak{0.0f};
+    std::atomic<float> true_peak{0.0f};
+    std::atomic<float> rms{0.0f};
+  };
+
+  unsigned int const channels;
+  std::vector<channel_state> channel_states;
+  std::vector<channel_publication> published;
+  std::vector<float> scratch;                                                   // preallocated interpolator input: history followed by one quantum
+
+  std::array<std::array<float, taps_per_phase>, oversampling> interpolator{};   // polyphase filter, one row per output phase
+  std::array<biquad, 2> k_filter{};                                             // K-weighting: high shelf then high pass
+
+  unsigned int block_frames{0};                                                 // set by set_sample_rate
+  unsigned int block_position{0};
+  float block_energy{0.0f};                                                     // K-weighted, summed across channels
+  std::array<float, short_term_blocks> energy_history{};                        // mean square per block, newest at energy_index - 1
+  unsigned int energy_index{0};
+  unsigned int energy_count{0};
+  unsigned int square_sum_index{0};
+
+  std::atomic<float> momentary{-std::numeric_limits<float>::infinity()};
+  std::atomic<float> short_term{-std::numeric_limits<float>::infinity()};
+  std::atomic<float> max_momentary{-std::numeric_limits<float>::infinity()};
+  std::atomic<float> max_short_term{-std::numeric_limits<float>::infinity()};
+  std::atomic<float> max_true_peak{0.0f};
+
+public:
+  explicit meter(unsigned int channels, unsigned int max_frames_per_quantum = 1024);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+
+  void process(std::span<AudioSampleFrame const> outputs);
+
+  reading collect();
+  void reset_maximums();
+
+  static float to_decibels(float linear);
+
+private:
+  void finish_block();
+};
+
+}
@@ -0,0 +1,174 @@
+#include "mix.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "simd/simd.h"
+#if !defined(__wasm_simd128__) && defined(__SSE__)
+  #include <xmmintrin.h>
+#endif
+
+namespace audio::mix {
+
+std::span<float> channel(AudioSampleFrame const &frame, unsigned int const index) {
+  /// View one channel of a planar frame
+  assert(index < static_cast<unsigned int>(frame.numberOfChannels) && "channel index out of range");
+  auto const samples{static_cast<size_t>(frame.samplesPerChannel)};
+  return {frame.data + index * samples, samples};
+}
+
+void clear(std::span<float> const destination) {
+  /// Fill with silence
+  std::memset(destination.data(), 0, destination.size_bytes());                 // memset is reliably lowered to the fastest available fill, including wasm bulk memory
+}
+
+void clear(AudioSampleFrame const &frame) {
+  /// Fill all channels of a frame with silence
+  clear({frame.data, static_cast<size_t>(frame.numberOfChannels) * static_cast<size_t>(frame.samplesPerChannel)});
+}
+
+void copy(std::span<float const> const source, std::span<float> const destination) {
+  /// Copy samples, up to the length of the shorter span
+  std::memcpy(destination.data(), source.data(), std::min(source.size(), destination.size()) * sizeof(float));
+}
+
+void accumulate(std::span<float const> const source, std::span<float> const bus, float const gain) {
+  /// Add a source into a bus with the given gain: bus += source * gain
+  size_t const count{std::min(source.size(), bus.size())};
+  simd::batch const gain_batch{simd::broadcast(gain)};
+  size_t i{0};
+  for(; i + simd::width <= count; i += simd::width) {
+    simd::store(&bus[i], simd::multiply_add(simd::load(&source[i]), gain_batch, simd::load(&bus[i])));
+  }
+  for(; i != count; ++i) {
+    bus[i] += source[i] * gain;
+  }
+}
+
+void accumulate(std::span<std::span<float const> const> const sources, std::span<float const> const gains, std::span<float> const bus) {
+  /// Add many sources into a bus with individual gains, in a single pass over the bus so it stays in registers
+  /// All sources must be at least as long as the bus
+  assert(gains.size() >= sources.size() && "accumulate needs a gain for every source");
+  size_t const count{bus.size()};
+  size_t i{0};
+  for(; i + simd::width <= count; i += simd::width) {
+    simd::batch sum{simd::load(&bus[i])};
+    for(size_t source{0}; source != sources.size(); ++source) {
+      assert(sources[source].size() >= count);
+      sum = simd::multiply_add(simd::load(&sources[source][i]), simd::broadcast(gains[source]), sum);
+    }
+    simd::store(&bus[i], sum);
+  }
+  for(; i != count; ++i) {
+    float sum{bus[i]};
+    for(size_t source{0}; source != sources.size(); ++source) {
+      sum += sources[source][i] * gains[source];
+    }
+    bus[i] = sum;
+  }
+}
+
+void upmix_mono(std::span<float const> const mono, AudioSampleFrame const &output) {
+  /// Copy a mono signal to every channel of the output - the mono source may itself be one of the output's channels
+  for(unsigned int index{0}; index != static_cast<unsigned int>(output.numberOfChannels); ++index) {
+    auto const destination{channel(output, index)};
+    if(destination.data() == mono.data()) continue;
+    copy(mono, destination);
+  }
+}
+
+void downmix_stereo(AudioSampleFrame const &input, std::span<float> const mono) {
+  /// Mix a stereo frame down to mono as the mean of both channels - mono frames are copied, and extra channels are ignored
+  if(input.numberOfChannels < 2) {
+    copy(channel(input, 0), mono);
+    return;
+  }
+  auto const left{channel(input, 0)};
+  auto const right{channel(input, 1)};
+  size_t const count{std::min(left.size(), mono.size())};
+  simd::batch const half{simd::broadcast(0.5f)};
+  size_t i{0};
+  for(; i + simd::width <= count; i += simd::width) {
+    simd::store(&mono[i], (simd::load(&left[i]) + simd::load(&right[i])) * half);
+  }
+  for(; i != count; ++i) {
+    mono[i] = (left[i] + right[i]) * 0.5f;
+  }
+}
+
+void interleave(AudioSampleFrame const &planar, std::span<float> const interleaved) {
+  /// Convert planar channels to interleaved frames, as used by codecs and file formats
+  auto const channels{static_cast<size_t>(planar.numberOfChannels)};
+  auto const frames{static_cast<size_t>(planar.samplesPerChannel)};
+  assert(interleaved.size() >= channels * frames && "interleave destination too small");
+  size_t i{0};
+  if(channels == 2) {                                                           // stereo fast path: zip four frames per step
+    float const *left{planar.data};
+    float const *right{planar.data + frames};
+    #if defined(__wasm_simd128__)
+      for(; i + 4 <= frames; i += 4) {
+        v128_t const left_batch{wasm_v128_load(&left[i])};
+        v128_t const right_batch{wasm_v128_load(&right[i])};
+        wasm_v128_store(&interleaved[i * 2],     wasm_i32x4_shuffle(left_batch, right_batch, 0, 4, 1, 5));
+        wasm_v128_store(&interleaved[i * 2 + 4], wasm_i32x4_shuffle(left_batch, right_batch, 2, 6, 3, 7));
+      }
+    #elif defined(__SSE__)
+      for(; i + 4 <= frames; i += 4) {
+        __m128 const left_batch{_mm_loadu_ps(&left[i])};
+        __m128 const right_batch{_mm_loadu_ps(&right[i])};
+        _mm_storeu_ps(&interleaved[i * 2],     _mm_unpacklo_ps(left_batch, right_batch));
+        _mm_storeu_ps(&interleaved[i * 2 + 4], _mm_unpackhi_ps(left_batch, right_batch));
+      }
+    #endif
+    for(; i != frames; ++i) {
+      interleaved[i * 2]     = left[i];
+      interleaved[i * 2 + 1] = right[i];
+    }
+    return;
+  }
+  for(size_t index{0}; index != channels; ++index) {                            // general case: strided scatter per channel
+    float const *source{planar.data + index * frames};
+    for(i = 0; i != frames; ++i) {
+      interleaved[i * channels + index] = source[i];
+    }
+  }
+}
+
+void deinterleave(std::span<float const> const interleaved, AudioSampleFrame const &planar) {
+  /// Convert interleaved frames to planar channels
+  auto const channels{static_cast<size_t>(planar.numberOfChannels)};
+  auto const frames{static_cast<size_t>(planar.samplesPerChannel)};
+  assert(interleaved.size() >= channels * frames && "deinterleave source too small");
+  size_t i{0};
+  if(channels == 2) {                                                           // stereo fast path: unzip four frames per step
+    float *left{planar.data};
+    float *right{planar.data + frames};
+    #if defined(__wasm_simd128__)
+      for(; i + 4 <= frames; i += 4) {
+        v128_t const low{wasm_v128_load(&interleaved[i * 2])};
+        v128_t const high{wasm_v128_load(&interleaved[i * 2 + 4])};
+        wasm_v128_store(&left[i],  wasm_i32x4_shuffle(low, high, 0, 2, 4, 6));
+        wasm_v128_store(&right[i], wasm_i32x4_shuffle(low, high, 1, 3, 5, 7));
+      }
+    #elif defined(__SSE__)
+      for(; i + 4 <= frames; i += 4) {
+        __m128 const low{_mm_loadu_ps(&interleaved[i * 2])};
+        __m128 const high{_mm_loadu_ps(&interleaved[i * 2 + 4])};
+        _mm_storeu_ps(&left[i],  _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(&right[i], _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+      }
+    #endif
+    for(; i != frames; ++i) {
+      left[i]  = interleaved[i * 2];
+      right[i] = interleaved[i * 2 + 1];
+    }
+    return;
+  }
+  for(size_t index{0}; index != channels; ++index) {                            // general case: strided gather per channel
+    float *destination{planar.data + index * frames};
+    for(i = 0; i != frames; ++i) {
+      destination[i] = interleaved[i * channels + index];
+    }
+  }
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <span>
+#include <emscripten/webaudio.h>
+
+namespace audio::mix {
+
+/// Vectorised kernels over planar AudioSampleFrame data and plain sample spans
+/// All spans may be of any length and alignment; destination and source must not partially overlap
+
+std::span<float> channel(AudioSampleFrame const &frame, unsigned int index);
+
+void clear(std::span<float> destination);
+void clear(AudioSampleFrame const &frame);
+void copy(std::span<float const> source, std::span<float> destination);
+
+void accumulate(std::span<float const> source, std::span<float> bus, float gain);
+void accumulate(std::span<std::span<float const> const> sources, std::span<float const> gains, std::span<float> bus);
+
+void upmix_mono(std::span<float const> mono, AudioSampleFrame const &output);
+void downmix_stereo(AudioSampleFrame const &input, std::span<float> mono);
+
+void interleave(AudioSampleFrame const &planar, std::span<float> interleaved);
+void deinterleave(std::span<float const> interleaved, AudioSampleFrame const &planar);
+
+}
@@ -0,0 +1,259 @@
+#include "modulation.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <span>
+#include "mix.h"
+#include "simd/simd.h"
+
+namespace audio {
+
+namespace {
+
+uint64_t pack(modulation::route const &value) {
+  /// Pack a route into one word for atomic publication: amount in the low 32 bits, then slot, source and destination
+  assert(value.slot <= 0xFF'FFu && "modulation route slot out of range");
+  return static_cast<uint64_t>(std::bit_cast<uint32_t>(value.amount))
+       | static_cast<uint64_t>(value.slot) << 32
+       | static_cast<uint64_t>(value.source) << 48
+       | static_cast<uint64_t>(value.destination) << 56;
+}
+
+modulation::route unpack(uint64_t const packed) {
+  /// Recover a route packed by pack()
+  return {
+    .source{static_cast<modulation::sources>((packed >> 48) & 0xFFu)},
+    .slot{static_cast<unsigned int>((packed >> 32) & 0xFF'FFu)},
+    .destination{static_cast<modulation::destinations>((packed >> 56) & 0xFFu)},
+    .amount{std::bit_cast<float>(static_cast<uint32_t>(packed))},
+  };
+}
+
+}
+
+modulation::modulation(unsigned int const new_voice_count, unsigned int const new_envelope_count, unsigned int const new_lfo_count)
+  : voice_count{new_voice_count},
+    lane_count{static_cast<unsigned int>((new_voice_count + simd::width - 1) / simd::width * simd::width)},
+    envelope_count{new_envelope_count},
+    lfo_count{new_lfo_count},
+    envelope_controls(new_envelope_count),
+    lfo_controls(new_lfo_count),
+    envelope_stages(new_envelope_count * lane_count, stages::idle),
+    envelope_levels(new_envelope_count * lane_count),
+    envelope_targets(lane_count),
+    envelope_coefficients(lane_count),
+    lfo_phases(new_lfo_count * lane_count),
+    lfo_values(new_lfo_count * lane_count),
+    pitch(lane_count),
+    cutoff(lane_count),
+    gain(lane_count, 1.0f) {
+  /// Preallocate all per-voice state
+  assert(envelope_count <= 32 && "gain_envelope_mask has one bit per envelope slot");
+}
+
+void modulation::set_envelope(unsigned int const slot, envelope_parameters const &params) {
+  /// Change the segment times and sustain level of one envelope slot for all voices - main thread
+  assert(slot < envelope_count && "envelope slot out of range");
+  auto &control{envelope_controls[slot]};
+  control.attack.store( params.attack,  std::memory_order_relaxed);
+  control.decay.store(  params.decay,   std::memory_order_relaxed);
+  control.sustain.store(params.sustain, std::memory_order_relaxed);
+  control.release.store(params.release, std::memory_order_relaxed);
+}
+
+void modulation::set_lfo(unsigned int const slot, lfo_parameters const &params) {
+  /// Change the rate and shape of one LFO slot for all voices - main thread
+  assert(slot < lfo_count && "LFO slot out of range");
+  auto &control{lfo_controls[slot]};
+  control.rate.store( params.rate,  std::memory_order_relaxed);
+  control.shape.store(params.shape, std::memory_order_relaxed);
+}
+
+void modulation::set_route(unsigned int const index, route const &new_route) {
+  /// Set one entry of the modulation matrix, set the amount to zero to disable it - main thread
+  assert(index < max_routes && "modulation route index out of range");
+  route_controls[index].store(pack(new_route), std::memory_order_relaxed);
+}
+
+void modulation::trigger(unsigned int const voice) {
+  /// Note on: start all envelopes of a voice from their current level, and restart its LFOs - audio thread
+  assert(voice < voice_count && "voice index out of range in trigger");
+  for(unsigned int slot{0}; slot != envelope_count; ++slot) {
+    envelope_stages[slot * lane_count + voice] = stages::attack;
+  }
+  for(unsigned int slot{0}; slot != lfo_count; ++slot) {
+    lfo_phases[slot * lane_count + voice] = 0.0f;
+  }
+}
+
+void modulation::release(unsigned int const voice) {
+  /// Note off: move all sounding envelopes of a voice to their release stage - audio thread
+  assert(voice < voice_count && "voice index out of range in release");
+  for(unsigned int slot{0}; slot != envelope_count; ++slot) {
+    auto &stage{envelope_stages[slot * lane_count + voice]};
+    if(stage != stages::idle) stage = stages::release;
+  }
+}
+
+bool modulation::is_releasing(unsigned int const voice) const {
+  /// Whether a voice has been released but is still audible through an envelope routed to gain - audio thread
+  for(unsigned int slot{0}; slot != envelope_count; ++slot) {
+    if((gain_envelope_mask & (1u << slot)) == 0) continue;
+    if(envelope_stages[slot * lane_count + voice] == stages::release) return true;
+  }
+  return false;
+}
+
+float modulation::get_pitch(unsigned int const voice) const {
+  return pitch[voice];
+}
+float modulation::get_cutoff(unsigned int const voice) const {
+  return cutoff[voice];
+}
+float modulation::get_gain(unsigned int const voice) const {
+  return gain[voice];
+}
+std::span<float const> modulation::get_envelope(unsigned int const slot) const {
+  /// Current level of one envelope slot for every voice, padded to whole SIMD batches, for sources that use envelopes directly rather than through routes
+  assert(slot < envelope_count && "envelope slot out of range");
+  return {&envelope_levels[slot * lane_count], lane_count};
+}
+
+void modulation::evaluate(unsigned int const frames, float const sample_rate) {
+  /// Advance all envelopes and LFOs by one block, and apply the modulation matrix - audio thread
+  if(sample_rate <= 0.0f) return;
+  evaluate_envelopes(frames, sample_rate);
+  evaluate_lfos(frames, sample_rate);
+  evaluate_routes();
+}
+
+void modulation::evaluate_envelopes(unsigned int const frames, float const sample_rate) {
+  /// Exponential segments in closed form: each block moves every level a fixed fraction of the way to its stage target
+  float constexpr attack_target{1.2f};                                          // aim past full scale so the attack curve stays steep, as analogue envelopes do
+  float constexpr release_floor{1.0e-4f};                                       // -80dB, below which a releasing envelope goes idle, and a decaying one settles on its sustain level
+  float constexpr minimum_time{1.0e-4f};                                        // avoid division by zero for instantaneous segments
+  float const block_seconds{static_cast<float>(frames) / sample_rate};
+  auto const coefficient{[&](float const time){
+    return std::exp(-block_seconds / std::max(time, minimum_time));
+  }};
+
+  for(unsigned int slot{0}; slot != envelope_count; ++slot) {
+    auto const &control{envelope_controls[slot]};
+    std::array<float, static_cast<size_t>(stages::count)> const stage_targets{
+      0.0f,                                                                     // idle
+      attack_target,
+      std::clamp(control.sustain.load(std::memory_order_relaxed), 0.0f, 1.0f),
+      0.0f,                                                                     // release
+    };
+    std::array<float, static_cast<size_t>(stages::count)> const stage_coefficients{
+      1.0f,                                                                     // idle levels hold at zero
+      coefficient(control.attack.load( std::memory_order_relaxed)),
+      coefficient(control.decay.load(  std::memory_order_relaxed)),
+      coefficient(control.release.load(std::memory_order_relaxed)),
+    };
+
+    stages *slot_stages{&envelope_stages[slot * lane_count]};
+    float *levels{&envelope_levels[slot * lane_count]};
+
+    // gather the segment constants for each lane's stage - transcendental maths is done per slot above, never per voice
+    for(unsigned int lane{0}; lane != lane_count; ++lane) {
+      auto const stage_index{static_cast<size_t>(slot_stages[lane])};
+      envelope_targets[lane]      = stage_targets[stage_index];
+      envelope_coefficients[lane] = stage_coefficients[stage_index];
+    }
+
+    // level = target + (level - target) * coefficient, for all voices at once
+    for(unsigned int lane{0}; lane != lane_count; lane += simd::width) {
+      simd::batch const target{simd::load(&envelope_targets[lane])};
+      simd::store(&levels[lane], simd::multiply_add(simd::load(&levels[lane]) - target, simd::load(&envelope_coefficients[lane]), target));
+    }
+
+    // stage transitions are rare, so a scalar pass to detect them is cheap
+    for(unsigned int lane{0}; lane != lane_count; ++lane) {
+      if(slot_stages[lane] == stages::attack && levels[lane] >= 1.0f) {
+        levels[lane] = 1.0f;
+        slot_stages[lane] = stages::decay;
+      } else if(slot_stages[lane] == stages::decay && std::abs(levels[lane] - envelope_targets[lane]) < release_floor) {
+        levels[lane] = envelope_targets[lane];                                  // exact, so decay towards a sustain of zero never becomes subnormal, as flushing is unavailable on wasm
+      } else if(slot_stages[lane] == stages::release && levels[lane] < release_floor) {
+        levels[lane] = 0.0f;
+        slot_stages[lane] = stages::idle;
+      }
+    }
+  }
+}
+
+void modulation::evaluate_lfos(unsigned int const frames, float const sample_rate) {
+  /// Advance LFO phases by one block and evaluate their shapes, for all voices at once
+  simd::batch const one{simd::broadcast(1.0f)};
+  simd::batch const two{simd::broadcast(2.0f)};
+  simd::batch const four{simd::broadcast(4.0f)};
+  for(unsigned int slot{0}; slot != lfo_count; ++slot) {
+    auto const &control{lfo_controls[slot]};
+    simd::batch const increment{simd::broadcast(control.rate.load(std::memory_order_relaxed) * static_cast<float>(frames) / sample_rate)};
+    bool const sine{control.shape.load(std::memory_order_relaxed) == lfo_shapes::sine};
+    float *phases{&lfo_phases[slot * lane_count]};
+    float *values{&lfo_values[slot * lane_count]};
+    for(unsigned int lane{0}; lane != lane_count; lane += simd::width) {
+      simd::batch phase{simd::load(&phases[lane]) + increment};
+      phase = phase - simd::floor(phase);                                       // wrap to 0 to 1
+      simd::store(&phases[lane], phase);
+      simd::batch const bipolar{phase * two - one};                             // -1 to 1
+      simd::batch const magnitude{simd::abs(bipolar)};
+      if(sine) {
+        simd::store(&values[lane], four * bipolar * (magnitude - one));         // parabolic sine approximation, within 6% and smooth enough for modulation
+      } else {
+        simd::store(&values[lane], magnitude * two - one);
+      }
+    }
+  }
+}
+
+void modulation::evaluate_routes() {
+  /// Sum every active route into the per-voice destinations
+  std::fill(pitch.begin(), pitch.end(), 0.0f);
+  std::fill(cutoff.begin(), cutoff.end(), 0.0f);
+  std::fill(gain.begin(), gain.end(), 1.0f);
+  gain_envelope_mask = 0;
+
+  for(auto const &control : route_controls) {
+    auto const [source_type, slot, destination, amount]{unpack(control.load(std::memory_order_relaxed))};
+    if(std::abs(amount) < 1.0e-6f) continue;                                    // disabled route
+
+    std::span<float const> source;
+    switch(source_type) {
+    case sources::envelope:
+      if(slot >= envelope_count) continue;
+      source = {&envelope_levels[slot * lane_count], lane_count};
+      if(destination == destinations::gain) gain_envelope_mask |= 1u << slot;
+      break;
+    case sources::lfo:
+      if(slot >= lfo_count) continue;
+      source = {&lfo_values[slot * lane_count], lane_count};
+      break;
+    }
+
+    switch(destination) {
+    case destinations::pitch:
+      mix::accumulate(source, pitch, amount);
+      break;
+    case destinations::cutoff:
+      mix::accumulate(source, cutoff, amount);
+      break;
+    case destinations::gain:
+      {
+        simd::batch const amount_batch{simd::broadcast(amount)};
+        simd::batch const one{simd::broadcast(1.0f)};
+        simd::batch const zero{simd::broadcast(0.0f)};
+        for(unsigned int lane{0}; lane != lane_count; lane += simd::width) {
+          simd::batch const scale{simd::multiply_add(simd::load(&source[lane]) - one, amount_batch, one)};
+          simd::store(&gain[lane], simd::max(simd::load(&gain[lane]) * scale, zero));
+        }
+      }
+      break;
+    }
+  }
+}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace audio {
+
+class modulation {
+  /// Envelope generators and LFOs for every voice, with a matrix routing them to pitch, filter cutoff and gain
+  /// State is stored structure-of-arrays, one contiguous lane per voice for each slot, and evaluated with SIMD once per block
+  /// The patch (segment times, LFO rates and routes) is shared by all voices, and may be changed from the main thread at any time
+public:
+  enum class sources : uint8_t {
+    envelope,                                                                   // unipolar, 0 to 1
+    lfo,                                                                        // bipolar, -1 to 1
+  };
+  enum class destinations : uint8_t {
+    pitch,                                                                      // additive, in semitones
+    cutoff,                                                                     // additive, in octaves
+    gain,                                                                       // multiplicative: each route scales gain by 1 + amount * (source - 1)
+  };
+  enum class lfo_shapes : uint8_t {
+    sine,
+    triangle,
+  };
+
+  struct envelope_parameters {                                                  // segment times are exponential time constants, in seconds
+    float attack{0.01f};
+    float decay{0.2f};
+    float sustain{0.7f};                                                        // level, 0 to 1
+    float release{0.3f};
+  };
+  struct lfo_parameters {
+    float rate{5.0f};                                                           // in Hz
+    lfo_shapes shape{lfo_shapes::sine};
+  };
+  struct route {
+    sources source{sources::envelope};
+    unsigned int slot{0};                                                       // which envelope or LFO of the given source type
+    destinations destination{destinations::gain};
+    float amount{0.0f};                                                         // zero disables the route
+  };
+
+  static unsigned int constexpr max_routes{8};
+
+private:
+  enum class stages : uint8_t {
+    idle,
+    attack,
+    decay,                                                                      // also holds the sustain level once reached
+    release,
+    count,
+  };
+
+  struct envelope_control {                                                     // written by the main thread, read by the audio thread
+    std::atomic<float> attack{envelope_parameters{}.attack};
+    std::atomic<float> decay{envelope_parameters{}.decay};
+    std::atomic<float> sustain{envelope_parameters{}.sustain};
+    std::atomic<float> release{envelope_parameters{}.release};
+  };
+  struct lfo_control {
+    std::atomic<float> rate{lfo_parameters{}.rate};
+    std::atomic<lfo_shapes> shape{lfo_parameters{}.shape};
+  };
+
+  unsigned int const voice_count;
+  unsigned int const lane_count;                                                // voice count rounded up to a whole number of SIMD batches, so no kernel needs a scalar tail
+  unsigned int const envelope_count;
+  unsigned int const lfo_count;
+
+  std::vector<envelope_control> envelope_controls;
+  std::vector<lfo_control> lfo_controls;
+  std::array<std::atomic<uint64_t>, max_routes> route_controls{};               // each route packed into a single word, so the audio thread never sees a mix of old and new fields - all zero is a disabled route
+
+  // per-voice state owned by the audio thread, indexed [slot * lane_count + voice]
+  std::vector<stages> envelope_stages;
+  std::vector<float> envelope_levels;
+  std::vector<float> envelope_targets;                                          // scratch: level each lane is heading towards in its current stage
+  std::vector<float> envelope_coefficients;                                     // scratch: fraction of the remaining distance still left after this block
+  std::vector<float> lfo_phases;                                                // 0 to 1
+  std::vector<float> lfo_values;
+
+  // modulation outputs for the current block, indexed [voice]
+  std::vector<float> pitch;
+  std::vector<float> cutoff;
+  std::vector<float> gain;
+
+  uint32_t gain_envelope_mask{0};                                               // envelope slots routed to gain, whose release keeps a voice sounding
+
+public:
+  modulation(unsigned int voice_count, unsigned int envelope_count = 2, unsigned int lfo_count = 2);
+
+  void set_envelope(unsigned int slot, envelope_parameters const &params);
+  void set_lfo(unsigned int slot, lfo_parameters const &params);
+  void set_route(unsigned int index, route const &new_route);
+
+  void trigger(unsigned int voice);
+  void release(unsigned int voice);
+  bool is_releasing(unsigned int voice) const;
+
+  void evaluate(unsigned int frames, float sample_rate);
+
+  float get_pitch(unsigned int voice) const;
+  float get_cutoff(unsigned int voice) const;
+  float get_gain(unsigned int voice) const;
+  std::span<float const> get_envelope(unsigned int slot) const;
+
+private:
+  void evaluate_envelopes(unsigned int frames, float sample_rate);
+  void evaluate_lfos(unsigned int frames, float sample_rate);
+  void evaluate_routes();
+};
+
+}
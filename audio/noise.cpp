@@ -0,0 +1,123 @@
+#include "noise.h"
+#include <bit>
+#include <cmath>
+#include "simd/simd.h"
+
+namespace audio {
+
+namespace {
+
+uint32_t constexpr hash_multiplier_1{0x7f'eb'35'2du};                           // lowbias32 constants, from Chris Wellons' hash prospector
+uint32_t constexpr hash_multiplier_2{0x84'6c'a6'8bu};
+float constexpr uniform_scale{1.0f / 8'388'608.0f};                             // signed 24-bit integers to [-1, 1)
+uint32_t constexpr row_offset{0x80'00'00'00u};                                  // pink rows draw from half a period ahead, uncorrelated with the white term
+
+uint32_t hash(uint32_t value) {
+  /// Bijective integer hash with near-ideal avalanche, so consecutive counters give unrelated outputs
+  value ^= value >> 16;
+  value *= hash_multiplier_1;
+  value ^= value >> 15;
+  value *= hash_multiplier_2;
+  value ^= value >> 16;
+  return value;
+}
+
+simd::uint_batch hash(simd::uint_batch value) {
+  /// The same hash on every lane of a batch
+  simd::uint_batch const multiplier_1{simd::broadcast_uint(hash_multiplier_1)};
+  simd::uint_batch const multiplier_2{simd::broadcast_uint(hash_multiplier_2)};
+  value = value ^ (value >> 16);
+  value = value * multiplier_1;
+  value = value ^ (value >> 15);
+  value = value * multiplier_2;
+  value = value ^ (value >> 16);
+  return value;
+}
+
+int32_t to_signed(uint32_t const bits) {
+  /// Top 24 bits as a signed integer
+  return static_cast<int32_t>(bits) >> 8;
+}
+
+float to_uniform(uint32_t const bits) {
+  /// Top 24 bits as a signed value, exactly representable in a float
+  return static_cast<float>(to_signed(bits)) * uniform_scale;
+}
+
+}
+
+noise::noise(uint32_t const seed, uint32_t const stream) {
+  reseed(seed, stream);
+}
+
+void noise::reseed(uint32_t const seed, uint32_t const stream) {
+  /// Start a stream afresh: each seed and stream pair starts at its own pseudo-random point in the 2^32 sample sequence
+  position = hash(seed ^ hash(stream + 0x9e'37'79'b9u));                        // offset by the golden ratio so stream 0 of seed 0 doesn't start at hash(0)
+  rows = {};
+  row_sum = 0;
+  brown_state = 0.0f;
+}
+
+void noise::generate(colours const colour, std::span<float> const output) {
+  /// Fill a buffer with the next samples of this stream, with a standard deviation of roughly 0.5 to 0.6 in every colour
+  fill_uniform(position, output);
+  switch(colour) {
+  case colours::white:
+    break;
+  case colours::pink:
+    filter_pink(output);
+    break;
+  case colours::brown:
+    filter_brown(output);
+    break;
+  }
+  position += static_cast<uint32_t>(output.size());
+}
+
+void noise::fill_uniform(uint32_t const start, std::span<float> const output) {
+  /// Uniform white noise in [-1, 1) from consecutive counters, a batch of lanes per step
+  size_t const count{output.size()};
+  size_t i{0};
+  simd::uint_batch counter{simd::sequence(start)};
+  simd::uint_batch const step{simd::broadcast_uint(static_cast<uint32_t>(simd::width))};
+  simd::batch const scale{simd::broadcast(uniform_scale)};
+  for(; i + simd::width <= count; i += simd::width) {
+    simd::store(&output[i], simd::to_float_signed(simd::shift_right_signed(hash(counter), 8)) * scale);
+    counter = counter + step;
+  }
+  for(; i != count; ++i) {
+    output[i] = to_uniform(hash(start + static_cast<uint32_t>(i)));
+  }
+}
+
+void noise::filter_pink(std::span<float> const samples) {
+  /// Voss-McCartney: a sum of rows each held for twice as long as the last, plus a fresh white term each sample
+  /// Which row changes is given by the trailing zeros of the counter, so exactly one row updates per sample and the sum is kept incrementally
+  /// Rows and their sum are integers, so the running sum is exact and can't drift however long the stream runs
+  float const scale{1.0f / std::sqrt(static_cast<float>(pink_rows + 1))};       // keep the same variance as white
+  uint32_t counter{position};
+  for(float &sample : samples) {
+    auto const row{static_cast<unsigned int>(std::countr_zero(counter))};       // counter 0 changes no row
+    if(row < pink_rows) {
+      int32_t const value{to_signed(hash(counter + row_offset))};
+      row_sum += value - rows[row];
+      rows[row] = value;
+    }
+    sample = (static_cast<float>(row_sum) * uniform_scale + sample) * scale;
+    ++counter;
+  }
+}
+
+void noise::filter_brown(std::span<float> const samples) {
+  /// Leaky integration of white noise, with the leak keeping it centred and bounded below about 15Hz at 48kHz
+  float constexpr leak{0.998f};
+  float const input_gain{std::sqrt(1.0f - leak * leak)};                        // unity variance gain
+  float state{brown_state};
+  for(float &sample : samples) {
+    state = state * leak + sample * input_gain;
+    sample = state;
+  }
+  brown_state = state;
+}
+
+}
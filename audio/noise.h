@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace audio {
+
+class noise {
+  /// Seedable noise stream: white from a counter-based generator vectorised across time, with pink and brown filtered from it
+  /// The same seed and stream always give the same samples, so offline renders are bit-reproducible, and streams are independent of each other
+public:
+  enum class colours : uint8_t {
+    white,                                                                      // flat spectrum
+    pink,                                                                       // -3dB per octave, Voss-McCartney
+    brown,                                                                      // -6dB per octave, leaky integration
+  };
+  static unsigned int constexpr pink_rows{15};                                  // octaves of the Voss-McCartney sum, flat down to about 1.5Hz at 48kHz
+
+private:
+  uint32_t position{0};                                                         // counter into the generator's sequence
+  std::array<int32_t, pink_rows> rows{};                                        // held values as signed 24-bit integers, row k updated every 2^(k + 1) samples
+  int32_t row_sum{0};                                                           // at most 15 * 2^23 in magnitude, so never overflows
+  float brown_state{0.0f};
+
+public:
+  explicit noise(uint32_t seed = 0, uint32_t stream = 0);
+
+  void reseed(uint32_t seed, uint32_t stream);
+
+  void generate(colours colour, std::span<float> output);
+
+  static void fill_uniform(uint32_t start, std::span<float> output);
+
+private:
+  void filter_pink(std::span<float> samples);
+  void filter_brown(std::span<float> samples);
+};
+
+}
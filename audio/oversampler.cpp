@@ -0,0 +1,189 @@
+#include "oversampler.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <boost/math/constants/constants.hpp>
+#include "mix.h"
+#include "simd/simd.h"
+
+namespace audio {
+
+namespace {
+
+std::array<unsigned int, oversampler::max_stages> constexpr stage_half_lengths{ // later stages see only the lower part of their band, so their transition can be much wider
+  32,                                                                           // 127 taps: passband to 0.45 of the base rate, stopband from 0.55
+  8,                                                                            // 31 taps
+  5,                                                                            // 19 taps
+};
+double constexpr stopband_attenuation{100.0};                                   // in dB, comfortably below 16-bit and the nonlinearities' own distortion
+
+double bessel_i0(double const x) {
+  /// Zeroth order modified Bessel function of the first kind, by its power series
+  double sum{1.0};
+  double term{1.0};
+  for(unsigned int k{1}; term > sum * 1.0e-12; ++k) {
+    double const factor{x / (2.0 * static_cast<double>(k))};
+    term *= factor * factor;
+    sum += term;
+  }
+  return sum;
+}
+
+std::vector<float> design_half_band(unsigned int const half_length) {
+  /// Kaiser-windowed sinc with its cutoff at a quarter of the raised rate, keeping only the non-zero off-centre taps
+  double constexpr pi{boost::math::constants::pi<double>()};
+  double constexpr beta{0.1102 * (stopband_attenuation - 8.7)};
+  auto const centre{static_cast<double>(2 * half_length - 1)};                  // (taps - 1) / 2
+  std::vector<float> coefficients(half_length);
+  double sum{0.0};
+  for(unsigned int m{1}; m <= half_length; ++m) {
+    auto const offset{static_cast<double>(2 * m - 1)};
+    double const sinc{std::sin(pi * offset / 2.0) / (pi * offset / 2.0)};
+    double const ratio{offset / centre};
+    double const window{bessel_i0(beta * std::sqrt(1.0 - ratio * ratio)) / bessel_i0(beta)};
+    coefficients[m - 1] = static_cast<float>(sinc * window);
+    sum += sinc * window;
+  }
+  for(auto &coefficient : coefficients) {                                       // each output of the filtered phase sums two inputs per coefficient, so normalise the pairs to 0.5 for unity DC gain
+    coefficient = static_cast<float>(static_cast<double>(coefficient) * 0.5 / sum);
+  }
+  return coefficients;
+}
+
+void filter_phase(float const *input, unsigned int const half_length, std::span<float const> const coefficients, std::span<float> const output) {
+  /// output[i] = sum over m of c[m] * (input[i - K + m] + input[i - K + 1 - m]), for m from 1 to K, vectorised across i
+  /// input must have 2K - 1 frames of history before it
+  size_t const count{output.size()};
+  float const *centre{input - half_length};
+  size_t i{0};
+  for(; i + simd::width <= count; i += simd::width) {
+    simd::batch sum{simd::broadcast(0.0f)};
+    for(unsigned int m{1}; m <= half_length; ++m) {
+      simd::batch const pair{simd::load(&centre[i + m]) + simd::load(&centre[i + 1 - m])};
+      sum = simd::multiply_add(simd::broadcast(coefficients[m - 1]), pair, sum);
+    }
+    simd::store(&output[i], sum);
+  }
+  for(; i != count; ++i) {
+    float sum{0.0f};
+    for(unsigned int m{1}; m <= half_length; ++m) {
+      sum += coefficients[m - 1] * (centre[i + m] + centre[i + 1 - m]);
+    }
+    output[i] = sum;
+  }
+}
+
+}
+
+oversampler::oversampler(unsigned int const max_frames_per_quantum)
+  : oversampled(static_cast<size_t>(max_frames_per_quantum) * max_factor) {
+  /// Design each stage's filter and allocate its buffers for the largest quantum at that stage's input rate
+  for(unsigned int index{0}; index != max_stages; ++index) {
+    auto &target{stages[index]};
+    unsigned int const half_length{stage_half_lengths[index]};
+    size_t const frames{static_cast<size_t>(max_frames_per_quantum) << index};  // this stage's lower rate
+    target.half_length = half_length;
+    target.coefficients = design_half_band(half_length);
+    target.up_input.resize(2 * half_length - 1 + frames);
+    target.up_even.resize(frames);
+    target.down_even.resize(2 * half_length - 1 + frames);
+    target.down_odd.resize(half_length + frames);
+  }
+}
+
+void oversampler::set_factor(unsigned int const new_factor) {
+  /// Choose 1, 2, 4 or 8 times oversampling, clearing the filter history - doesn't allocate, so may be called on the audio thread
+  assert(std::has_single_bit(new_factor) && new_factor <= max_factor && "oversampling factor must be 1, 2, 4 or 8");
+  active_stages = static_cast<unsigned int>(std::countr_zero(new_factor));
+  reset();
+}
+
+unsigned int oversampler::get_factor() const {
+  return 1u << active_stages;
+}
+
+float oversampler::get_latency() const {
+  /// Delay of a round trip through upsample and downsample, in frames at the base rate
+  /// Each stage delays by 2K - 1 frames at its lower rate, K - 1/2 each way
+  float latency{0.0f};
+  for(unsigned int index{0}; index != active_stages; ++index) {
+    latency += static_cast<float>(2 * stages[index].half_length - 1) / static_cast<float>(1u << index);
+  }
+  return latency;
+}
+
+void oversampler::reset() {
+  /// Clear the filter history, as after silence
+  for(auto &target : stages) {
+    mix::clear(target.up_input);
+    mix::clear(target.down_even);
+    mix::clear(target.down_odd);
+  }
+}
+
+std::span<float> oversampler::upsample(std::span<float const> const input) {
+  /// Raise the rate of one quantum through each active stage, returning the result for processing in place before downsample
+  assert(input.size() * get_factor() <= oversampled.size() && "quantum larger than oversampler was constructed for");
+  std::span<float const> stage_input{input};
+  for(unsigned int index{0}; index != active_stages; ++index) {
+    auto const stage_output{std::span{oversampled}.first(stage_input.size() * 2)}; // each stage copies its input before writing, so all can share one buffer
+    upsample_stage(stages[index], stage_input, stage_output);
+    stage_input = stage_output;
+  }
+  return std::span{oversampled}.first(stage_input.size());
+}
+
+void oversampler::downsample(std::span<float> const output) {
+  /// Lower the processed signal back to the base rate through each active stage in reverse
+  size_t frames{output.size() * get_factor()};
+  for(unsigned int index{active_stages}; index-- != 0;) {
+    auto const stage_input{std::span<float const>{oversampled}.first(frames)};
+    frames /= 2;
+    downsample_stage(stages[index], stage_input, index == 0 ? output : std::span{oversampled}.first(frames));
+  }
+}
+
+void oversampler::upsample_stage(stage &target, std::span<float const> const input, std::span<float> const output) {
+  /// Zero-stuff and filter to twice the rate: the filtered phase interpolates halfway between inputs, and the other phase is the delayed input itself
+  unsigned int const half_length{target.half_length};
+  size_t const history{2 * half_length - 1};
+  size_t const frames{input.size()};
+  mix::copy(input, std::span{target.up_input}.subspan(history, frames));
+  float const *current{&target.up_input[history]};
+  auto const even{std::span{target.up_even}.first(frames)};
+  filter_phase(current, half_length, target.coefficients, even);
+  float const *delayed{current - (half_length - 1)};
+  for(size_t i{0}; i != frames; ++i) {
+    output[2 * i]     = even[i];
+    output[2 * i + 1] = delayed[i];
+  }
+  std::copy_n(target.up_input.begin() + static_cast<ptrdiff_t>(frames), history, target.up_input.begin()); // keep the newest frames as history
+}
+
+void oversampler::downsample_stage(stage &target, std::span<float const> const input, std::span<float> const output) {
+  /// Filter and decimate to half the rate, splitting the input into its two phases so only the non-zero taps are computed
+  unsigned int const half_length{target.half_length};
+  size_t const even_history{2 * half_length - 1};
+  size_t const frames{output.size()};
+  float *even{&target.down_even[even_history]};
+  float *odd{&target.down_odd[half_length]};
+  for(size_t i{0}; i != frames; ++i) {
+    even[i] = input[2 * i];
+    odd[i]  = input[2 * i + 1];
+  }
+  filter_phase(even, half_length, target.coefficients, output);
+  float const *odd_delayed{odd - half_length};                                  // the centre tap is a pure delay on the odd phase
+  size_t i{0};
+  simd::batch const half{simd::broadcast(0.5f)};
+  for(; i + simd::width <= frames; i += simd::width) {
+    simd::store(&output[i], (simd::load(&output[i]) + simd::load(&odd_delayed[i])) * half);
+  }
+  for(; i != frames; ++i) {
+    output[i] = (output[i] + odd_delayed[i]) * 0.5f;
+  }
+  std::copy_n(target.down_even.begin() + static_cast<ptrdiff_t>(frames), even_history, target.down_even.begin());
+  std::copy_n(target.down_odd.begin()  + static_cast<ptrdiff_t>(frames), half_length,  target.down_odd.begin());
+}
+
+}
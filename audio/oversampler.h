@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <vector>
+
+namespace audio {
+
+class oversampler {
+  /// Raises the sample rate of one channel by 2, 4 or 8 through cascaded 2x half-band stages, so nonlinear processing can run above the audible band
+  /// Each stage is a linear phase half-band FIR in polyphase form: every other tap is zero and one phase is a pure delay,
+  /// so a stage costs one short symmetric FIR per input sample each way, vectorised across time
+  /// All stages are allocated up front, so the factor can be changed on the audio thread
+public:
+  static unsigned int constexpr max_stages{3};
+  static unsigned int constexpr max_factor{1u << max_stages};
+
+private:
+  struct stage {
+    unsigned int half_length{0};                                                // K: non-zero off-centre taps on each side of the centre, so the filter has 4K - 1 taps
+    std::vector<float> coefficients;                                            // K symmetric tap pairs, outermost last, scaled for unity gain in the interpolating phase
+    std::vector<float> up_input;                                                // 2K - 1 frames of history followed by the input being upsampled
+    std::vector<float> up_even;                                                 // scratch for the filtered phase of the upsampled output
+    std::vector<float> down_even;                                               // even and odd phases of the input being downsampled, each after its history
+    std::vector<float> down_odd;
+  };
+
+  std::array<stage, max_stages> stages;
+  unsigned int active_stages{0};
+  std::vector<float> oversampled;                                               // the signal at the raised rate, upsampled and downsampled in place
+
+public:
+  explicit oversampler(unsigned int max_frames_per_quantum = 1024);
+
+  void set_factor(unsigned int new_factor);
+  unsigned int get_factor() const;
+  float get_latency() const;
+  void reset();
+
+  std::span<float> upsample(std::span<float const> input);
+  void downsample(std::span<float> output);
+
+  template<typename F>
+  void process(std::span<float> data, F &&function);
+
+private:
+  static void upsample_stage(stage &target, std::span<float const> input, std::span<float> output);
+  static void downsample_stage(stage &target, std::span<float const> input, std::span<float> output);
+};
+
+template<typename F>
+void oversampler::process(std::span<float> const data, F &&function) {
+  /// Run a function over the data at the raised rate, in place - at a factor of 1 it sees the data directly
+  if(active_stages == 0) {
+    function(data);
+    return;
+  }
+  function(upsample(data));
+  downsample(data);
+}
+
+}
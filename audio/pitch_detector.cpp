@@ -0,0 +1,133 @@
+#include "pitch_detector.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include "mix.h"
+#include "simd/simd.h"
+
+namespace audio {
+
+pitch_detector::pitch_detector(unsigned int const window_frames, unsigned int const new_max_lag, unsigned int const new_hop_frames)
+  : hop_frames{new_hop_frames},
+    hop_count{window_frames / new_hop_frames},
+    max_lag{new_max_lag},
+    history(new_max_lag + new_hop_frames),
+    hop_sums(static_cast<size_t>(window_frames / new_hop_frames) * new_max_lag),
+    difference(new_max_lag),
+    normalised(new_max_lag) {
+  /// Preallocate all analysis state
+  assert(window_frames % hop_frames == 0 && "pitch detector window must be a whole number of hops");
+  assert(max_lag >= 4 && "pitch detector needs a useful range of lags");
+}
+
+void pitch_detector::set_sample_rate(unsigned int const new_sample_rate) {
+  sample_rate = static_cast<float>(new_sample_rate);
+}
+void pitch_detector::set_threshold(float const new_threshold) {
+  threshold.store(new_threshold, std::memory_order_relaxed);
+}
+
+pitch_detector::result pitch_detector::get_result() const {
+  return {
+    .frequency{ frequency.load( std::memory_order_relaxed)},
+    .confidence{confidence.load(std::memory_order_relaxed)},
+  };
+}
+
+void pitch_detector::process(std::span<AudioSampleFrame const> const inputs) {
+  /// Append the first input, mixed to mono, and analyse each completed hop - audio thread
+  if(inputs.empty() || inputs.front().numberOfChannels == 0 || sample_rate <= 0.0f) return;
+  auto const &input{inputs.front()};
+  auto const frames{static_cast<unsigned int>(input.samplesPerChannel)};
+  for(unsigned int offset{0}; offset != frames;) {
+    unsigned int const count{std::min(frames - offset, hop_frames - hop_fill)};
+    auto const destination{std::span{history}.subspan(max_lag + hop_fill, count)};
+    AudioSampleFrame const window{                                              // view of just this part of the quantum, for the downmix kernel
+      .numberOfChannels{input.numberOfChannels},
+      .samplesPerChannel{input.samplesPerChannel},
+      .data{input.data + offset},
+    };
+    mix::downmix_stereo(window, destination);
+    hop_fill += count;
+    offset += count;
+    if(hop_fill == hop_frames) {
+      process_hop();
+      std::copy(history.begin() + hop_frames, history.end(), history.begin());  // slide the newest max_lag samples to the front
+      hop_fill = 0;
+    }
+  }
+}
+
+void pitch_detector::process_hop() {
+  /// Correlate the new hop against the history at every lag, then total the ring of hop sums over the window
+  float const *newest{&history[max_lag]};
+  std::span<float> const sums{&hop_sums[static_cast<size_t>(hop_index) * max_lag], max_lag};
+  sums[0] = 0.0f;
+  for(unsigned int lag{1}; lag != max_lag; ++lag) {                             // (x[j] - x[j - lag])^2 summed over the hop, vectorised across j
+    float const *delayed{newest - lag};
+    simd::batch sum{simd::broadcast(0.0f)};
+    unsigned int j{0};
+    for(; j + simd::width <= hop_frames; j += simd::width) {
+      simd::batch const delta{simd::load(&newest[j]) - simd::load(&delayed[j])};
+      sum = simd::multiply_add(delta, delta, sum);
+    }
+    std::array<float, simd::width> lanes;
+    simd::store(lanes.data(), sum);
+    float total{0.0f};
+    for(float const lane : lanes) total += lane;
+    for(; j != hop_frames; ++j) {
+      float const delta{newest[j] - delayed[j]};
+      total += delta * delta;
+    }
+    sums[lag] = total;
+  }
+  hop_index = (hop_index + 1) % hop_count;
+  hops_filled = std::min(hops_filled + 1, hop_count);
+  if(hops_filled != hop_count) return;                                          // wait for a full window
+
+  mix::clear(difference);                                                       // summing the ring afresh each hop avoids the drift of a running add and subtract
+  for(unsigned int hop{0}; hop != hop_count; ++hop) {
+    mix::accumulate(std::span<float const>{&hop_sums[static_cast<size_t>(hop) * max_lag], max_lag}, difference, 1.0f);
+  }
+  estimate();
+}
+
+void pitch_detector::estimate() {
+  /// YIN: normalise the difference function, pick the first dip below threshold, and refine it with parabolic interpolation
+  float const accept_below{threshold.load(std::memory_order_relaxed)};
+  float running_sum{0.0f};
+  normalised[0] = 1.0f;
+  for(unsigned int lag{1}; lag != max_lag; ++lag) {
+    running_sum += difference[lag];
+    normalised[lag] = running_sum > 0.0f ? difference[lag] * static_cast<float>(lag) / running_sum : 1.0f;
+  }
+  if(running_sum < 1.0e-6f) {                                                   // silence
+    confidence.store(0.0f, std::memory_order_relaxed);
+    return;
+  }
+
+  unsigned int best{0};
+  for(unsigned int lag{2}; lag != max_lag; ++lag) {
+    if(normalised[lag] >= accept_below) continue;
+    while(lag + 1 != max_lag && normalised[lag + 1] < normalised[lag]) ++lag;   // descend to the bottom of this dip
+    best = lag;
+    break;
+  }
+  if(best == 0) {                                                               // nothing below threshold: fall back to the global minimum, with correspondingly low confidence
+    best = static_cast<unsigned int>(std::distance(normalised.begin(), std::min_element(normalised.begin() + 2, normalised.end())));
+  }
+
+  float period{static_cast<float>(best)};
+  if(best + 1 < max_lag) {
+    float const before{normalised[best - 1]};
+    float const at{normalised[best]};
+    float const after{normalised[best + 1]};
+    float const curvature{before - 2.0f * at + after};
+    if(curvature > 1.0e-9f) period += 0.5f * (before - after) / curvature;
+  }
+  frequency.store(sample_rate / period, std::memory_order_relaxed);
+  confidence.store(std::clamp(1.0f - normalised[best], 0.0f, 1.0f), std::memory_order_relaxed);
+}
+
+}
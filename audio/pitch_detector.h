@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <span>
+#include <vector>
+#include <emscripten/webaudio.h>
+
+namespace audio {
+
+class pitch_detector {
+  /// Monophonic pitch tracker on the audio input, using the YIN method
+  /// The difference function is built incrementally: each hop contributes its own partial sums for every lag, kept in a ring,
+  /// so each quantum only correlates its newest samples against the history, and the window total is a vectorised sum of the ring
+public:
+  struct result {
+    float frequency{0.0f};                                                      // in Hz, meaningful only with non-zero confidence
+    float confidence{0.0f};                                                     // 0 to 1, one minus the normalised difference at the chosen lag
+  };
+
+private:
+  unsigned int const hop_frames;
+  unsigned int const hop_count;                                                 // hops per analysis window
+  unsigned int const max_lag;                                                   // longest period detected, setting the lowest frequency
+
+  std::vector<float> history;                                                   // mono input, the last max_lag samples followed by the hop being filled
+  unsigned int hop_fill{0};
+  std::vector<float> hop_sums;                                                  // ring of per-hop partial difference functions, hop_count rows of max_lag
+  unsigned int hop_index{0};
+  unsigned int hops_filled{0};
+  std::vector<float> difference;                                                // difference function over the whole window
+  std::vector<float> normalised;                                                // cumulative mean normalised difference
+
+  float sample_rate{0.0f};
+  std::atomic<float> threshold{0.15f};                                          // normalised difference below which a lag is accepted as the period
+  std::atomic<float> frequency{0.0f};                                           // published by the audio thread
+  std::atomic<float> confidence{0.0f};
+
+public:
+  explicit pitch_detector(unsigned int window_frames = 2'048, unsigned int max_lag = 1'024, unsigned int hop_frames = 128);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void set_threshold(float new_threshold);
+
+  void process(std::span<AudioSampleFrame const> inputs);
+
+  result get_result() const;
+
+private:
+  void process_hop();
+  void estimate();
+};
+
+}
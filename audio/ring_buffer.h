@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <span>
+#include <vector>
+
+namespace audio {
+
+template<typename T>
+class ring_buffer {
+  /// Single-producer single-consumer lock-free ring buffer with preallocated power-of-two storage
+  /// Positions increase monotonically and are masked on access, so full and empty states are unambiguous
+  std::vector<T> storage;
+  size_t const mask;
+  alignas(64) std::atomic<size_t> write_position{0};                            // only modified by the producer
+  alignas(64) std::atomic<size_t> read_position{0};                             // only modified by the consumer
+
+public:
+  explicit ring_buffer(size_t capacity);
+
+  size_t get_capacity() const;
+  size_t get_size() const;
+
+  template<typename F>
+  bool write_generate(size_t count, F &&generator);
+  bool write(std::span<T const> data);
+  size_t read(std::span<T> data);
+
+  void clear();
+};
+
+template<typename T>
+ring_buffer<T>::ring_buffer(size_t const capacity)
+  : storage(std::bit_ceil(capacity)),
+    mask{std::bit_ceil(capacity) - 1} {
+  /// Allocate all storage up front, rounded up to a power of two so wrapping is a mask
+  assert(capacity != 0 && "ring_buffer capacity must be non-zero");
+}
+
+template<typename T>
+size_t ring_buffer<T>::get_capacity() const {
+  return storage.size();
+}
+
+template<typename T>
+size_t ring_buffer<T>::get_size() const {
+  /// Number of elements available to read - exact from the consumer's perspective, a lower bound from anywhere else
+  return write_position.load(std::memory_order_acquire) - read_position.load(std::memory_order_acquire);
+}
+
+template<typename T>
+template<typename F>
+bool ring_buffer<T>::write_generate(size_t const count, F &&generator) {
+  /// Producer only: reserve count elements and let the generator fill them in place, without blocking or allocating
+  /// The generator is called once or twice (if the write wraps) as generator(std::span<T> region, size_t offset), where offset is the index of the region's first element within the write
+  /// Returns false and writes nothing if there is not enough free space
+  size_t const write_pos{write_position.load(std::memory_order_relaxed)};
+  size_t const read_pos{read_position.load(std::memory_order_acquire)};
+  if(storage.size() - (write_pos - read_pos) < count) return false;
+
+  size_t const start{write_pos & mask};
+  size_t const first_count{std::min(count, storage.size() - start)};
+  generator(std::span<T>{storage.data() + start, first_count}, size_t{0});
+  if(first_count != count) {
+    generator(std::span<T>{storage.data(), count - first_count}, first_count);
+  }
+  write_position.store(write_pos + count, std::memory_order_release);
+  return true;
+}
+
+template<typename T>
+bool ring_buffer<T>::write(std::span<T const> const data) {
+  /// Producer only: write all of the data, or nothing if there is not enough free space
+  return write_generate(data.size(), [&](std::span<T> region, size_t offset){
+    std::copy_n(data.begin() + static_cast<std::ptrdiff_t>(offset), region.size(), region.begin());
+  });
+}
+
+template<typename T>
+size_t ring_buffer<T>::read(std::span<T> const data) {
+  /// Consumer only: read up to data.size() elements, returning the number actually read
+  size_t const read_pos{read_position.load(std::memory_order_relaxed)};
+  size_t const write_pos{write_position.load(std::memory_order_acquire)};
+  size_t const count{std::min(data.size(), write_pos - read_pos)};
+
+  size_t const start{read_pos & mask};
+  size_t const first_count{std::min(count, storage.size() - start)};
+  std::copy_n(storage.begin() + static_cast<std::ptrdiff_t>(start), first_count, data.begin());
+  std::copy_n(storage.begin(), count - first_count, data.begin() + static_cast<std::ptrdiff_t>(first_count));
+  read_position.store(read_pos + count, std::memory_order_release);
+  return count;
+}
+
+template<typename T>
+void ring_buffer<T>::clear() {
+  /// Discard all content - only safe while neither the producer nor the consumer is active
+  read_position.store(write_position.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+}
@@ -0,0 +1,322 @@
+#include "sample_cache.h"
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <utility>
+
+namespace audio {
+
+namespace {
+unsigned int constexpr worker_stack_size{64 * 1024};
+int64_t constexpr poll_interval_ns{10'000'000};                                 // 10ms between checks for new work
+
+uint32_t read_u32(std::span<uint8_t const> const data, size_t const offset) {
+  return static_cast<uint32_t>(data[offset]) | static_cast<uint32_t>(data[offset + 1]) << 8 | static_cast<uint32_t>(data[offset + 2]) << 16 | static_cast<uint32_t>(data[offset + 3]) << 24;
+}
+uint16_t read_u16(std::span<uint8_t const> const data, size_t const offset) {
+  return static_cast<uint16_t>(data[offset] | data[offset + 1] << 8);
+}
+
+std::vector<float> decode_wav(std::span<uint8_t const> const file, unsigned int &sample_rate) {
+  /// Minimal RIFF WAVE reader for 16 and 24-bit PCM and 32-bit float, mixing all channels down to mono
+  /// Returns an empty vector if the file can't be decoded
+  if(file.size() < 12 || std::memcmp(file.data(), "RIFF", 4) != 0 || std::memcmp(file.data() + 8, "WAVE", 4) != 0) return {};
+
+  uint16_t format_tag{0};
+  unsigned int channels{0};
+  unsigned int bits{0};
+  std::span<uint8_t const> data;
+  for(size_t offset{12}; offset + 8 <= file.size();) {                          // walk the chunks, skipping any we don't need
+    size_t const chunk_size{read_u32(file, offset + 4)};
+    size_t const body{offset + 8};
+    if(body + chunk_size > file.size()) break;
+    if(std::memcmp(file.data() + offset, "fmt ", 4) == 0 && chunk_size >= 16) {
+      format_tag  = read_u16(file, body);
+      channels    = read_u16(file, body + 2);
+      sample_rate = read_u32(file, body + 4);
+      bits        = read_u16(file, body + 14);
+      if(format_tag == 0xFFFE && chunk_size >= 26) format_tag = read_u16(file, body + 24); // WAVE_FORMAT_EXTENSIBLE: the real format leads the subformat GUID
+    } else if(std::memcmp(file.data() + offset, "data", 4) == 0) {
+      data = file.subspan(body, chunk_size);
+    }
+    offset = body + chunk_size + (chunk_size & 1);                              // chunks are padded to an even size
+  }
+
+  bool const pcm{format_tag == 1 && (bits == 16 || bits == 24)};
+  bool const floating{format_tag == 3 && bits == 32};
+  if(channels == 0 || sample_rate == 0 || (!pcm && !floating)) return {};
+  size_t const bytes_per_sample{bits / 8};
+  size_t const frames{data.size() / (bytes_per_sample * channels)};
+
+  std::vector<float> mono(frames);
+  float const channel_scale{1.0f / static_cast<float>(channels)};
+  for(size_t frame{0}; frame != frames; ++frame) {
+    float sum{0.0f};
+    for(unsigned int channel{0}; channel != channels; ++channel) {
+      size_t const offset{(frame * channels + channel) * bytes_per_sample};
+      if(floating) {
+        uint32_t const bits_value{read_u32(data, offset)};
+        float value;
+        std::memcpy(&value, &bits_value, sizeof(value));
+        sum += value;
+      } else if(bits == 16) {
+        sum += static_cast<float>(static_cast<int16_t>(read_u16(data, offset))) * (1.0f / 32'768.0f);
+      } else {
+        auto const value{static_cast<int32_t>(static_cast<uint32_t>(data[offset]) << 8 | static_cast<uint32_t>(data[offset + 1]) << 16 | static_cast<uint32_t>(data[offset + 2]) << 24)}; // place in the top 24 bits so the sign is kept
+        sum += static_cast<float>(value) * (1.0f / 2'147'483'648.0f);
+      }
+    }
+    mono[frame] = sum * channel_scale;
+  }
+  return mono;
+}
+}
+
+sample_cache::handle::handle(sample_cache &owner, entry &new_target)
+  : cache{&owner},
+    target{&new_target} {
+  target->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+sample_cache::handle::handle(handle const &other)
+  : cache{other.cache},
+    target{other.target} {
+  if(target) target->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+sample_cache::handle::handle(handle &&other) noexcept
+  : cache{std::exchange(other.cache, nullptr)},
+    target{std::exchange(other.target, nullptr)} {
+}
+
+sample_cache::handle &sample_cache::handle::operator=(handle other) noexcept {
+  std::swap(cache, other.cache);
+  std::swap(target, other.target);
+  return *this;
+}
+
+sample_cache::handle::~handle() {
+  /// Unpin the entry - the release epoch is recorded before the count drops, so eviction always sees it
+  if(!target) return;
+  uint64_t const now{cache->audio_epoch.load(std::memory_order_acquire)};
+  uint64_t previous{target->released_epoch.load(std::memory_order_relaxed)};
+  while(previous < now && !target->released_epoch.compare_exchange_weak(previous, now, std::memory_order_relaxed)); // keep the latest epoch if handles are dropped concurrently
+  target->references.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+bool sample_cache::handle::operator==(handle const &other) const {
+  /// Whether both handles refer to the same entry, or are both empty
+  return target == other.target;
+}
+
+sample_cache::states sample_cache::handle::get_state() const {
+  if(!target) return states::failed;
+  return target->state.load(std::memory_order_acquire);
+}
+
+sample_data const *sample_cache::handle::get() const {
+  /// The decoded sample, or nullptr if it isn't loaded yet or failed to load
+  if(get_state() != states::ready) return nullptr;
+  return target->data.get();
+}
+
+sample_cache::atomic_handle::~atomic_handle() {
+  /// Drop the held handle - writer thread
+  store({});
+}
+
+void sample_cache::atomic_handle::store(handle new_handle) {
+  /// Replace the held handle, taking over the new handle's reference - writer thread, usually main
+  handle previous;                                                              // adopts the replaced reference, and drops it on return
+  previous.cache = std::exchange(cache, std::exchange(new_handle.cache, nullptr));
+  previous.target = target.exchange(std::exchange(new_handle.target, nullptr), std::memory_order_seq_cst); // ordered against the audio thread's epoch, see is_evictable()
+}
+
+sample_cache::handle sample_cache::atomic_handle::load() const {
+  /// A new reference to the held entry - writer thread only, as a concurrent store could drop the entry mid-copy
+  entry *const current{target.load(std::memory_order_relaxed)};
+  if(!current) return {};
+  return {*cache, *current};
+}
+
+sample_data const *sample_cache::atomic_handle::get() const {
+  /// The held sample, or nullptr if none is held, or it isn't loaded yet or failed to load - any thread
+  /// A reader must finish with the pointer within the audio quantum it read it in, as a replaced entry may be evicted after that
+  entry const *const current{target.load(std::memory_order_seq_cst)};
+  if(!current || current->state.load(std::memory_order_acquire) != states::ready) return nullptr;
+  return current->data.get();
+}
+
+sample_cache::sample_cache(size_t const budget_bytes, size_t const queue_capacity)
+  : budget{budget_bytes},
+    load_queue{queue_capacity},
+    eviction_queue{queue_capacity} {
+}
+
+sample_cache::~sample_cache() {
+  /// Stop the worker before the queues and entries it reads are destroyed, waiting for any decode in progress to finish
+  if(worker) {
+    stopping.store(true, std::memory_order_release);
+    while(worker_running.load(std::memory_order_acquire));                      // spin: the main browser thread can't block, and the worker checks at least every poll interval
+    emscripten_terminate_wasm_worker(worker);                                   // idle and outside the heap by now, so safe to end
+  }
+  std::array<sample_data*, 16> evicted;
+  for(size_t count{eviction_queue.read(evicted)}; count != 0; count = eviction_queue.read(evicted)) { // free anything the worker hadn't got to
+    for(size_t i{0}; i != count; ++i) {
+      delete evicted[i];
+    }
+  }
+}
+
+sample_cache::handle sample_cache::request(std::string const &path, sample_data::formats const format, float const root_frequency) {
+  /// Get a handle to a sample file, starting to load it if it isn't cached - main thread
+  /// A cached sample is returned in whatever format it was first requested in
+  if(auto *const cached{find(path)}) return {*this, *cached};
+
+  std::ifstream file{path, std::ios::binary};                                   // the preloaded filesystem is in memory, so this is a copy rather than I/O
+  if(!file) {
+    std::cerr << "ERROR: Sample cache: Unable to open " << path << std::endl;
+    auto &failed_entry{add(path, format, root_frequency)};
+    failed_entry.state.store(states::failed, std::memory_order_release);
+    return {*this, failed_entry};
+  }
+  return request(path, {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}}, format, root_frequency);
+}
+
+sample_cache::handle sample_cache::request(std::string const &name, std::vector<uint8_t> file_contents, sample_data::formats const format, float const root_frequency) {
+  /// Get a handle to a sample whose WAV file is already in memory, such as one generated at runtime, keyed by name - main thread
+  if(auto *const cached{find(name)}) return {*this, *cached};
+
+  auto &new_entry{add(name, format, root_frequency)};
+  new_entry.file = std::move(file_contents);
+  if(!worker) {
+    worker = emscripten_malloc_wasm_worker(worker_stack_size);
+    worker_running.store(true, std::memory_order_release);                      // before posting, so the destructor waits even if the worker hasn't started yet
+    emscripten_wasm_worker_post_function_vi(worker, [](int data){
+      /// Worker entry point, running until the cache is destroyed
+      reinterpret_cast<sample_cache*>(static_cast<intptr_t>(data))->worker_main();
+    }, static_cast<int>(reinterpret_cast<intptr_t>(this)));
+  }
+  enqueue(new_entry);
+  return {*this, new_entry};
+}
+
+void sample_cache::update() {
+  /// Queue loads that didn't fit before, account for finished loads and evict least recently used samples until within budget - main thread, once per frame
+  for(auto &candidate : entries) {
+    if(candidate.accounted) continue;
+    switch(candidate.state.load(std::memory_order_acquire)) {
+    case states::loading:
+      if(!candidate.queued) enqueue(candidate);
+      continue;
+    case states::ready:
+      candidate.bytes = candidate.data->get_memory_bytes();
+      used_bytes += candidate.bytes;
+      break;
+    case states::failed:
+      break;
+    }
+    candidate.accounted = true;
+  }
+
+  for(auto it{entries.end()}; used_bytes > budget && it != entries.begin();) {  // walk from least recently used
+    --it;
+    if(!is_evictable(*it)) continue;
+    used_bytes -= it->bytes;
+    std::array<sample_data*, 1> const released{it->data.release()};
+    if(!eviction_queue.write(released)) delete released.front();                // queue full: free here rather than leak
+    index.erase(it->path);
+    it = entries.erase(it);
+  }
+}
+
+void sample_cache::advance_epoch() {
+  /// Mark the start of an audio quantum, before any sample is read in it - audio thread, once per quantum
+  /// Any sample pointer read during an earlier quantum is no longer in use after this
+  audio_epoch.fetch_add(1, std::memory_order_seq_cst);
+}
+
+void sample_cache::set_budget(size_t const new_budget_bytes) {
+  budget = new_budget_bytes;
+}
+size_t sample_cache::get_budget() const {
+  return budget;
+}
+size_t sample_cache::get_used_bytes() const {
+  return used_bytes;
+}
+size_t sample_cache::get_entry_count() const {
+  return entries.size();
+}
+
+sample_cache::entry *sample_cache::find(std::string const &path) {
+  /// Look up a cached entry, marking it most recently used
+  auto const found{index.find(path)};
+  if(found == index.end()) return nullptr;
+  entries.splice(entries.begin(), entries, found->second);                      // list iterators stay valid
+  return &entries.front();
+}
+
+sample_cache::entry &sample_cache::add(std::string const &path, sample_data::formats const format, float const root_frequency) {
+  /// Create a new most recently used entry, in the loading state
+  auto &new_entry{entries.emplace_front()};
+  index.emplace(path, entries.begin());
+  new_entry.path = path;
+  new_entry.format = format;
+  new_entry.root_frequency = root_frequency;
+  return new_entry;
+}
+
+void sample_cache::enqueue(entry &target) {
+  /// Hand an entry to the worker for decoding - if the queue is full it stays loading, and update() tries again next frame
+  std::array<entry*, 1> const job{&target};
+  target.queued = load_queue.write(job);
+}
+
+bool sample_cache::is_evictable(entry const &candidate) const {
+  /// Unreferenced, not being written by the worker, and with a full audio quantum since the last handle was dropped
+  /// Before audio starts nothing can be reading a sample, so anything unreferenced can go - the epoch and the atomic handle's
+  /// target are both sequentially consistent, so if this sees epoch 0, the audio thread's first read sees any replacement
+  if(!candidate.accounted) return false;
+  if(candidate.references.load(std::memory_order_acquire) != 0) return false;
+  uint64_t const epoch{audio_epoch.load(std::memory_order_seq_cst)};
+  return epoch == 0 || epoch >= candidate.released_epoch.load(std::memory_order_relaxed) + 2;
+}
+
+void sample_cache::worker_main() {
+  /// Decode queued loads and free evicted samples, off both the main and audio threads, until the cache is destroyed
+  while(!stopping.load(std::memory_order_acquire)) {
+    std::array<entry*, 1> job;
+    while(load_queue.read(job) != 0) {
+      load(*job.front());
+    }
+    std::array<sample_data*, 16> evicted;
+    for(size_t count{eviction_queue.read(evicted)}; count != 0; count = eviction_queue.read(evicted)) {
+      for(size_t i{0}; i != count; ++i) {
+        delete evicted[i];
+      }
+    }
+    emscripten_wasm_worker_sleep(poll_interval_ns);
+  }
+  worker_running.store(false, std::memory_order_release);
+}
+
+void sample_cache::load(entry &target) {
+  /// Decode a file into the requested compact format
+  unsigned int sample_rate{0};
+  auto const decoded{decode_wav(target.file, sample_rate)};
+  target.file.clear();
+  target.file.shrink_to_fit();
+  if(decoded.empty()) {
+    target.state.store(states::failed, std::memory_order_release);
+    return;
+  }
+  target.data = std::make_unique<sample_data>(decoded, target.format, sample_rate, target.root_frequency);
+  target.state.store(states::ready, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <emscripten/wasm_worker.h>
+#include "ring_buffer.h"
+#include "sample_data.h"
+
+namespace audio {
+
+class sample_cache {
+  /// Loads samples from the preloaded filesystem or from memory on first use, holding their decoded form within a memory budget
+  /// Files are read on the main thread, then decoded and later freed on a Wasm Worker; least recently used entries are evicted
+  /// once nothing references them, and handles pin entries so they are safe to hold and drop on the audio thread
+public:
+  enum class states {
+    loading,                                                                    // queued for, or being decoded on, the worker
+    ready,
+    failed,                                                                     // missing file or unsupported format
+  };
+
+private:
+  struct entry {
+    std::string path;
+    sample_data::formats format{sample_data::formats::ima_adpcm};
+    float root_frequency{440.0f};
+    std::vector<uint8_t> file;                                                  // raw file contents, handed to the worker for decoding
+    std::unique_ptr<sample_data> data;                                          // written by the worker while loading, immutable once ready
+    std::atomic<states> state{states::loading};
+    std::atomic<unsigned int> references{0};                                    // live handles, from any thread
+    std::atomic<uint64_t> released_epoch{0};                                    // audio epoch when the last handle was dropped
+    size_t bytes{0};                                                            // accounted against the budget once ready - main thread
+    bool accounted{false};
+    bool queued{false};                                                         // handed to the worker - main thread, false while waiting for room in the load queue
+  };
+
+public:
+  class handle {
+    /// Reference to a cache entry, which pins it against eviction
+    /// Copying and destroying only touch atomics and never free memory, so handles may be held and dropped on the audio thread
+    sample_cache *cache{nullptr};
+    entry *target{nullptr};
+
+    friend class sample_cache;
+    friend class atomic_handle;
+    handle(sample_cache &owner, entry &new_target);
+
+  public:
+    handle() = default;
+    handle(handle const &other);
+    handle(handle &&other) noexcept;
+    handle &operator=(handle other) noexcept;
+    ~handle();
+
+    bool operator==(handle const &other) const;
+
+    states get_state() const;
+    sample_data const *get() const;
+  };
+
+  class atomic_handle {
+    /// Slot holding a handle that one thread replaces while another reads the sample through it, such as a voice's sample set from the main thread and played on the audio thread
+    /// The replaced handle is dropped by the writer, and the epoch rule keeps its sample alive until readers can no longer be using it
+    sample_cache *cache{nullptr};                                               // writer only
+    std::atomic<entry*> target{nullptr};
+
+  public:
+    atomic_handle() = default;
+    atomic_handle(atomic_handle const&) = delete;
+    atomic_handle &operator=(atomic_handle const&) = delete;
+    ~atomic_handle();
+
+    void store(handle new_handle);
+    handle load() const;
+    sample_data const *get() const;
+  };
+
+private:
+  size_t budget;                                                                // in bytes of decoded sample data
+  size_t used_bytes{0};
+
+  std::list<entry> entries;                                                     // most recently used first, nodes never move - main thread
+  std::unordered_map<std::string, std::list<entry>::iterator> index;
+
+  ring_buffer<entry*> load_queue;                                               // main thread to worker
+  ring_buffer<sample_data*> eviction_queue;                                     // main thread to worker, which frees them
+  std::atomic<uint64_t> audio_epoch{0};                                         // quanta started by the audio thread, 0 until audio starts
+  emscripten_wasm_worker_t worker{0};                                           // created on first use
+  std::atomic<bool> stopping{false};                                            // set by the destructor to end the worker's loop
+  std::atomic<bool> worker_running{false};                                      // cleared by the worker as it finishes, once it no longer touches the cache
+
+public:
+  explicit sample_cache(size_t budget_bytes, size_t queue_capacity = 256);
+  sample_cache(sample_cache const&) = delete;
+  sample_cache &operator=(sample_cache const&) = delete;
+  ~sample_cache();
+
+  handle request(std::string const &path, sample_data::formats format = sample_data::formats::ima_adpcm, float root_frequency = 440.0f);
+  handle request(std::string const &name, std::vector<uint8_t> file_contents, sample_data::formats format = sample_data::formats::ima_adpcm, float root_frequency = 440.0f);
+  void update();
+  void advance_epoch();
+
+  void set_budget(size_t new_budget_bytes);
+  size_t get_budget() const;
+  size_t get_used_bytes() const;
+  size_t get_entry_count() const;
+
+private:
+  entry *find(std::string const &path);
+  entry &add(std::string const &path, sample_data::formats format, float root_frequency);
+  void enqueue(entry &target);
+
+  bool is_evictable(entry const &candidate) const;
+  void worker_main();
+  static void load(entry &target);
+};
+
+}
@@ -0,0 +1,211 @@
+#include "sample_data.h"
+#include <algorithm>
+#include <cassert>
+#if defined(__wasm_simd128__)
+  #include <wasm_simd128.h>
+#elif defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+#include "encoder.h"
+#include "mix.h"
+
+namespace audio {
+
+namespace {
+
+float constexpr pcm16_scale{1.0f / 32'767.0f};                                  // inverse of the scale used by encoder::tpdf_dither
+
+std::array<int16_t, 89> constexpr adpcm_steps{
+  7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+  19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+  50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+  130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+  337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+  876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+  2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+  5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+  15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+std::array<int8_t, 16> constexpr adpcm_index_adjust{
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+struct adpcm_state {
+  int predictor{0};
+  int step_index{0};
+
+  int decode(unsigned int const code) {
+    /// Apply one 4-bit code, returning the reconstructed 16-bit sample
+    int const step{adpcm_steps[static_cast<size_t>(step_index)]};
+    int difference{step >> 3};
+    if(code & 4u) difference += step;
+    if(code & 2u) difference += step >> 1;
+    if(code & 1u) difference += step >> 2;
+    if(code & 8u) difference = -difference;
+    predictor = std::clamp(predictor + difference, -32'768, 32'767);
+    step_index = std::clamp(step_index + adpcm_index_adjust[code], 0, static_cast<int>(adpcm_steps.size()) - 1);
+    return predictor;
+  }
+
+  unsigned int encode(int const sample) {
+    /// Choose the code that best approximates the sample, and advance exactly as the decoder will
+    int const step{adpcm_steps[static_cast<size_t>(step_index)]};
+    int difference{sample - predictor};
+    unsigned int code{0};
+    if(difference < 0) {
+      code = 8;
+      difference = -difference;
+    }
+    if(difference >= step) {
+      code |= 4;
+      difference -= step;
+    }
+    if(difference >= step >> 1) {
+      code |= 2;
+      difference -= step >> 1;
+    }
+    if(difference >= step >> 2) {
+      code |= 1;
+    }
+    decode(code);
+    return code;
+  }
+};
+
+}
+
+sample_data::sample_data(std::span<float const> const source, formats const new_format, unsigned int const new_sample_rate, float const new_root_frequency)
+  : format{new_format},
+    sample_rate{new_sample_rate},
+    root_frequency{new_root_frequency},
+    frames{source.size()} {
+  /// Encode float samples into the requested storage format - this allocates, so never construct on the audio thread
+  switch(format) {
+  case formats::float32:
+    float_data.assign(source.begin(), source.end());
+    break;
+  case formats::pcm16:
+    pcm16_data.resize(frames);
+    encoder::tpdf_dither{}.convert(source, pcm16_data);
+    break;
+  case formats::ima_adpcm:
+    {
+      std::vector<int16_t> quantised(frames);
+      encoder::tpdf_dither{}.convert(source, quantised);
+      encode_adpcm(quantised);
+    }
+    break;
+  }
+}
+
+sample_data::formats sample_data::get_format() const {
+  return format;
+}
+unsigned int sample_data::get_sample_rate() const {
+  return sample_rate;
+}
+float sample_data::get_root_frequency() const {
+  return root_frequency;
+}
+size_t sample_data::get_frames() const {
+  return frames;
+}
+
+size_t sample_data::get_memory_bytes() const {
+  /// Heap storage used by the encoded samples
+  return float_data.size() * sizeof(float) + pcm16_data.size() * sizeof(int16_t) + adpcm_data.size() * sizeof(adpcm_block);
+}
+
+void sample_data::encode_adpcm(std::span<int16_t const> const source) {
+  /// Encode into independent blocks, each starting from the running encoder state so there is no seam at block boundaries
+  adpcm_data.resize((source.size() + adpcm_block_frames - 1) / adpcm_block_frames);
+  adpcm_state state;
+  for(size_t frame{0}; frame != source.size(); ++frame) {
+    auto &block{adpcm_data[frame / adpcm_block_frames]};
+    size_t const offset{frame % adpcm_block_frames};
+    if(offset == 0) {
+      block.predictor = static_cast<int16_t>(state.predictor);
+      block.step_index = static_cast<uint8_t>(state.step_index);
+    }
+    unsigned int const code{state.encode(source[frame])};
+    block.nibbles[offset / 2] |= static_cast<uint8_t>(code << ((offset % 2) * 4));
+  }
+}
+
+void sample_data::decode(size_t const start, std::span<float> const output) const {
+  /// Decode a range of frames to float - audio thread safe, never allocates
+  assert(start + output.size() <= frames && "decode range out of bounds");
+  switch(format) {
+  case formats::float32:
+    mix::copy(std::span{float_data}.subspan(start, output.size()), output);
+    break;
+  case formats::pcm16:
+    decode_pcm16(start, output);
+    break;
+  case formats::ima_adpcm:
+    decode_adpcm(start, output);
+    break;
+  }
+}
+
+void sample_data::decode_looped(size_t start, std::span<float> output) const {
+  /// Decode a range of frames, wrapping back to the start of the sample at the end
+  assert(frames != 0 && "cannot loop an empty sample");
+  start %= frames;
+  while(!output.empty()) {
+    size_t const count{std::min(output.size(), frames - start)};
+    decode(start, output.first(count));
+    output = output.subspan(count);
+    start = 0;
+  }
+}
+
+void sample_data::decode_pcm16(size_t const start, std::span<float> const output) const {
+  /// Widen 16-bit samples to float, eight at a time
+  int16_t const *source{&pcm16_data[start]};
+  size_t const count{output.size()};
+  size_t i{0};
+  #if defined(__wasm_simd128__)
+    v128_t const scale{wasm_f32x4_splat(pcm16_scale)};
+    for(; i + 8 <= count; i += 8) {
+      v128_t const packed{wasm_v128_load(&source[i])};
+      wasm_v128_store(&output[i],     wasm_f32x4_mul(wasm_f32x4_convert_i32x4(wasm_i32x4_extend_low_i16x8( packed)), scale));
+      wasm_v128_store(&output[i + 4], wasm_f32x4_mul(wasm_f32x4_convert_i32x4(wasm_i32x4_extend_high_i16x8(packed)), scale));
+    }
+  #elif defined(__SSE2__)
+    __m128 const scale{_mm_set1_ps(pcm16_scale)};
+    for(; i + 8 <= count; i += 8) {
+      __m128i const packed{_mm_loadu_si128(reinterpret_cast<__m128i const*>(&source[i]))};
+      __m128i const low{_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16)}; // sign extend by duplicating into the high half and shifting down
+      __m128i const high{_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16)};
+      _mm_storeu_ps(&output[i],     _mm_mul_ps(_mm_cvtepi32_ps(low),  scale));
+      _mm_storeu_ps(&output[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+  #endif
+  for(; i != count; ++i) {
+    output[i] = static_cast<float>(source[i]) * pcm16_scale;
+  }
+}
+
+void sample_data::decode_adpcm(size_t const start, std::span<float> const output) const {
+  /// Decode from the start of the containing block - each code depends on the previous one, so this is inherently serial
+  size_t block_index{start / adpcm_block_frames};
+  size_t offset{start % adpcm_block_frames};
+  size_t written{0};
+  while(written != output.size()) {
+    auto const &block{adpcm_data[block_index]};
+    adpcm_state state{.predictor{block.predictor}, .step_index{block.step_index}};
+    for(size_t skip{0}; skip != offset; ++skip) {                               // run up to the first requested frame
+      state.decode((block.nibbles[skip / 2] >> ((skip % 2) * 4)) & 0xFu);
+    }
+    size_t const count{std::min(output.size() - written, adpcm_block_frames - offset)};
+    for(size_t i{offset}; i != offset + count; ++i) {
+      output[written++] = static_cast<float>(state.decode((block.nibbles[i / 2] >> ((i % 2) * 4)) & 0xFu)) * pcm16_scale;
+    }
+    ++block_index;
+    offset = 0;
+  }
+}
+
+}
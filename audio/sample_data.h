@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace audio {
+
+class sample_data {
+  /// Mono sampled sound held in a compact format, and decoded to float on demand by the voices that play it
+  /// ADPCM is stored in independent blocks, so decoding can start at any frame without running from the beginning
+public:
+  enum class formats : uint8_t {
+    float32,                                                                    // 4 bytes per frame, exact
+    pcm16,                                                                      // 2 bytes per frame, dithered
+    ima_adpcm,                                                                  // just over 0.5 bytes per frame, lossy 4:1 against 16-bit
+  };
+  static unsigned int constexpr adpcm_block_frames{256};
+
+private:
+  struct adpcm_block {
+    int16_t predictor{0};                                                       // decoder state at the start of the block
+    uint8_t step_index{0};
+    uint8_t padding{0};
+    std::array<uint8_t, adpcm_block_frames / 2> nibbles{};                      // two 4-bit codes per byte, low nibble first
+  };
+
+  formats format{formats::float32};
+  unsigned int sample_rate{48'000};
+  float root_frequency{440.0f};                                                 // pitch of the recording, so voices can transpose it to any frequency
+  size_t frames{0};
+
+  std::vector<float> float_data;                                                // only the vector matching the format is populated
+  std::vector<int16_t> pcm16_data;
+  std::vector<adpcm_block> adpcm_data;
+
+public:
+  sample_data() = default;
+  sample_data(std::span<float const> source, formats new_format, unsigned int new_sample_rate, float new_root_frequency = 440.0f);
+
+  formats get_format() const;
+  unsigned int get_sample_rate() const;
+  float get_root_frequency() const;
+  size_t get_frames() const;
+  size_t get_memory_bytes() const;
+
+  void decode(size_t start, std::span<float> output) const;
+  void decode_looped(size_t start, std::span<float> output) const;
+
+private:
+  void encode_adpcm(std::span<int16_t const> source);
+  void decode_pcm16(size_t start, std::span<float> output) const;
+  void decode_adpcm(size_t start, std::span<float> output) const;
+};
+
+}
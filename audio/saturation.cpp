@@ -0,0 +1,73 @@
+#include "saturation.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include "mix.h"
+
+namespace audio::effects {
+
+saturation::saturation(unsigned int const channels, unsigned int const max_frames_per_quantum) {
+  oversamplers.reserve(channels);
+  for(unsigned int channel{0}; channel != channels; ++channel) {
+    oversamplers.emplace_back(max_frames_per_quantum);
+  }
+}
+
+void saturation::set_enabled(bool const new_enabled) {
+  enabled.store(new_enabled, std::memory_order_relaxed);
+}
+bool saturation::is_enabled() const {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void saturation::set_parameters(parameters const &params) {
+  /// Change parameters, which take effect from the next quantum - main thread
+  drive.store(       params.drive,                                                                  std::memory_order_relaxed);
+  output_gain.store( params.output,                                                                 std::memory_order_relaxed);
+  shape.store(       params.shape,                                                                  std::memory_order_relaxed);
+  oversampling.store(std::bit_floor(std::clamp(params.oversampling, 1u, oversampler::max_factor)), std::memory_order_relaxed);
+}
+saturation::parameters saturation::get_parameters() const {
+  return {
+    .drive{       drive.load(       std::memory_order_relaxed)},
+    .output{      output_gain.load( std::memory_order_relaxed)},
+    .shape{       shape.load(       std::memory_order_relaxed)},
+    .oversampling{oversampling.load(std::memory_order_relaxed)},
+  };
+}
+
+void saturation::output(std::span<AudioSampleFrame> const outputs) {
+  /// Saturate the first output in place - audio thread
+  if(!is_enabled() || outputs.empty()) return;
+  auto const &output{outputs.front()};
+  auto const current{get_parameters()};
+  if(current.oversampling != active_oversampling) {                             // changing factor clears the filters, so it's done here rather than racing the audio thread
+    for(auto &channel_oversampler : oversamplers) channel_oversampler.set_factor(current.oversampling);
+    active_oversampling = current.oversampling;
+  }
+  float const input_gain{std::pow(10.0f, current.drive / 20.0f)};
+  float const makeup_gain{std::pow(10.0f, current.output / 20.0f)};
+
+  unsigned int const channels{std::min(static_cast<unsigned int>(output.numberOfChannels), static_cast<unsigned int>(oversamplers.size()))};
+  for(unsigned int channel{0}; channel != channels; ++channel) {
+    oversamplers[channel].process(mix::channel(output, channel), [&](std::span<float> const data){
+      switch(current.shape) {
+      case shapes::soft:
+        for(float &sample : data) {                                             // x(27 + x^2) / (27 + 9x^2) meets +-1 with zero slope at +-3, so clamping there is smooth
+          float const x{std::clamp(sample * input_gain, -3.0f, 3.0f)};
+          float const x2{x * x};
+          sample = x * (27.0f + x2) / (27.0f + 9.0f * x2) * makeup_gain;
+        }
+        break;
+      case shapes::hard:
+        for(float &sample : data) {
+          sample = std::clamp(sample * input_gain, -1.0f, 1.0f) * makeup_gain;
+        }
+        break;
+      }
+    });
+  }
+}
+
+}
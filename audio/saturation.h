@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <span>
+#include <vector>
+#include <emscripten/webaudio.h>
+#include "oversampler.h"
+
+namespace audio::effects {
+
+class saturation {
+  /// Waveshaping distortion on the first output in place, run oversampled so harmonics generated above the base Nyquist frequency are filtered out rather than aliasing
+public:
+  enum class shapes {
+    soft,                                                                       // rational tanh approximation, saturating smoothly
+    hard,                                                                       // clipping at full scale, rich in high harmonics so it benefits most from oversampling
+  };
+  struct parameters {
+    float drive{12.0f};                                                         // input gain in dB
+    float output{-6.0f};                                                        // output gain in dB
+    shapes shape{shapes::soft};
+    unsigned int oversampling{4};                                               // 1, 2, 4 or 8
+  };
+
+private:
+  std::atomic<bool> enabled{false};
+  std::atomic<float> drive{parameters{}.drive};
+  std::atomic<float> output_gain{parameters{}.output};
+  std::atomic<shapes> shape{parameters{}.shape};
+  std::atomic<unsigned int> oversampling{parameters{}.oversampling};
+
+  std::vector<oversampler> oversamplers;                                        // one per channel
+  unsigned int active_oversampling{0};                                          // factor the oversamplers are set to, owned by the audio thread
+
+public:
+  explicit saturation(unsigned int channels, unsigned int max_frames_per_quantum = 1024);
+
+  void set_enabled(bool new_enabled);
+  bool is_enabled() const;
+  void set_parameters(parameters const &params);
+  parameters get_parameters() const;
+
+  void output(std::span<AudioSampleFrame> outputs);
+};
+
+}
@@ -0,0 +1,274 @@
+#include "time_stretch.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <boost/math/constants/constants.hpp>
+#include "mix.h"
+#include "simd/simd.h"
+
+namespace audio {
+
+namespace {
+
+float dot(float const *a, float const *b, size_t const count) {
+  /// Inner product of two sample runs
+  simd::batch sum{simd::broadcast(0.0f)};
+  size_t i{0};
+  for(; i + simd::width <= count; i += simd::width) {
+    sum = simd::multiply_add(simd::load(&a[i]), simd::load(&b[i]), sum);
+  }
+  std::array<float, simd::width> lanes;
+  simd::store(lanes.data(), sum);
+  float total{0.0f};
+  for(float const lane : lanes) total += lane;
+  for(; i != count; ++i) {
+    total += a[i] * b[i];
+  }
+  return total;
+}
+
+void apply_window(std::span<float> const data, std::span<float const> const window) {
+  /// Multiply samples by a window of the same length, in place
+  size_t i{0};
+  for(; i + simd::width <= data.size(); i += simd::width) {
+    simd::store(&data[i], simd::load(&data[i]) * simd::load(&window[i]));
+  }
+  for(; i != data.size(); ++i) {
+    data[i] *= window[i];
+  }
+}
+
+void make_hann(std::vector<float> &window, unsigned int const frames) {
+  /// Periodic Hann window, which overlap-adds to a constant at any hop that divides its length by two or more
+  float constexpr two_pi{boost::math::constants::two_pi<float>()};
+  window.resize(frames);
+  for(unsigned int i{0}; i != frames; ++i) {
+    window[i] = 0.5f - 0.5f * std::cos(two_pi * static_cast<float>(i) / static_cast<float>(frames));
+  }
+}
+
+double wrap(double const position, size_t const frames) {
+  /// Wrap a source position into the loop, including positions before its start
+  double const wrapped{std::fmod(position, static_cast<double>(frames))};
+  return wrapped < 0.0 ? wrapped + static_cast<double>(frames) : wrapped;
+}
+
+}
+
+time_stretch::time_stretch(unsigned int const max_frames_per_quantum)
+  : mix_buffer(max_frames_per_quantum) {
+}
+
+void time_stretch::set_sample_rate(unsigned int const new_sample_rate) {
+  /// Size the grains for this sample rate and allocate everything processing needs - main thread, before processing starts
+  sample_rate = static_cast<float>(new_sample_rate);
+  wsola_grain_frames = 2 * std::max(32u, static_cast<unsigned int>(std::lround(sample_rate * 0.01f))); // 20ms: long enough to span a low voice's pitch period, short enough not to smear syllables
+  wsola_tolerance = wsola_grain_frames / 4;
+  vocoder_frames = std::bit_ceil(static_cast<unsigned int>(sample_rate * 0.04f)); // about 40ms, resolving harmonics down to around 50Hz
+  vocoder_fft.emplace(vocoder_frames);
+  make_hann(wsola_window, wsola_grain_frames);
+  make_hann(vocoder_window, vocoder_frames);
+
+  unsigned int const grain_capacity{std::max(2 * wsola_tolerance + wsola_grain_frames, vocoder_frames)};
+  decoded.assign(static_cast<size_t>(static_cast<float>(grain_capacity) * max_step) + 3, 0.0f);
+  grain.assign(grain_capacity, 0.0f);
+  target.assign(wsola_grain_frames / 2, 0.0f);
+  previous_grain.assign(vocoder_frames, 0.0f);
+  spectrum.assign(vocoder_fft->get_bin_count(), {});
+  previous_spectrum.assign(vocoder_fft->get_bin_count(), {});
+  phasors.assign(vocoder_fft->get_bin_count(), {});
+  overlap.assign(std::max(wsola_grain_frames, vocoder_frames), 0.0f);
+  active_source = nullptr;                                                      // force a reset before the next output
+}
+
+void time_stretch::set_enabled(bool const new_enabled) {
+  enabled.store(new_enabled, std::memory_order_relaxed);
+}
+bool time_stretch::is_enabled() const {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void time_stretch::set_source(sample_cache::handle new_source) {
+  /// Choose the sample to loop, silent until it has loaded - playback restarts from its beginning - main thread
+  source.store(std::move(new_source));
+}
+sample_cache::handle time_stretch::get_source() const {
+  /// The selected sample - main thread
+  return source.load();
+}
+
+void time_stretch::set_parameters(parameters const &params) {
+  /// Change parameters, which take effect from the next quantum - main thread
+  speed.store(std::clamp(params.speed, min_speed, max_speed),  std::memory_order_relaxed);
+  pitch.store(std::clamp(params.pitch, -max_pitch, max_pitch), std::memory_order_relaxed);
+  gain.store( params.gain,                                     std::memory_order_relaxed);
+  mode.store( params.mode,                                     std::memory_order_relaxed);
+}
+time_stretch::parameters time_stretch::get_parameters() const {
+  return {
+    .speed{speed.load(std::memory_order_relaxed)},
+    .pitch{pitch.load(std::memory_order_relaxed)},
+    .gain{ gain.load( std::memory_order_relaxed)},
+    .mode{ mode.load( std::memory_order_relaxed)},
+  };
+}
+
+void time_stretch::output(std::span<AudioSampleFrame> const outputs) {
+  /// Add one quantum of the stretched sample to every output channel - audio thread
+  if(!is_enabled() || outputs.empty() || sample_rate <= 0.0f) return;
+  auto const *sample{source.get()};
+  if(!sample || sample->get_frames() == 0) return;
+  auto const frames{static_cast<unsigned int>(outputs.front().samplesPerChannel)};
+  assert(frames <= mix_buffer.size() && "quantum larger than time stretch was constructed for");
+  auto const current{get_parameters()};
+  if(sample != active_source || current.mode != active_mode) reset(sample, current.mode);
+
+  unsigned int const hop{get_hop_frames(active_mode)};
+  float const rate_ratio{static_cast<float>(sample->get_sample_rate()) / sample_rate};
+  float const step{std::min(std::exp2(current.pitch / 12.0f) * rate_ratio, max_step)}; // source frames per output frame within a grain
+  double const advance{static_cast<double>(current.speed * rate_ratio * static_cast<float>(hop))}; // source frames per hop
+  for(unsigned int done{0}; done != frames;) {
+    if(ready_position == hop) {
+      if(active_mode == modes::wsola) {
+        wsola_hop(*sample, step, advance);
+      } else {
+        vocoder_hop(*sample, step, advance);
+      }
+      ready_position = 0;
+    }
+    unsigned int const count{std::min(frames - done, hop - ready_position)};
+    mix::copy(std::span<float const>{overlap}.subspan(ready_position, count), std::span{mix_buffer}.subspan(done, count));
+    ready_position += count;
+    done += count;
+  }
+
+  for(auto const &output : outputs) {
+    for(unsigned int channel{0}; channel != static_cast<unsigned int>(output.numberOfChannels); ++channel) {
+      mix::accumulate(std::span<float const>{mix_buffer}.first(frames), mix::channel(output, channel), current.gain);
+    }
+  }
+}
+
+unsigned int time_stretch::get_hop_frames(modes const query_mode) const {
+  /// Output frames per grain: 50% overlap for WSOLA, 75% for the phase vocoder so its phase estimates stay unambiguous
+  switch(query_mode) {
+  case modes::wsola:
+    return wsola_grain_frames / 2;
+  case modes::phase_vocoder:
+    return vocoder_frames / 4;
+  }
+  return 0;
+}
+
+void time_stretch::reset(sample_data const *const new_source, modes const new_mode) {
+  /// Start afresh from the beginning of a source
+  active_source = new_source;
+  active_mode = new_mode;
+  position = 0.0;
+  previous_start = 0.0;
+  primed = false;
+  ready_position = get_hop_frames(new_mode);                                    // nothing left to output, so the first quantum computes a grain
+  mix::clear(overlap);
+}
+
+void time_stretch::read_resampled(sample_data const &sample, double const start, float const step, std::span<float> const output) {
+  /// Read a run of frames from the looped source at a fractional start position and rate, with linear interpolation
+  double const wrapped{wrap(start, sample.get_frames())};
+  auto const first{static_cast<size_t>(wrapped)};
+  float offset{static_cast<float>(wrapped - static_cast<double>(first))};
+  size_t const count{static_cast<size_t>(offset + step * static_cast<float>(output.size() - 1)) + 2}; // one extra frame for interpolating past the last position
+  assert(count <= decoded.size() && "time stretch read longer than its decode buffer");
+  sample.decode_looped(first, std::span{decoded}.first(count));
+  for(float &frame : output) {
+    auto const index{static_cast<size_t>(offset)};
+    float const fraction{offset - static_cast<float>(index)};
+    frame = decoded[index] + (decoded[index + 1] - decoded[index]) * fraction;
+    offset += step;
+  }
+}
+
+void time_stretch::wsola_hop(sample_data const &sample, float const step, double const advance) {
+  /// Output a grain from near the nominal position, shifted within the tolerance to best continue the previous grain's waveform
+  unsigned int const grain_frames{wsola_grain_frames};
+  unsigned int const hop{grain_frames / 2};
+  std::span<float> chosen;
+  if(!primed) {
+    chosen = std::span{grain}.first(grain_frames);
+    read_resampled(sample, position, step, chosen);
+    previous_start = position;
+  } else {
+    read_resampled(sample, previous_start + static_cast<double>(hop) * static_cast<double>(step), step, target); // where the previous grain would naturally have continued
+    auto const search{std::span{grain}.first(2 * wsola_tolerance + grain_frames)};
+    read_resampled(sample, position - static_cast<double>(wsola_tolerance) * static_cast<double>(step), step, search);
+
+    float energy{dot(search.data(), search.data(), hop)};
+    float best_score{-std::numeric_limits<float>::infinity()};
+    unsigned int best{wsola_tolerance};
+    for(unsigned int candidate{0}; candidate <= 2 * wsola_tolerance; ++candidate) { // normalised cross-correlation against each candidate start, so loud regions aren't favoured
+      float const score{dot(target.data(), &search[candidate], hop) / std::sqrt(std::max(energy, 0.0f) + 1.0e-9f)};
+      if(score > best_score) {
+        best_score = score;
+        best = candidate;
+      }
+      if(candidate != 2 * wsola_tolerance) {                                    // slide the energy window along by one frame
+        energy += search[candidate + hop] * search[candidate + hop] - search[candidate] * search[candidate];
+      }
+    }
+    chosen = search.subspan(best, grain_frames);
+    previous_start = wrap(position + (static_cast<double>(best) - static_cast<double>(wsola_tolerance)) * static_cast<double>(step), sample.get_frames());
+  }
+  apply_window(chosen, wsola_window);
+  overlap_add(chosen, 1.0f);
+  position = wrap(position + advance, sample.get_frames());
+}
+
+void time_stretch::vocoder_hop(sample_data const &sample, float const step, double const advance) {
+  /// Output a frame with each bin's magnitude from the source, and its phase advanced by how far that bin's phase moves over one hop in the source
+  /// Reading both frames from the source at a hop apart measures the phase advance directly, without unwrapping or frequency estimation
+  unsigned int const frames{vocoder_frames};
+  unsigned int const hop{frames / 4};
+  auto const frame{std::span{grain}.first(frames)};
+  read_resampled(sample, position, step, frame);
+  apply_window(frame, vocoder_window);
+  vocoder_fft->forward(frame, spectrum);
+  if(primed) {
+    read_resampled(sample, position - static_cast<double>(hop) * static_cast<double>(step), step, previous_grain);
+    apply_window(previous_grain, vocoder_window);
+    vocoder_fft->forward(previous_grain, previous_spectrum);
+  }
+
+  float constexpr silence{1.0e-20f};
+  for(unsigned int bin{0}; bin != spectrum.size(); ++bin) {
+    float const magnitude{std::sqrt(std::norm(spectrum[bin]))};
+    if(!primed) {                                                               // start from the source's own phases
+      phasors[bin] = magnitude > silence ? spectrum[bin] / magnitude : std::complex<float>{1.0f, 0.0f};
+    } else {
+      std::complex<float> const rotated{phasors[bin] * spectrum[bin] * std::conj(previous_spectrum[bin])};
+      float const length{std::sqrt(std::norm(rotated))};
+      if(length > silence) phasors[bin] = rotated / length;                     // renormalised every hop, so rounding can't accumulate
+    }
+    spectrum[bin] = phasors[bin] * magnitude;
+  }
+  vocoder_fft->inverse(spectrum, frame);
+  apply_window(frame, vocoder_window);
+  overlap_add(frame, 2.0f / 3.0f);                                              // squared Hann windows overlap-add to 1.5 at 75% overlap
+  position = wrap(position + advance, sample.get_frames());
+}
+
+void time_stretch::overlap_add(std::span<float const> const windowed_grain, float const grain_gain) {
+  /// Retire the hop that has been output, and add a new grain to the accumulator
+  auto const hop{static_cast<ptrdiff_t>(get_hop_frames(active_mode))};
+  auto const accumulator{std::span{overlap}.first(windowed_grain.size())};
+  if(primed) {
+    std::copy(accumulator.begin() + hop, accumulator.end(), accumulator.begin());
+    mix::clear(accumulator.last(static_cast<size_t>(hop)));
+  }
+  mix::accumulate(windowed_grain, accumulator, grain_gain);
+  primed = true;
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <optional>
+#include <span>
+#include <vector>
+#include <emscripten/webaudio.h>
+#include "fft.h"
+#include "sample_cache.h"
+#include "sample_data.h"
+
+namespace audio {
+
+class time_stretch {
+  /// Loops a sample with independent control of speed and pitch, mixed into every output channel
+  /// Each grain is resampled by the pitch ratio as it's read, while the read position advances by the speed, so the two never interact
+  /// WSOLA suits speech and other transient material at low latency; the phase vocoder keeps tonal music smoother at the cost of more latency and smeared transients
+public:
+  enum class modes {
+    wsola,                                                                      // waveform similarity overlap-add, time domain
+    phase_vocoder,                                                              // frequency domain, with phases advanced from the source's own phase differences
+  };
+  struct parameters {
+    float speed{1.0f};                                                          // playback speed, independent of pitch
+    float pitch{0.0f};                                                          // transposition in semitones, independent of speed
+    float gain{0.5f};
+    modes mode{modes::wsola};
+  };
+  static float constexpr min_speed{0.25f};
+  static float constexpr max_speed{4.0f};
+  static float constexpr max_pitch{12.0f};                                      // in semitones either way
+  static float constexpr max_step{4.0f};                                        // largest source frames per output frame, including sample rate conversion, bounding the decode work
+
+private:
+  std::atomic<bool> enabled{false};
+  sample_cache::atomic_handle source;                                           // pins the sample against eviction while it's selected
+  std::atomic<float> speed{parameters{}.speed};
+  std::atomic<float> pitch{parameters{}.pitch};
+  std::atomic<float> gain{parameters{}.gain};
+  std::atomic<modes> mode{parameters{}.mode};
+
+  float sample_rate{0.0f};
+  unsigned int wsola_grain_frames{0};                                           // sizes derived from the sample rate by set_sample_rate
+  unsigned int wsola_tolerance{0};                                              // furthest a grain may be shifted from its nominal position to line up with the previous one
+  unsigned int vocoder_frames{0};
+  std::optional<fft> vocoder_fft;
+
+  std::vector<float> wsola_window;                                              // periodic Hann windows, summing to unity at each mode's overlap
+  std::vector<float> vocoder_window;
+  std::vector<float> decoded;                                                   // preallocated scratch: source frames covering one grain read
+  std::vector<float> grain;                                                     // resampled grain, or WSOLA search region
+  std::vector<float> target;                                                    // WSOLA natural continuation of the previous grain
+  std::vector<float> previous_grain;                                            // phase vocoder frame one hop earlier in the source
+  std::vector<std::complex<float>> spectrum;
+  std::vector<std::complex<float>> previous_spectrum;
+  std::vector<std::complex<float>> phasors;                                     // phase vocoder output phase per bin, as unit complex numbers
+  std::vector<float> overlap;                                                   // overlap-add accumulator, the first hop of which is complete and being output
+  std::vector<float> mix_buffer;                                                // one quantum of mono output
+
+  sample_data const *active_source{nullptr};                                    // audio thread state, reset when the source or mode changes
+  modes active_mode{modes::wsola};
+  double position{0.0};                                                         // nominal source position of the next grain, in source frames
+  double previous_start{0.0};                                                   // where the last WSOLA grain was actually read from
+  bool primed{false};                                                           // a grain has been output since the last reset
+  unsigned int ready_position{0};                                               // frames of the completed hop already output
+
+public:
+  explicit time_stretch(unsigned int max_frames_per_quantum = 1024);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void set_enabled(bool new_enabled);
+  bool is_enabled() const;
+  void set_source(sample_cache::handle new_source);
+  sample_cache::handle get_source() const;
+  void set_parameters(parameters const &params);
+  parameters get_parameters() const;
+
+  void output(std::span<AudioSampleFrame> outputs);
+
+private:
+  unsigned int get_hop_frames(modes query_mode) const;
+  void reset(sample_data const *new_source, modes new_mode);
+  void read_resampled(sample_data const &sample, double start, float step, std::span<float> output);
+  void wsola_hop(sample_data const &sample, float step, double advance);
+  void vocoder_hop(sample_data const &sample, float step, double advance);
+  void overlap_add(std::span<float const> windowed_grain, float grain_gain);
+};
+
+}
@@ -0,0 +1,229 @@
+#include "voice_manager.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <boost/math/constants/constants.hpp>
+#include "mix.h"
+
+namespace audio {
+
+voice_manager::voice_manager(unsigned int const capacity, unsigned int const max_frames_per_quantum)
+  : controls(capacity),
+    commands{capacity * 4},                                                     // room for every voice to be stopped and restarted twice per quantum
+    voice_states(capacity),
+    modulator{capacity},
+    mix_buffer(max_frames_per_quantum),
+    decode_buffer(static_cast<size_t>(static_cast<float>(max_frames_per_quantum) * max_playback_rate) + 3) {
+  /// Preallocate everything the audio thread needs
+  ranking.reserve(capacity);
+}
+
+void voice_manager::set_sample_rate(unsigned int const new_sample_rate) {
+  sample_rate = static_cast<float>(new_sample_rate);
+}
+void voice_manager::set_max_real_voices(unsigned int const new_max_real_voices) {
+  max_real_voices.store(new_max_real_voices, std::memory_order_relaxed);
+}
+
+unsigned int voice_manager::get_capacity() const {
+  return static_cast<unsigned int>(controls.size());
+}
+unsigned int voice_manager::get_max_real_voices() const {
+  return max_real_voices.load(std::memory_order_relaxed);
+}
+unsigned int voice_manager::get_real_voices() const {
+  return real_voices.load(std::memory_order_relaxed);
+}
+unsigned int voice_manager::get_virtual_voices() const {
+  return virtual_voices.load(std::memory_order_relaxed);
+}
+modulation &voice_manager::get_modulation() {
+  /// Access the shared modulation patch, which can be edited from the main thread at any time
+  return modulator;
+}
+
+void voice_manager::start(unsigned int const index, parameters const &params) {
+  /// Activate a source, or retrigger it if already active, restarting its noise stream from the given seed - main thread
+  update(index, params);
+  controls[index].active.store(true, std::memory_order_release);
+  queue({.index{index}, .start{true}});
+}
+
+void voice_manager::update(unsigned int const index, parameters const &params) {
+  /// Change the parameters of a source, which take effect from the next quantum - main thread
+  assert(index < controls.size() && "voice index out of range in update");
+  auto &voice_control{controls[index]};
+  voice_control.frequency.store(   params.frequency,    std::memory_order_relaxed);
+  voice_control.gain.store(        params.gain,         std::memory_order_relaxed);
+  voice_control.distance.store(    params.distance,     std::memory_order_relaxed);
+  voice_control.priority.store(    params.priority,     std::memory_order_relaxed);
+  voice_control.noise_source.store(params.noise_source, std::memory_order_relaxed);
+  voice_control.noise_colour.store(params.noise_colour, std::memory_order_relaxed);
+  voice_control.noise_seed.store(  params.noise_seed,   std::memory_order_relaxed);
+  voice_control.sample.store(params.sample);
+}
+
+void voice_manager::stop(unsigned int const index) {
+  /// Deactivate a source, which fades out over the next quantum, or over its release if an envelope is routed to gain - main thread
+  assert(index < controls.size() && "voice index out of range in stop");
+  controls[index].active.store(false, std::memory_order_release);
+  queue({.index{index}, .start{false}});
+}
+
+void voice_manager::queue(command const &new_command) {
+  /// Send a start or stop to the audio thread - main thread
+  if(!commands.write({&new_command, 1})) commands_overflowed.store(true, std::memory_order_release); // the audio thread falls back to each voice's latest state
+}
+
+void voice_manager::apply(command const &received) {
+  /// Trigger or release a source's envelopes for a start or stop - audio thread
+  auto &state{voice_states[received.index]};
+  if(received.start) {
+    state.noise_stream.reseed(controls[received.index].noise_seed.load(std::memory_order_relaxed), received.index); // an independent stream per voice, the same on every start
+    modulator.trigger(received.index);
+  } else if(state.gate) {
+    modulator.release(received.index);
+  }
+  state.gate = received.start;
+}
+
+float voice_manager::estimate_audibility(control const &voice_control) const {
+  /// Cheap loudness estimate at the listener, from gain and inverse distance attenuation
+  float const distance{std::max(voice_control.distance.load(std::memory_order_relaxed), reference_distance)};
+  return voice_control.gain.load(std::memory_order_relaxed) * (reference_distance / distance);
+}
+
+void voice_manager::output(std::span<AudioSampleFrame> const outputs) {
+  /// Mix the most audible sources into all outputs, and advance the rest analytically - audio thread
+  if(outputs.empty() || sample_rate <= 0.0f) return;
+  auto const frames{static_cast<unsigned int>(outputs.front().samplesPerChannel)};
+  assert(frames <= mix_buffer.size() && "quantum larger than voice_manager was constructed for");
+  float constexpr two_pi{2.0f * boost::math::constants::pi<float>()};
+
+  // trigger and release envelopes for every start and stop in the order they were made, so a source stopped and restarted within a quantum is retriggered, then evaluate modulation for all sources at once
+  std::array<command, 64> received;
+  for(size_t count{commands.read(received)}; count != 0; count = commands.read(received)) {
+    for(size_t i{0}; i != count; ++i) {
+      apply(received[i]);
+    }
+  }
+  if(commands_overflowed.exchange(false, std::memory_order_acquire)) {          // some commands were lost, so catch up with each source's latest state
+    for(unsigned int i{0}; i != controls.size(); ++i) {
+      bool const active{controls[i].active.load(std::memory_order_acquire)};
+      if(active != voice_states[i].gate) apply({.index{i}, .start{active}});
+    }
+  }
+  modulator.evaluate(frames, sample_rate);
+
+  // estimate audibility and rank active and releasing sources
+  ranking.clear();
+  for(unsigned int i{0}; i != controls.size(); ++i) {
+    auto &state{voice_states[i]};
+    state.target_gain = 0.0f;
+    state.selected = false;
+    if(!state.gate && !modulator.is_releasing(i)) continue;
+    state.audibility = estimate_audibility(controls[i]) * modulator.get_gain(i);
+    if(state.audibility < audibility_threshold) continue;
+    ranking.emplace_back(i);
+  }
+  unsigned int const real_count{std::min(static_cast<unsigned int>(ranking.size()), max_real_voices.load(std::memory_order_relaxed))};
+  auto const priority_audibility{[&](unsigned int index){
+    return voice_states[index].audibility * controls[index].priority.load(std::memory_order_relaxed);
+  }};
+  std::nth_element(ranking.begin(), ranking.begin() + real_count, ranking.end(), [&](unsigned int lhs, unsigned int rhs){
+    return priority_audibility(lhs) > priority_audibility(rhs);
+  });
+  for(unsigned int i{0}; i != real_count; ++i) {
+    auto &state{voice_states[ranking[i]]};
+    state.target_gain = state.audibility;
+    state.selected = true;
+  }
+
+  // render real voices, including any ramping down to become virtual, and advance virtual ones in closed form
+  mix::clear({mix_buffer.data(), frames});
+  unsigned int rendered_count{0};
+  unsigned int virtual_count{0};
+  for(unsigned int i{0}; i != controls.size(); ++i) {
+    auto &state{voice_states[i]};
+    float const frequency{controls[i].frequency.load(std::memory_order_relaxed) * std::exp2(modulator.get_pitch(i) / 12.0f)};
+    float const phase_increment{frequency * two_pi / sample_rate};
+    auto const *sample{controls[i].sample.get()};
+    if(sample && sample->get_frames() == 0 && !controls[i].noise_source.load(std::memory_order_relaxed)) { // an empty sample has nothing to play or loop over, so the source stays silent
+      state.rendered_gain = 0.0f;
+      state.audible = false;
+      if(state.gate) ++virtual_count;
+      continue;
+    }
+    float const playback_rate{sample ? std::min(frequency / sample->get_root_frequency() * static_cast<float>(sample->get_sample_rate()) / sample_rate, max_playback_rate) : 0.0f};
+
+    if(!state.selected && !state.audible) {                                     // virtual or inactive: skip rendering entirely
+      if(sample) {
+        state.sample_position = std::fmod(state.sample_position + static_cast<double>(playback_rate * static_cast<float>(frames)), static_cast<double>(sample->get_frames()));
+      } else {
+        state.phase = std::fmod(state.phase + phase_increment * static_cast<float>(frames), two_pi);
+      }
+      if(state.gate) ++virtual_count;
+      continue;
+    }
+
+    float const gain_step{(state.target_gain - state.rendered_gain) / static_cast<float>(frames)}; // ramp over the quantum to avoid clicks when becoming real or virtual
+    if(controls[i].noise_source.load(std::memory_order_relaxed)) {
+      render_noise(state, controls[i].noise_colour.load(std::memory_order_relaxed), frames, gain_step);
+    } else if(sample) {
+      render_sample(state, *sample, playback_rate, frames, gain_step);
+    } else {
+      float gain{state.rendered_gain};
+      float phase{state.phase};
+      for(unsigned int frame{0}; frame != frames; ++frame) {
+        gain += gain_step;
+        mix_buffer[frame] += std::sin(phase) * gain;
+        phase += phase_increment;
+      }
+      state.phase = std::fmod(phase, two_pi);
+    }
+    state.rendered_gain = state.target_gain;
+    state.audible = state.selected;
+    ++rendered_count;
+  }
+  real_voices.store(rendered_count, std::memory_order_relaxed);
+  virtual_voices.store(virtual_count, std::memory_order_relaxed);
+  if(rendered_count == 0) return;
+
+  for(auto const &output : outputs) {
+    for(unsigned int channel{0}; channel != static_cast<unsigned int>(output.numberOfChannels); ++channel) {
+      mix::accumulate({mix_buffer.data(), frames}, mix::channel(output, channel), 1.0f);
+    }
+  }
+}
+
+void voice_manager::render_sample(voice_state &state, sample_data const &sample, float const playback_rate, unsigned int const frames, float const gain_step) {
+  /// Decode only the frames this quantum covers from the compact sample format, then resample them into the mix
+  auto const start{static_cast<size_t>(state.sample_position)};
+  float position{static_cast<float>(state.sample_position - static_cast<double>(start))};
+  auto const decoded{std::span{decode_buffer}.first(static_cast<size_t>(position + playback_rate * static_cast<float>(frames)) + 2)}; // two extra frames for interpolating past the last position
+  sample.decode_looped(start, decoded);
+
+  float gain{state.rendered_gain};
+  for(unsigned int frame{0}; frame != frames; ++frame) {
+    gain += gain_step;
+    auto const index{static_cast<size_t>(position)};
+    float const fraction{position - static_cast<float>(index)};
+    mix_buffer[frame] += (decoded[index] + (decoded[index + 1] - decoded[index]) * fraction) * gain;
+    position += playback_rate;
+  }
+  state.sample_position = std::fmod(static_cast<double>(start) + static_cast<double>(position), static_cast<double>(sample.get_frames()));
+}
+
+void voice_manager::render_noise(voice_state &state, noise::colours const colour, unsigned int const frames, float const gain_step) {
+  /// Generate this voice's own noise stream into scratch, then ramp it into the mix - virtual noise voices don't advance, as there's no phase to keep in step
+  auto const generated{std::span{decode_buffer}.first(frames)};
+  state.noise_stream.generate(colour, generated);
+  float gain{state.rendered_gain};
+  for(unsigned int frame{0}; frame != frames; ++frame) {
+    gain += gain_step;
+    mix_buffer[frame] += generated[frame] * gain;
+  }
+}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <emscripten/webaudio.h>
+#include "modulation.h"
+#include "noise.h"
+#include "ring_buffer.h"
+#include "sample_cache.h"
+#include "sample_data.h"
+
+namespace audio {
+
+class voice_manager {
+  /// Pool of sound sources, of which only the most audible are actually rendered each quantum
+  /// Sources that miss out become virtual: they cost nothing to render, but keep advancing analytically so they resume in phase
+public:
+  struct parameters {
+    float frequency{440.0f};                                                    // tone frequency in Hz
+    float gain{1.0f};                                                           // linear gain before distance attenuation
+    float distance{1.0f};                                                       // distance from the listener, in the same units as reference_distance
+    float priority{1.0f};                                                       // audibility multiplier, above 1 favours this source when competing for real voices
+    sample_cache::handle sample;                                                // if set, loop this sample transposed from its root frequency instead of generating a sine, silent until it has loaded
+    bool noise_source{false};                                                   // if set, play this voice's own noise stream instead of a sine or sample
+    noise::colours noise_colour{noise::colours::white};
+    uint32_t noise_seed{0};                                                     // with the voice index, selects the noise stream, which restarts each time the voice starts
+  };
+  static float constexpr max_playback_rate{4.0f};                               // two octaves above a sample's root frequency, bounding the decode work per quantum
+
+private:
+  struct control {                                                              // written by the main thread, read by the audio thread
+    std::atomic<bool> active{false};                                            // latest state, only consulted if starts and stops were lost to a full command queue
+    std::atomic<float> frequency{parameters{}.frequency};
+    std::atomic<float> gain{parameters{}.gain};
+    std::atomic<float> distance{parameters{}.distance};
+    std::atomic<float> priority{parameters{}.priority};
+    sample_cache::atomic_handle sample;                                         // pins the sample against eviction for as long as the voice refers to it
+    std::atomic<bool> noise_source{parameters{}.noise_source};
+    std::atomic<noise::colours> noise_colour{parameters{}.noise_colour};
+    std::atomic<uint32_t> noise_seed{parameters{}.noise_seed};
+  };
+
+  struct command {                                                              // a start or stop, queued so that several for one voice within a quantum all take effect, in order
+    unsigned int index{0};
+    bool start{false};
+  };
+
+  struct voice_state {                                                          // owned by the audio thread
+    float phase{0.0f};
+    noise noise_stream;                                                         // reseeded from the voice's seed and index on every start, so renders are reproducible
+    double sample_position{0.0};                                                // read position in frames when playing a sample, in double to keep sub-sample precision in long samples
+    float rendered_gain{0.0f};                                                  // gain applied at the end of the last rendered quantum, zero when virtual
+    float target_gain{0.0f};                                                    // gain to ramp to over this quantum, zero if not selected for rendering
+    bool selected{false};                                                       // chosen as one of the real voices this quantum
+    bool audible{false};                                                        // was real last quantum, so must ramp down before going virtual
+    bool gate{false};                                                           // last active state seen, to trigger and release envelopes
+    float audibility{0.0f};                                                     // estimated loudness at the listener, used for ranking
+  };
+
+  std::vector<control> controls;
+  ring_buffer<command> commands;                                                // starts and stops, main thread to audio thread
+  std::atomic<bool> commands_overflowed{false};                                 // set by the main thread when a command didn't fit in the queue
+  std::vector<voice_state> voice_states;
+  modulation modulator;                                                         // envelopes and LFOs for every source, applied to pitch and gain
+  std::vector<unsigned int> ranking;                                            // preallocated scratch for sorting voices by audibility
+  std::vector<float> mix_buffer;                                                // preallocated mono mix of all real voices for one quantum
+  std::vector<float> decode_buffer;                                             // preallocated scratch for the sample or noise frames one voice reads in a quantum
+
+  float sample_rate{0.0f};
+  float reference_distance{1.0f};                                               // distance at which attenuation is unity
+  float audibility_threshold{0.001f};                                           // -60dB - quieter sources are always virtual
+
+  std::atomic<unsigned int> max_real_voices{32};
+  std::atomic<unsigned int> real_voices{0};                                     // telemetry published by the audio thread
+  std::atomic<unsigned int> virtual_voices{0};
+
+public:
+  explicit voice_manager(unsigned int capacity, unsigned int max_frames_per_quantum = 1024);
+
+  void set_sample_rate(unsigned int new_sample_rate);
+  void set_max_real_voices(unsigned int new_max_real_voices);
+
+  unsigned int get_capacity() const;
+  unsigned int get_max_real_voices() const;
+  unsigned int get_real_voices() const;
+  unsigned int get_virtual_voices() const;
+  modulation &get_modulation();
+
+  void start(unsigned int index, parameters const &params);
+  void update(unsigned int index, parameters const &params);
+  void stop(unsigned int index);
+
+  void output(std::span<AudioSampleFrame> outputs);
+
+private:
+  void queue(command const &new_command);
+  void apply(command const &received);
+  float estimate_audibility(control const &voice_control) const;
+  void render_sample(voice_state &state, sample_data const &sample, float playback_rate, unsigned int frames, float gain_step);
+  void render_noise(voice_state &state, noise::colours colour, unsigned int frames, float gain_step);
+};
+
+}
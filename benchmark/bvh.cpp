@@ -0,0 +1,107 @@
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <vector>
+#include "render/bvh.h"
+#include "render/frustum.h"
+
+namespace {
+
+/// Building, refitting and culling the bounding volume hierarchy over 10k to 1M unit boxes scattered at constant density, against testing every box
+
+std::vector<aabb3f> scatter(size_t const count, float const jitter = 0.0f) {
+  /// Unit boxes at the same positions for a given count every run, optionally each nudged up to the jitter along every axis, as moving objects would be
+  float const half_extent{5.0f * std::cbrt(static_cast<float>(count))};         // grow the volume with the count, so density and the visible fraction stay constant
+  std::mt19937 generator{12'345};
+  std::mt19937 jitter_generator{67'890};                                        // separate, so positions don't depend on the jitter
+  std::uniform_real_distribution<float> position{-half_extent, half_extent};
+  std::uniform_real_distribution<float> nudge{-jitter, jitter};
+  std::vector<aabb3f> boxes(count);
+  for(auto &box : boxes) {
+    vec3f centre{position(generator), position(generator), position(generator)};
+    if(jitter > 0.0f) centre += vec3f{nudge(jitter_generator), nudge(jitter_generator), nudge(jitter_generator)};
+    box = {centre - vec3f{0.5f, 0.5f, 0.5f}, centre + vec3f{0.5f, 0.5f, 0.5f}};
+  }
+  return boxes;
+}
+
+render::frustum view(size_t const count) {
+  /// A 60 degree view from the middle of the volume looking along z, seeing a few percent of it
+  float const half_extent{5.0f * std::cbrt(static_cast<float>(count))};
+  float constexpr near_plane{1.0f};
+  float const half_width{std::tan(std::numbers::pi_v<float> / 6.0f) * near_plane};
+  mat4f const projection{mat4f::create_frustum(-half_width, half_width, -half_width, half_width, near_plane, half_extent * 2.0f)};
+  mat4f const look_at{mat4f::create_look_at({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f})};
+  return render::frustum{projection * look_at};
+}
+
+void build(benchmark::State &state) {
+  auto const boxes{scatter(static_cast<size_t>(state.range(0)))};
+  render::bvh hierarchy;
+  for(auto _ : state) {
+    hierarchy.build(boxes);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["nodes"] = static_cast<double>(hierarchy.get_node_count());
+}
+
+void refit(benchmark::State &state) {
+  /// Alternate between the original boxes and a jittered copy, so every refit sees every box move
+  auto const count{static_cast<size_t>(state.range(0))};
+  auto const boxes{scatter(count)};
+  auto const moved{scatter(count, 0.5f)};
+  render::bvh hierarchy;
+  hierarchy.build(boxes);
+  bool flip{false};
+  for(auto _ : state) {
+    hierarchy.refit(flip ? boxes : moved);
+    flip = !flip;
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  hierarchy.refit(moved);
+  state.counters["degradation"] = static_cast<double>(hierarchy.get_degradation()); // with the boxes moved from where the tree was built
+}
+
+void cull(benchmark::State &state) {
+  auto const count{static_cast<size_t>(state.range(0))};
+  auto const boxes{scatter(count)};
+  auto const frustum{view(count)};
+  render::bvh hierarchy;
+  hierarchy.build(boxes);
+  std::vector<uint32_t> visible;
+  for(auto _ : state) {
+    hierarchy.cull(frustum, visible);
+    benchmark::DoNotOptimize(visible.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["visible"] = static_cast<double>(visible.size());
+}
+
+void cull_linear(benchmark::State &state) {
+  /// The baseline the hierarchy replaces: every box tested against every plane
+  auto const count{static_cast<size_t>(state.range(0))};
+  auto const boxes{scatter(count)};
+  auto const frustum{view(count)};
+  std::vector<uint32_t> visible;
+  visible.reserve(count);
+  for(auto _ : state) {
+    visible.clear();
+    for(uint32_t i{0}; i != count; ++i) {
+      unsigned int plane_mask{render::frustum::all_planes};
+      if(frustum.test(boxes[i], plane_mask) != render::frustum::results::outside) visible.emplace_back(i);
+    }
+    benchmark::DoNotOptimize(visible.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["visible"] = static_cast<double>(visible.size());
+}
+
+BENCHMARK(build)->Name("bvh/build")->ArgName("boxes")->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(refit)->Name("bvh/refit")->ArgName("boxes")->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(cull)->Name("bvh/cull")->ArgName("boxes")->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(cull_linear)->Name("bvh/cull_linear")->ArgName("boxes")->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMillisecond);
+
+}
@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <vector>
+#include "audio/delay_effects.h"
+
+namespace {
+
+/// Each delay effect, and the whole chain, over 48kHz stereo in 128-frame quanta, reporting frames per second and the multiple of realtime
+
+unsigned int constexpr sample_rate{48'000};
+unsigned int constexpr channels{2};
+unsigned int constexpr quantum{128};
+
+std::vector<float> const &tone() {
+  /// A second of 220Hz tone, copied in a quantum at a time so the delays always have signal to read and feedback never accumulates beyond a second
+  static std::vector<float> const samples{[]{
+    std::vector<float> result(sample_rate);
+    for(unsigned int i{0}; i != sample_rate; ++i) {
+      result[i] = 0.5f * std::sin(2.0f * std::numbers::pi_v<float> * 220.0f * static_cast<float>(i) / sample_rate);
+    }
+    return result;
+  }()};
+  return samples;
+}
+
+template<typename effect_type>
+void run(benchmark::State &state, effect_type &effect) {
+  /// Render quanta through an effect, refilling the buffer with the tone before each - the copy is included, and is all the bypassed chain measures
+  std::vector<float> samples(channels * quantum);
+  AudioSampleFrame frame{.numberOfChannels{channels}, .samplesPerChannel{quantum}, .data{samples.data()}};
+  auto const &source{tone()};
+  size_t position{0};
+  for(auto _ : state) {
+    std::copy_n(&source[position], quantum, &samples[0]);
+    std::copy_n(&source[position], quantum, &samples[quantum]);
+    position = (position + quantum) % (source.size() - quantum);
+    effect.output({&frame, 1});
+    benchmark::ClobberMemory();
+  }
+  state.counters["frames_per_second"] = benchmark::Counter(static_cast<double>(state.iterations() * quantum), benchmark::Counter::kIsRate);
+  state.counters["realtime_multiple"] = benchmark::Counter(static_cast<double>(state.iterations() * quantum) / sample_rate, benchmark::Counter::kIsRate);
+}
+
+template<typename effect_type>
+void single_effect(benchmark::State &state) {
+  effect_type effect{channels};
+  effect.set_sample_rate(sample_rate);
+  effect.set_enabled(true);
+  run(state, effect);
+}
+
+template<typename effect_type>
+void modulated_effect(benchmark::State &state) {
+  /// Run a modulated effect with the interpolation selected by the benchmark argument
+  effect_type effect{channels};
+  effect.set_sample_rate(sample_rate);
+  effect.set_enabled(true);
+  auto params{effect.get_parameters()};
+  params.interpolation = static_cast<audio::interpolations>(state.range(0));
+  effect.set_parameters(params);
+  state.SetLabel(std::array{"linear", "allpass", "cubic"}[static_cast<size_t>(state.range(0))]);
+  run(state, effect);
+}
+
+void full_chain(benchmark::State &state) {
+  audio::effects::chain effects{channels};
+  effects.set_sample_rate(sample_rate);
+  effects.chorus_effect.set_enabled(true);
+  effects.flanger_effect.set_enabled(true);
+  effects.echo_effect.set_enabled(true);
+  effects.multi_tap_effect.set_enabled(true);
+  run(state, effects);
+}
+
+void bypassed_chain(benchmark::State &state) {
+  audio::effects::chain effects{channels};
+  effects.set_sample_rate(sample_rate);
+  run(state, effects);
+}
+
+BENCHMARK(single_effect<audio::effects::echo>)->Name("delay_effects/echo");
+BENCHMARK(modulated_effect<audio::effects::chorus>)->Name("delay_effects/chorus")->ArgName("interpolation")->DenseRange(0, 2);
+BENCHMARK(modulated_effect<audio::effects::flanger>)->Name("delay_effects/flanger")->ArgName("interpolation")->DenseRange(0, 2);
+BENCHMARK(single_effect<audio::effects::multi_tap>)->Name("delay_effects/multi_tap");
+BENCHMARK(full_chain)->Name("delay_effects/chain/all_enabled");
+BENCHMARK(bypassed_chain)->Name("delay_effects/chain/bypassed");
+
+}
@@ -0,0 +1,63 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include "audio/denormal.h"
+
+namespace {
+
+/// A bank of decaying two-pole resonators, the shape of any filter or feedback tail after its input falls silent, rendering one quantum
+/// The tail starts either at a normal level or already down in the subnormal range, and runs with IEEE subnormals, hardware flushing, or snap()
+
+unsigned int constexpr resonator_count{64};
+unsigned int constexpr quantum{128};
+
+enum class modes {
+  ieee,
+  flush,
+  snap,
+};
+
+struct resonators {
+  std::array<float, resonator_count> z1;
+  std::array<float, resonator_count> z2;
+
+  explicit resonators(float const level) {
+    z1.fill(level);
+    z2.fill(level * 0.5f);
+  }
+};
+
+template<modes mode>
+void render_tail(resonators &state) {
+  float constexpr a1{1.98f};                                                    // poles just inside the unit circle, so the tail rings and decays slowly
+  float constexpr a2{-0.985f};
+  for(unsigned int frame{0}; frame != quantum; ++frame) {
+    for(unsigned int i{0}; i != resonator_count; ++i) {
+      float const output{a1 * state.z1[i] + a2 * state.z2[i]};
+      state.z2[i] = state.z1[i];
+      if constexpr(mode == modes::snap) {
+        state.z1[i] = audio::denormal::snap(output);
+      } else {
+        state.z1[i] = output;
+      }
+    }
+  }
+}
+
+template<modes mode>
+void decaying_tail(benchmark::State &state) {
+  float const level{state.range(0) == 0 ? 1.0e-3f : 1.0e-39f};
+  audio::denormal::scoped_flush const denormal_mode{mode == modes::flush};
+  for(auto _ : state) {
+    resonators tail{level};                                                     // restart every quantum, so the tail never decays out of the range being measured
+    render_tail<mode>(tail);
+    benchmark::DoNotOptimize(tail);
+  }
+  state.SetItemsProcessed(state.iterations() * quantum * resonator_count);
+  state.SetLabel(state.range(0) == 0 ? "normal" : "subnormal");
+}
+
+BENCHMARK(decaying_tail<modes::ieee>)->Name("denormal/decaying_tail/ieee")->Arg(0)->Arg(1);
+BENCHMARK(decaying_tail<modes::flush>)->Name("denormal/decaying_tail/scoped_flush")->Arg(0)->Arg(1);
+BENCHMARK(decaying_tail<modes::snap>)->Name("denormal/decaying_tail/snap")->Arg(0)->Arg(1);
+
+}
@@ -0,0 +1,38 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <vector>
+#include "audio/fm_synth.h"
+
+namespace {
+
+/// The FM synth rendering 48kHz stereo quanta with every voice held, reporting how many voices one quantum's realtime budget would sustain
+
+unsigned int constexpr sample_rate{48'000};
+unsigned int constexpr channels{2};
+unsigned int constexpr quantum{128};
+double constexpr quantum_seconds{static_cast<double>(quantum) / sample_rate};
+
+void render(benchmark::State &state) {
+  auto const voice_count{static_cast<unsigned int>(state.range(0))};
+  audio::fm_synth synth{voice_count};
+  synth.set_sample_rate(sample_rate);
+  synth.set_parameters({.algorithm{static_cast<audio::fm_synth::algorithms>(state.range(1))}, .feedback{0.5f}});
+  for(unsigned int voice{0}; voice != voice_count; ++voice) {
+    synth.note_on(voice, 110.0f + 7.0f * static_cast<float>(voice));
+  }
+
+  std::vector<float> samples(channels * quantum);
+  AudioSampleFrame frame{.numberOfChannels{channels}, .samplesPerChannel{quantum}, .data{samples.data()}};
+  for(auto _ : state) {
+    std::ranges::fill(samples, 0.0f);
+    synth.output({&frame, 1});
+    benchmark::ClobberMemory();
+  }
+  state.SetLabel(state.range(1) == 0 ? "stack" : "additive");
+  state.counters["sounding_voices"] = static_cast<double>(synth.get_sounding_voices());
+  state.counters["sustainable_voices"] = benchmark::Counter(static_cast<double>(state.iterations() * voice_count) * quantum_seconds, benchmark::Counter::kIsRate); // voices rendered per second of CPU, per second of audio
+}
+
+BENCHMARK(render)->Name("fm_synth/render")->ArgNames({"voices", "algorithm"})->ArgsProduct({{8, 32, 128}, {static_cast<int64_t>(audio::fm_synth::algorithms::stack), static_cast<int64_t>(audio::fm_synth::algorithms::additive)}});
+
+}
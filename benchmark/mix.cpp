@@ -0,0 +1,98 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <vector>
+#include "audio/mix.h"
+#include "mix_scalar.h"
+
+namespace {
+
+/// SIMD mixing kernels against plain loops, over one 128-frame render quantum and longer blocks
+
+struct stereo_buffers {
+  std::vector<float> planar;
+  std::vector<float> interleaved;
+  std::vector<float> mono;
+  AudioSampleFrame frame;
+
+  explicit stereo_buffers(size_t const frames)
+    : planar(frames * 2, 0.25f),
+      interleaved(frames * 2, 0.5f),
+      mono(frames),
+      frame{.numberOfChannels{2}, .samplesPerChannel{static_cast<int>(frames)}, .data{planar.data()}} {
+  }
+};
+
+template<auto kernel>
+void accumulate(benchmark::State &state) {
+  auto const frames{static_cast<size_t>(state.range(0))};
+  std::vector<float> const source(frames, 0.25f);
+  std::vector<float> bus(frames);
+  for(auto _ : state) {
+    kernel(source, bus, 0.5f);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<auto kernel>
+void accumulate_many(benchmark::State &state) {
+  unsigned int constexpr source_count{8};
+  auto const frames{static_cast<size_t>(state.range(0))};
+  std::vector<float> const source(frames, 0.25f);
+  std::array<std::span<float const>, source_count> sources;
+  sources.fill(source);
+  std::array<float, source_count> gains;
+  gains.fill(0.125f);
+  std::vector<float> bus(frames);
+  for(auto _ : state) {
+    kernel(sources, gains, bus);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) * source_count);
+}
+
+template<auto kernel>
+void downmix_stereo(benchmark::State &state) {
+  stereo_buffers buffers{static_cast<size_t>(state.range(0))};
+  for(auto _ : state) {
+    kernel(buffers.frame, buffers.mono);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<auto kernel>
+void interleave(benchmark::State &state) {
+  stereo_buffers buffers{static_cast<size_t>(state.range(0))};
+  for(auto _ : state) {
+    kernel(buffers.frame, buffers.interleaved);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<auto kernel>
+void deinterleave(benchmark::State &state) {
+  stereo_buffers buffers{static_cast<size_t>(state.range(0))};
+  for(auto _ : state) {
+    kernel(buffers.interleaved, buffers.frame);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+using accumulate_signature = void(std::span<float const>, std::span<float>, float);
+using accumulate_many_signature = void(std::span<std::span<float const> const>, std::span<float const>, std::span<float>);
+
+BENCHMARK(accumulate<static_cast<accumulate_signature*>(audio::mix::accumulate)>)->Name("mix/accumulate/simd")->Arg(128)->Arg(4'096);
+BENCHMARK(accumulate<static_cast<accumulate_signature*>(audio::mix::scalar::accumulate)>)->Name("mix/accumulate/scalar")->Arg(128)->Arg(4'096);
+BENCHMARK(accumulate_many<static_cast<accumulate_many_signature*>(audio::mix::accumulate)>)->Name("mix/accumulate_8_sources/simd")->Arg(128)->Arg(4'096);
+BENCHMARK(accumulate_many<static_cast<accumulate_many_signature*>(audio::mix::scalar::accumulate)>)->Name("mix/accumulate_8_sources/scalar")->Arg(128)->Arg(4'096);
+BENCHMARK(downmix_stereo<audio::mix::downmix_stereo>)->Name("mix/downmix_stereo/simd")->Arg(128)->Arg(4'096);
+BENCHMARK(downmix_stereo<audio::mix::scalar::downmix_stereo>)->Name("mix/downmix_stereo/scalar")->Arg(128)->Arg(4'096);
+BENCHMARK(interleave<audio::mix::interleave>)->Name("mix/interleave_stereo/simd")->Arg(128)->Arg(4'096);
+BENCHMARK(interleave<audio::mix::scalar::interleave>)->Name("mix/interleave_stereo/scalar")->Arg(128)->Arg(4'096);
+BENCHMARK(deinterleave<audio::mix::deinterleave>)->Name("mix/deinterleave_stereo/simd")->Arg(128)->Arg(4'096);
+BENCHMARK(deinterleave<audio::mix::scalar::deinterleave>)->Name("mix/deinterleave_stereo/scalar")->Arg(128)->Arg(4'096);
+
+}
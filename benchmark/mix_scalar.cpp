@@ -0,0 +1,54 @@
+#include "mix_scalar.h"
+#include <algorithm>
+
+namespace audio::mix::scalar {
+
+void accumulate(std::span<float const> const source, std::span<float> const bus, float const gain) {
+  size_t const count{std::min(source.size(), bus.size())};
+  for(size_t i{0}; i != count; ++i) {
+    bus[i] += source[i] * gain;
+  }
+}
+
+void accumulate(std::span<std::span<float const> const> const sources, std::span<float const> const gains, std::span<float> const bus) {
+  for(size_t i{0}; i != bus.size(); ++i) {
+    float sum{bus[i]};
+    for(size_t source{0}; source != sources.size(); ++source) {
+      sum += sources[source][i] * gains[source];
+    }
+    bus[i] = sum;
+  }
+}
+
+void downmix_stereo(AudioSampleFrame const &input, std::span<float> const mono) {
+  auto const frames{std::min(static_cast<size_t>(input.samplesPerChannel), mono.size())};
+  float const *left{input.data};
+  float const *right{input.data + input.samplesPerChannel};
+  for(size_t i{0}; i != frames; ++i) {
+    mono[i] = (left[i] + right[i]) * 0.5f;
+  }
+}
+
+void interleave(AudioSampleFrame const &planar, std::span<float> const interleaved) {
+  auto const channels{static_cast<size_t>(planar.numberOfChannels)};
+  auto const frames{static_cast<size_t>(planar.samplesPerChannel)};
+  for(size_t index{0}; index != channels; ++index) {
+    float const *source{planar.data + index * frames};
+    for(size_t i{0}; i != frames; ++i) {
+      interleaved[i * channels + index] = source[i];
+    }
+  }
+}
+
+void deinterleave(std::span<float const> const interleaved, AudioSampleFrame const &planar) {
+  auto const channels{static_cast<size_t>(planar.numberOfChannels)};
+  auto const frames{static_cast<size_t>(planar.samplesPerChannel)};
+  for(size_t index{0}; index != channels; ++index) {
+    float *destination{planar.data + index * frames};
+    for(size_t i{0}; i != frames; ++i) {
+      destination[i] = interleaved[i * channels + index];
+    }
+  }
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <span>
+#include <emscripten/webaudio.h>
+
+namespace audio::mix::scalar {
+
+/// Plain loop versions of the audio::mix kernels, built without auto-vectorisation, as a baseline for the SIMD kernels
+
+void accumulate(std::span<float const> source, std::span<float> bus, float gain);
+void accumulate(std::span<std::span<float const> const> sources, std::span<float const> gains, std::span<float> bus);
+
+void downmix_stereo(AudioSampleFrame const &input, std::span<float> mono);
+
+void interleave(AudioSampleFrame const &planar, std::span<float> interleaved);
+void deinterleave(std::span<float const> interleaved, AudioSampleFrame const &planar);
+
+}
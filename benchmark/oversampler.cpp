@@ -0,0 +1,72 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <vector>
+#include "audio/oversampler.h"
+#include "audio/saturation.h"
+
+namespace {
+
+/// Cost of each oversampling factor over a 48kHz 128-frame quantum: the filters alone on one channel, and the stereo saturation effect built on them
+
+unsigned int constexpr sample_rate{48'000};
+unsigned int constexpr channels{2};
+unsigned int constexpr quantum{128};
+
+std::vector<float> const &tone() {
+  /// A second of 220Hz tone, copied in a quantum at a time
+  static std::vector<float> const samples{[]{
+    std::vector<float> result(sample_rate);
+    for(unsigned int i{0}; i != sample_rate; ++i) {
+      result[i] = 0.8f * std::sin(2.0f * std::numbers::pi_v<float> * 220.0f * static_cast<float>(i) / sample_rate);
+    }
+    return result;
+  }()};
+  return samples;
+}
+
+void round_trip(benchmark::State &state) {
+  /// Upsample and downsample one channel with nothing in between, which is the whole overhead oversampling adds to a nonlinearity
+  auto const factor{static_cast<unsigned int>(state.range(0))};
+  audio::oversampler filters;
+  filters.set_factor(factor);
+  std::vector<float> samples(quantum);
+  auto const &source{tone()};
+  size_t position{0};
+  for(auto _ : state) {
+    std::copy_n(&source[position], quantum, samples.data());
+    position = (position + quantum) % (source.size() - quantum);
+    filters.process(samples, [](std::span<float> oversampled){
+      benchmark::DoNotOptimize(oversampled.data());
+    });
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * quantum);
+  state.counters["latency_frames"] = static_cast<double>(filters.get_latency());
+}
+
+void saturate(benchmark::State &state) {
+  /// The saturation effect on stereo, hard clipping, at each factor
+  audio::effects::saturation effect{channels};
+  effect.set_parameters({.shape{audio::effects::saturation::shapes::hard}, .oversampling{static_cast<unsigned int>(state.range(0))}});
+  effect.set_enabled(true);
+  std::vector<float> samples(channels * quantum);
+  AudioSampleFrame frame{.numberOfChannels{channels}, .samplesPerChannel{quantum}, .data{samples.data()}};
+  auto const &source{tone()};
+  size_t position{0};
+  for(auto _ : state) {
+    std::copy_n(&source[position], quantum, &samples[0]);
+    std::copy_n(&source[position], quantum, &samples[quantum]);
+    position = (position + quantum) % (source.size() - quantum);
+    effect.output({&frame, 1});
+    benchmark::ClobberMemory();
+  }
+  state.counters["realtime_multiple"] = benchmark::Counter(static_cast<double>(state.iterations() * quantum) / sample_rate, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(round_trip)->Name("oversampler/round_trip")->ArgName("factor")->RangeMultiplier(2)->Range(1, audio::oversampler::max_factor);
+BENCHMARK(saturate)->Name("oversampler/saturation")->ArgName("factor")->RangeMultiplier(2)->Range(1, audio::oversampler::max_factor);
+
+}
@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <numbers>
+#include <vector>
+#include "audio/pitch_detector.h"
+
+namespace {
+
+/// Pitch detection on a mono 48kHz input over 128-frame quanta, for a range of analysis windows, each detecting periods up to half the window
+
+unsigned int constexpr sample_rate{48'000};
+unsigned int constexpr quantum{128};
+float constexpr tone_frequency{220.0f};
+
+std::vector<float> const &tone() {
+  /// A second of a 220Hz tone with a couple of harmonics, a whole number of periods long so it loops seamlessly
+  static std::vector<float> const samples{[]{
+    std::vector<float> result(sample_rate);
+    for(unsigned int i{0}; i != sample_rate; ++i) {
+      float const phase{2.0f * std::numbers::pi_v<float> * tone_frequency * static_cast<float>(i) / sample_rate};
+      result[i] = 0.5f * std::sin(phase) + 0.2f * std::sin(2.0f * phase) + 0.1f * std::sin(3.0f * phase);
+    }
+    return result;
+  }()};
+  return samples;
+}
+
+void detect(benchmark::State &state) {
+  /// Each iteration feeds one quantum, so the time is the per-quantum cost averaged over the hops it completes
+  auto const window_frames{static_cast<unsigned int>(state.range(0))};
+  audio::pitch_detector detector{window_frames, window_frames / 2};
+  detector.set_sample_rate(sample_rate);
+
+  auto const &source{tone()};
+  AudioSampleFrame input{.numberOfChannels{1}, .samplesPerChannel{quantum}, .data{nullptr}};
+  size_t position{0};
+  for(unsigned int i{0}; i != window_frames / quantum; ++i) {                   // fill the first window, so every measured hop runs a full estimate
+    input.data = const_cast<float*>(&source[position]);
+    detector.process({&input, 1});
+    position = (position + quantum) % source.size();
+  }
+  for(auto _ : state) {
+    input.data = const_cast<float*>(&source[position]);                         // read only by the detector
+    detector.process({&input, 1});
+    position = (position + quantum) % source.size();
+  }
+
+  auto const detected{detector.get_result()};
+  state.counters["frequency"] = static_cast<double>(detected.frequency);
+  state.counters["confidence"] = static_cast<double>(detected.confidence);
+  state.counters["lowest_frequency"] = static_cast<double>(sample_rate) / static_cast<double>(window_frames / 2);
+  state.counters["realtime_multiple"] = benchmark::Counter(static_cast<double>(state.iterations() * quantum) / sample_rate, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(detect)->Name("pitch_detector/detect")->ArgName("window")->RangeMultiplier(2)->Range(512, 8'192);
+
+}
@@ -0,0 +1,68 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "audio/sample_data.h"
+
+namespace {
+
+/// Memory footprint, decode cost per render quantum and accuracy of each sample storage format, against float
+
+unsigned int constexpr sample_rate{48'000};
+unsigned int constexpr quantum{128};
+unsigned int constexpr voices{32};                                              // voices reading the same sample at once, as the voice loop does
+
+std::vector<float> const &source() {
+  /// Five seconds of a decaying tone over a steady one, typical of a pitched instrument sample
+  static std::vector<float> const samples{[]{
+    std::vector<float> result(sample_rate * 5);
+    for(size_t i{0}; i != result.size(); ++i) {
+      auto const time{static_cast<float>(i)};
+      result[i] = 0.5f * std::sin(time * 0.03f) * std::exp(-time / 100'000.0f) + 0.2f * std::sin(time * 0.31f);
+    }
+    return result;
+  }()};
+  return samples;
+}
+
+void decode(benchmark::State &state) {
+  /// Each iteration renders one quantum for every voice, with the voices spread through the sample so reads start at arbitrary ADPCM block offsets
+  auto const format{static_cast<audio::sample_data::formats>(state.range(0))};
+  audio::sample_data const sample{source(), format, sample_rate};
+  std::vector<float> output(quantum);
+
+  std::array<size_t, voices> positions;
+  for(unsigned int voice{0}; voice != voices; ++voice) {
+    positions[voice] = voice * 7'919;                                           // a prime stride, so offsets within blocks vary
+  }
+  for(auto _ : state) {
+    for(auto &position : positions) {
+      sample.decode_looped(position, output);
+      benchmark::DoNotOptimize(output.data());
+      position = (position + quantum) % sample.get_frames();
+    }
+  }
+
+  // accuracy of a full decode against the original
+  std::vector<float> decoded(sample.get_frames());
+  sample.decode(0, decoded);
+  double signal{0.0};
+  double error{0.0};
+  for(size_t i{0}; i != decoded.size(); ++i) {
+    auto const original{static_cast<double>(source()[i])};
+    auto const difference{static_cast<double>(decoded[i]) - original};
+    signal += original * original;
+    error += difference * difference;
+  }
+
+  state.SetLabel(std::array{"float32", "pcm16", "ima_adpcm"}[static_cast<size_t>(state.range(0))]);
+  state.SetItemsProcessed(state.iterations() * quantum * voices);
+  state.counters["bytes"] = static_cast<double>(sample.get_memory_bytes());
+  state.counters["bytes_per_frame"] = static_cast<double>(sample.get_memory_bytes()) / static_cast<double>(sample.get_frames());
+  state.counters["snr_db"] = error > 0.0 ? 10.0 * std::log10(signal / error) : std::numeric_limits<double>::infinity(); // float is exact
+}
+
+BENCHMARK(decode)->Name("sample_data/decode")->ArgName("format")->DenseRange(0, 2);
+
+}
@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+#include <string>
+#include <thread>
+#include <vector>
+#include <emscripten/wasm_worker.h>
+#include "audio/encoder.h"
+#include "audio/sample_cache.h"
+#include "audio/time_stretch.h"
+
+namespace {
+
+/// The time stretch rendering offline into a 48kHz stereo quantum, in each mode, at unity and with speed and pitch both changed
+
+unsigned int constexpr sample_rate{48'000};
+unsigned int constexpr channels{2};
+unsigned int constexpr quantum{128};
+
+struct setting {
+  char const *label;
+  float speed;
+  float pitch;
+};
+std::array constexpr settings{
+  setting{"unity",              1.0f,  0.0f},
+  setting{"slower_fifth_up",    0.5f,  7.0f},
+  setting{"faster_fourth_down", 2.0f, -5.0f},
+};
+
+std::vector<uint8_t> const &source_file() {
+  /// Two seconds of a chord, as a float WAV file for the cache to load exactly
+  static std::vector<uint8_t> const file{[]{
+    std::vector<float> samples(sample_rate * 2);
+    for(size_t i{0}; i != samples.size(); ++i) {
+      float const time{static_cast<float>(i) / sample_rate};
+      for(float const frequency : {220.0f, 277.18f, 329.63f}) {
+        samples[i] += 0.2f * std::sin(2.0f * std::numbers::pi_v<float> * frequency * time);
+      }
+    }
+    return audio::encoder::wav(samples, 1, sample_rate, audio::encoder::sample_formats::float32);
+  }()};
+  return file;
+}
+
+void render(benchmark::State &state) {
+  /// Each iteration renders one quantum, so the time is the per-quantum cost averaged over the grains it completes
+  auto const mode{static_cast<audio::time_stretch::modes>(state.range(0))};
+  auto const &params{settings[static_cast<size_t>(state.range(1))]};
+
+  auto const cache{emscripten_stub::make_int_addressable<audio::sample_cache>(64 * 1024 * 1024)}; // the cache posts itself to its worker as an int
+  auto const sample{cache->request("benchmark/chord.wav", source_file(), audio::sample_data::formats::float32)};
+  while(sample.get_state() == audio::sample_cache::states::loading) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});                  // decoded on the cache's worker
+  }
+  cache->update();
+
+  audio::time_stretch stretch;
+  stretch.set_sample_rate(sample_rate);
+  stretch.set_source(sample);
+  stretch.set_parameters({.speed{params.speed}, .pitch{params.pitch}, .gain{0.5f}, .mode{mode}});
+  stretch.set_enabled(true);
+
+  std::vector<float> samples(channels * quantum);
+  AudioSampleFrame frame{.numberOfChannels{channels}, .samplesPerChannel{quantum}, .data{samples.data()}};
+  for(auto _ : state) {
+    std::ranges::fill(samples, 0.0f);
+    stretch.output({&frame, 1});
+    benchmark::ClobberMemory();
+  }
+  state.SetLabel(std::string{mode == audio::time_stretch::modes::wsola ? "wsola/" : "phase_vocoder/"} + params.label);
+  state.counters["realtime_multiple"] = benchmark::Counter(static_cast<double>(state.iterations() * quantum) / sample_rate, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(render)->Name("time_stretch/render")->ArgNames({"mode", "setting"})->ArgsProduct({{0, 1}, {0, 1, 2}});
+
+}
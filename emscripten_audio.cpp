@@ -5,6 +5,7 @@
 #include <limits>
 #include <utility>
 #include <magic_enum/magic_enum.hpp>
+#include "audio/denormal.h"
 
 extern "C" {
 
@@ -14,6 +15,12 @@ EMSCRIPTEN_KEEPALIVE void audio_worklet_unpause_return(void *callback_data) {
   parent.audio_worklet_unpause();
 }
 
+EMSCRIPTEN_KEEPALIVE void audio_microphone_return(void *callback_data, int connected) {
+  /// Return helper to report the outcome of a microphone request from a js promise
+  auto &parent{*static_cast<emscripten_audio*>(callback_data)};
+  if(parent.callbacks.microphone_connected) parent.callbacks.microphone_connected(connected != 0);
+}
+
 }
 
 static_assert(std::to_underlying(emscripten_audio::states::suspended  ) == AUDIO_CONTEXT_STATE_SUSPENDED  ); // make sure enums stay in sync in case of future updates to Emscripten
@@ -26,6 +33,7 @@ emscripten_audio::emscripten_audio(construction_options &&options)
     latency_hint{options.latency_hint},
     inputs{options.inputs},
     output_channels{std::move(options.output_channels)},
+    flush_denormals{options.flush_denormals},
     callbacks{std::move(options.callbacks)} {
   /// Initialise an Emscripten audio worklet with the given callbacks
   assert(inputs <= std::numeric_limits<int>::max());
@@ -35,23 +43,27 @@ emscripten_audio::emscripten_audio(construction_options &&options)
     std::cerr << "ERROR: Emscripten Audio: Not cross origin isolated - won't be able to use SharedArrayBuffer!" << std::endl;
   }
 
-  sample_rate = static_cast<unsigned int>(EM_ASM_DOUBLE({
-    var AudioContext = window.AudioContext || window.webkitAudioContext;
-    var ctx = new AudioContext();
-    var sr = ctx.sampleRate;
-    ctx.close();
-    return sr;
-  }));
-
   std::string const &latency_hint_str{magic_enum::enum_name(latency_hint)};
   EmscriptenWebAudioCreateAttributes create_audio_context_options{
     .latencyHint{latency_hint_str.c_str()},                                     // one of "balanced", "interactive" or "playback"
-    .sampleRate{sample_rate},                                                   // 44100 or 48000
+    .sampleRate{0},                                                             // leave unspecified, so the context opens at the hardware's native rate
   };
-  EMSCRIPTEN_WEBAUDIO_T emscripten_audio_context{emscripten_create_audio_context(&create_audio_context_options)};
+  context = emscripten_create_audio_context(&create_audio_context_options);     // create the one and only context up front, rather than probing the sample rate with a throwaway one
 
-  emscripten_start_wasm_audio_worklet_thread_async(                             // create the worklet thread
-    emscripten_audio_context,
+  sample_rate = static_cast<unsigned int>(EM_ASM_DOUBLE({
+    return EmAudio[$0].sampleRate;                                              // read back the rate the browser chose for this context
+  }, context));
+  if(callbacks.startup_phase) callbacks.startup_phase("Audio: context created");
+
+  // register a once-only click handler to unpause audio, on the first click on the canvas - the context exists already, so this doesn't have to wait for the worklet
+  EM_ASM({
+    window.addEventListener("click", (event) => {
+      Module["ccall"]('audio_worklet_unpause_return', null, ['number'], [$0]);
+    }, {once : true});
+  }, this);
+
+  emscripten_start_wasm_audio_worklet_thread_async(                             // create the worklet thread - this proceeds in parallel with anything else the caller starts, such as WebGPU device acquisition
+    context,
     audio_thread_stack.data(),
     audio_thread_stack.size(),
     [](EMSCRIPTEN_WEBAUDIO_T audio_context, bool success, void *user_data) {    // EmscriptenStartWebAudioWorkletCallback
@@ -61,7 +73,7 @@ emscripten_audio::emscripten_audio(construction_options &&options)
         std::cerr << "ERROR: Emscripten Audio: Worklet start failed for context " << audio_context << std::endl;
         return;
       }
-      parent.context = audio_context;
+      if(parent.callbacks.startup_phase) parent.callbacks.startup_phase("Audio: worklet thread started");
 
       WebAudioWorkletProcessorCreateOptions worklet_create_options{
         .name{parent.worklet_name.c_str()},
@@ -78,6 +90,7 @@ emscripten_audio::emscripten_audio(construction_options &&options)
             std::cerr << "ERROR: Emscripten Audio: Worklet processor creation failed for context " << audio_context << std::endl;
             return;
           }
+          if(parent.callbacks.startup_phase) parent.callbacks.startup_phase("Audio: worklet processor created");
 
           std::vector<int> output_channels_int;
           output_channels_int.reserve(parent.output_channels.size());
@@ -91,7 +104,7 @@ emscripten_audio::emscripten_audio(construction_options &&options)
             .numberOfOutputs{static_cast<int>(output_channels_int.size())},
             .outputChannelCounts{output_channels_int.data()},
           };
-          EMSCRIPTEN_AUDIO_WORKLET_NODE_T audio_worklet{emscripten_create_wasm_audio_worklet_node( // create node
+          parent.worklet_node = emscripten_create_wasm_audio_worklet_node(      // create node
             audio_context,
             parent.worklet_name.c_str(),                                        // must match the name set in WebAudioWorkletProcessorCreateOptions
             &worklet_node_create_options,
@@ -102,6 +115,7 @@ emscripten_audio::emscripten_audio(construction_options &&options)
               /// Audio processing callback dispatcher
               auto &parent{*static_cast<emscripten_audio*>(user_data)};
               if(parent.callbacks.processing) {
+                audio::denormal::scoped_flush const denormal_mode{parent.flush_denormals}; // decaying tails would otherwise hit slow subnormal arithmetic
                 parent.callbacks.processing(
                   {inputs,  static_cast<size_t>(num_inputs )},
                   {outputs, static_cast<size_t>(num_outputs)},
@@ -115,16 +129,10 @@ emscripten_audio::emscripten_audio(construction_options &&options)
               return true;                                                      // keep the graph output going
             },
             &parent
-          )};
-
-          emscripten_audio_node_connect(audio_worklet, audio_context, 0, 0);    // connect the node to an audio destination.  EMSCRIPTEN_WEBAUDIO_T source, EMSCRIPTEN_WEBAUDIO_T destination, int outputIndex, int inputIndex
+          );
 
-          // register a once-only click handler to unpause audio, on the first click on the canvas
-          EM_ASM({
-            window.addEventListener("click", (event) => {
-              Module["ccall"]('audio_worklet_unpause_return', null, ['number'], [$0]);
-            }, {once : true});
-          }, &parent);
+          emscripten_audio_node_connect(parent.worklet_node, audio_context, 0, 0); // connect the node to an audio destination.  EMSCRIPTEN_WEBAUDIO_T source, EMSCRIPTEN_WEBAUDIO_T destination, int outputIndex, int inputIndex
+          if(parent.callbacks.startup_phase) parent.callbacks.startup_phase("Audio: worklet node connected");
         },
         &parent
       );
@@ -145,6 +153,36 @@ unsigned int emscripten_audio::get_sample_rate() const {
   return sample_rate;
 }
 
+bool emscripten_audio::connect_microphone() {
+  /// Ask for microphone access, and feed it to the worklet node's first input once granted
+  /// Returns whether the request was made; its outcome arrives later through callbacks.microphone_connected
+  /// The browser's voice processing is turned off, as it distorts musical signals
+  if(inputs == 0) {
+    std::cerr << "ERROR: Emscripten Audio: Can't connect the microphone, as the worklet was created with no inputs" << std::endl;
+    return false;
+  }
+  if(!worklet_node) {
+    std::cerr << "ERROR: Emscripten Audio: Can't connect the microphone before the worklet node has been created" << std::endl;
+    return false;
+  }
+  EM_ASM({
+    navigator.mediaDevices.getUserMedia({
+      audio: {
+        echoCancellation: false,
+        noiseSuppression: false,
+        autoGainControl: false,
+      },
+    }).then((stream) => {
+      EmAudio[$0].createMediaStreamSource(stream).connect(EmAudio[$1]);
+      Module["ccall"]('audio_microphone_return', null, ['number', 'number'], [$2, 1]);
+    }).catch((error) => {
+      console.error("Emscripten Audio: Microphone access failed:", error);
+      Module["ccall"]('audio_microphone_return', null, ['number', 'number'], [$2, 0]);
+    });
+  }, context, worklet_node, this);
+  return true;
+}
+
 void emscripten_audio::audio_worklet_unpause() {
   /// Unpause the audio after the first user click on the canvas
   state = static_cast<states>(emscripten_audio_context_state(context));         // AUDIO_CONTEXT_STATE_SUSPENDED=0, AUDIO_CONTEXT_STATE_RUNNING=1, AUDIO_CONTEXT_STATE_CLOSED=2. AUDIO_CONTEXT_STATE_INTERRUPTED=3
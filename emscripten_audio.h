@@ -4,11 +4,13 @@
 #include <functional>
 #include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <emscripten/webaudio.h>
 
 extern "C" {
 EMSCRIPTEN_KEEPALIVE void audio_worklet_unpause_return(void *callback_data);
+EMSCRIPTEN_KEEPALIVE void audio_microphone_return(void *callback_data, int connected);
 }
 
 class emscripten_audio {
@@ -20,7 +22,9 @@ public:
   };
 
   struct callback_types {
+    std::function<void(std::string_view)> startup_phase{};                      // optional notification as each stage of asynchronous initialisation completes, for startup tracing
     std::function<void()> playback_started{};
+    std::function<void(bool)> microphone_connected{};                           // optional notification once a microphone request completes, with whether access was granted and the input connected
     std::function<void(
       std::span<AudioSampleFrame const>,                                        // inputs
       std::span<AudioSampleFrame>,                                              // outputs
@@ -33,6 +37,7 @@ public:
     std::vector<unsigned int> output_channels{2};                               // number of outputs, and number of channels for each output
     latencies latency_hint{latencies::interactive};                             // hint for requested latency mode
     std::string worklet_name{"emscripten-audio-worklet"};
+    bool flush_denormals{true};                                                 // run the processing callback with subnormal floats flushed to zero where the platform allows
     callback_types callbacks{};                                                 // action and data processing callbacks
   };
 
@@ -49,6 +54,7 @@ private:
   };
 
   EMSCRIPTEN_WEBAUDIO_T context{};
+  EMSCRIPTEN_AUDIO_WORKLET_NODE_T worklet_node{};                               // set once the node has been created
   std::string worklet_name{construction_options{}.worklet_name};
   latencies latency_hint{construction_options{}.latency_hint};
   unsigned int sample_rate{0};
@@ -56,6 +62,7 @@ private:
 public:
   unsigned int const inputs{0};                                                 // number of inputs
   std::vector<unsigned int> const output_channels{2};                           // number of outputs, and channels for each output
+  bool const flush_denormals{true};
 
   callback_types callbacks;
 
@@ -65,7 +72,10 @@ public:
   states get_state() const;
   unsigned int get_sample_rate() const;
 
+  bool connect_microphone();
+
 private:
   void audio_worklet_unpause();
   friend void audio_worklet_unpause_return(void *callback_data);
+  friend void audio_microphone_return(void *callback_data, int connected);
 };
@@ -1,9 +1,25 @@
 #include "gui_renderer.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <utility>
 #include <emscripten/html5.h>
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_emscripten.h>
 #include <imgui/imgui_impl_wgpu.h>
 #include "logstorm/logstorm.h"
+#include "audio/capture.h"
+#include "audio/delay_effects.h"
+#include "audio/fm_synth.h"
+#include "audio/meter.h"
+#include "audio/pitch_detector.h"
+#include "audio/sample_data.h"
+#include "audio/saturation.h"
+#include "audio/time_stretch.h"
+#include "audio/voice_manager.h"
+#include "render/frame_invalidation.h"
+#include "render/gpu_profiler.h"
 
 namespace gui {
 
@@ -25,11 +41,14 @@ void gui_renderer::init(ImGui_ImplWGPU_InitInfo &imgui_wgpu_info) {
   /// Any additional initialisation that needs to occur after WebGPU has been initialised
   ImGui_ImplWGPU_Init(&imgui_wgpu_info);
   ImGui_ImplEmscripten_Init();
+  ImGui_ImplEmscripten_SetInputCallback([this]{
+    input_received = true;
+  });
 
   clipboard.set_imgui_callbacks();
 }
 
-void gui_renderer::draw(bool started, float sample_rate, float &target_tone_frequency, float &target_volume, float phase, float phase_increment, float current_volume) const {
+void gui_renderer::draw(draw_context context) const {
   /// Render the top level GUI
   ImGui_ImplWGPU_NewFrame();
   ImGui_ImplEmscripten_NewFrame();
@@ -39,26 +58,302 @@ void gui_renderer::draw(bool started, float sample_rate, float &target_tone_freq
     ImGui::End();
     return;
   }
-  ImGui::SetWindowSize({550, 180});
+  ImGui::SetWindowSize({550, 700});
 
-  if(started) {
+  if(context.started) {
     ImGui::BeginDisabled();
-    ImGui::InputFloat("Sample rate", &sample_rate, 0.0f, 0.0f, "%.0f", ImGuiInputTextFlags_ReadOnly);
+    ImGui::InputFloat("Sample rate", &context.sample_rate, 0.0f, 0.0f, "%.0f", ImGuiInputTextFlags_ReadOnly);
     ImGui::EndDisabled();
-    ImGui::DragFloat("Target tone frequency", &target_tone_frequency, 2.0f, 0.0f, 96'000.0f, "%.0f");
-    ImGui::SliderFloat("Target volume", &target_volume, 0.0f, 1.0f);
+    ImGui::DragFloat("Target tone frequency", &context.target_tone_frequency, 2.0f, 0.0f, 96'000.0f, "%.0f");
+    ImGui::SliderFloat("Target volume", &context.target_volume, 0.0f, 1.0f);
     ImGui::BeginDisabled();
-    ImGui::SliderFloat("Current volume", &current_volume, 0.0f, 1.0f);
-    ImGui::InputFloat("Phase", &phase, 0.0f, 0.0f, "%.3f", ImGuiInputTextFlags_ReadOnly);
-    ImGui::InputFloat("Phase increment", &phase_increment, 0.0f, 0.0f, "%.3f", ImGuiInputTextFlags_ReadOnly);
+    ImGui::SliderFloat("Current volume", &context.current_volume, 0.0f, 1.0f);
+    ImGui::InputFloat("Phase", &context.phase, 0.0f, 0.0f, "%.3f", ImGuiInputTextFlags_ReadOnly);
+    ImGui::InputFloat("Phase increment", &context.phase_increment, 0.0f, 0.0f, "%.3f", ImGuiInputTextFlags_ReadOnly);
     ImGui::EndDisabled();
+
+    ImGui::SeparatorText("Master meter");
+    {
+      float constexpr floor_decibels{-60.0f};                                   // bottom of the meter bars
+      auto const reading{context.master_meter.collect()};
+      for(unsigned int channel{0}; channel != reading.channels.size(); ++channel) {
+        auto const &levels{reading.channels[channel]};
+        float const peak_decibels{audio::meter::to_decibels(levels.peak)};
+        std::array<char, 64> overlay{};
+        std::snprintf(overlay.data(), overlay.size(), "%.1f dBFS", static_cast<double>(peak_decibels));
+        ImGui::ProgressBar(std::clamp(1.0f - peak_decibels / floor_decibels, 0.0f, 1.0f), {-1.0f, 0.0f}, overlay.data());
+        ImGui::Text("Channel %u: true peak %.1f dBTP, RMS %.1f dBFS",
+          channel,
+          static_cast<double>(audio::meter::to_decibels(levels.true_peak)),
+          static_cast<double>(audio::meter::to_decibels(levels.rms))
+        );
+      }
+      ImGui::Text("Momentary %.1f LUFS, short-term %.1f LUFS", static_cast<double>(reading.momentary), static_cast<double>(reading.short_term));
+      ImGui::Text("Maximum: momentary %.1f LUFS, short-term %.1f LUFS, true peak %.1f dBTP",
+        static_cast<double>(reading.max_momentary),
+        static_cast<double>(reading.max_short_term),
+        static_cast<double>(audio::meter::to_decibels(reading.max_true_peak))
+      );
+      if(ImGui::Button("Reset maximums")) context.master_meter.reset_maximums();
+    }
+
+    ImGui::SeparatorText("Pitch tracking");
+    if(context.microphone_requested) {
+      auto const detected{context.input_pitch.get_result()};
+      ImGui::Text("Input pitch %.1f Hz, confidence %.2f", static_cast<double>(detected.frequency), static_cast<double>(detected.confidence));
+      ImGui::Checkbox("Follow input pitch", &context.follow_input_pitch);
+    } else if(ImGui::Button("Enable microphone")) {
+      context.microphone_requested = true;
+    }
+
+    ImGui::SeparatorText("Output capture");
+    switch(context.output_capture.get_state()) {
+    case audio::capture::states::idle:
+      {
+        auto format{static_cast<int>(context.output_capture.get_format())};
+        if(ImGui::Combo("Format", &format, "WAV 16-bit\0WAV 32-bit float\0FLAC 16-bit\0")) {
+          context.output_capture.set_format(static_cast<audio::capture::formats>(format));
+        }
+        if(ImGui::Button("Record")) context.output_capture.start();
+      }
+      break;
+    case audio::capture::states::recording:
+      ImGui::Text("Recording: %.1fs (%zu frames dropped)", static_cast<double>(context.output_capture.get_recorded_seconds()), context.output_capture.get_dropped_frames());
+      if(ImGui::Button("Stop and save")) context.output_capture.stop();
+      break;
+    case audio::capture::states::encoding:
+    case audio::capture::states::ready:
+      ImGui::TextUnformatted("Encoding...");
+      break;
+    }
+
+    ImGui::SeparatorText("Background voices");
+    {
+      unsigned int constexpr min_count{0};
+      unsigned int const max_count{context.voices.get_capacity()};
+      ImGui::SliderScalar("Sources", ImGuiDataType_U32, &context.voice_count, &min_count, &max_count);
+      unsigned int max_real_voices{context.voices.get_max_real_voices()};
+      if(ImGui::SliderScalar("Max real voices", ImGuiDataType_U32, &max_real_voices, &min_count, &max_count)) {
+        context.voices.set_max_real_voices(max_real_voices);
+      }
+      ImGui::Text("Rendered: %u, virtual: %u", context.voices.get_real_voices(), context.voices.get_virtual_voices());
+      auto source{static_cast<int>(context.voice_source)};
+      if(ImGui::Combo("Source", &source, "Sine\0Float sample\0PCM16 sample\0IMA-ADPCM sample\0White noise\0Pink noise\0Brown noise\0")) {
+        context.voice_source = static_cast<unsigned int>(source);
+      }
+      if(context.voice_source != 0 && context.voice_source <= context.samples.size()) {
+        auto const *selected{context.samples[context.voice_source - 1].get()};
+        auto const *reference{context.samples.front().get()};
+        if(selected && reference) {
+          ImGui::Text("Sample memory: %zu KiB (%.1fx smaller than float)",
+            selected->get_memory_bytes() / 1024,
+            static_cast<double>(reference->get_memory_bytes()) / static_cast<double>(selected->get_memory_bytes())
+          );
+        } else {
+          ImGui::TextUnformatted("Sample loading...");
+        }
+      }
+    }
+
+    ImGui::SeparatorText("Time stretch");
+    {
+      ImGui::PushID("time_stretch");
+      bool enabled{context.stretch.is_enabled()};
+      if(ImGui::Checkbox("Play stretched sample", &enabled)) context.stretch.set_enabled(enabled);
+      if(enabled) {
+        auto source{static_cast<int>(std::distance(context.samples.begin(), std::ranges::find(context.samples, context.stretch.get_source())))};
+        if(ImGui::Combo("Source", &source, "Float sample\0PCM16 sample\0IMA-ADPCM sample\0")) {
+          context.stretch.set_source(context.samples[static_cast<size_t>(source)]);
+        }
+        auto params{context.stretch.get_parameters()};
+        auto mode{static_cast<int>(params.mode)};
+        bool changed{false};
+        if(ImGui::Combo("Mode", &mode, "WSOLA (speech)\0Phase vocoder (music)\0")) {
+          params.mode = static_cast<audio::time_stretch::modes>(mode);
+          changed = true;
+        }
+        changed |= ImGui::SliderFloat("Speed", &params.speed, audio::time_stretch::min_speed, audio::time_stretch::max_speed, "%.2fx", ImGuiSliderFlags_Logarithmic);
+        changed |= ImGui::SliderFloat("Pitch", &params.pitch, -audio::time_stretch::max_pitch, audio::time_stretch::max_pitch, "%+.1f semitones");
+        changed |= ImGui::SliderFloat("Gain", &params.gain, 0.0f, 1.0f);
+        if(changed) context.stretch.set_parameters(params);
+      }
+      ImGui::PopID();
+    }
+
+    ImGui::SeparatorText("FM synth");
+    {
+      ImGui::PushID("fm_synth");
+      std::array<float, 4> constexpr chord{220.0f, 277.18f, 329.63f, 415.30f};  // A major seventh
+      ImGui::Button("Hold to play chord");
+      bool const pressed{ImGui::IsItemActivated()};
+      bool const released{ImGui::IsItemDeactivated()};
+      for(unsigned int voice{0}; voice != std::min(static_cast<unsigned int>(chord.size()), context.synth.get_voice_count()); ++voice) {
+        if(pressed)  context.synth.note_on(voice, chord[voice]);
+        if(released) context.synth.note_off(voice);
+      }
+      ImGui::SameLine();
+      ImGui::Text("Sounding voices: %u", context.synth.get_sounding_voices());
+      auto params{context.synth.get_parameters()};
+      auto algorithm{static_cast<int>(params.algorithm)};
+      bool changed{false};
+      if(ImGui::Combo("Algorithm", &algorithm, "4>3>2>1\0(3+4)>2>1\0""3>2>1, 4>1\0""4>3>1, 2>1\0""2>1, 4>3\0""4>1, 4>2, 4>3\0""4>3, 2, 1\0""4, 3, 2, 1\0")) {
+        params.algorithm = static_cast<audio::fm_synth::algorithms>(algorithm);
+        changed = true;
+      }
+      changed |= ImGui::SliderFloat("Feedback", &params.feedback, 0.0f, 4.0f, "%.2f rad");
+      changed |= ImGui::SliderFloat("Gain", &params.gain, 0.0f, 0.5f);
+      for(unsigned int index{0}; index != audio::fm_synth::operator_count; ++index) {
+        auto &op{params.operators[index]};
+        ImGui::PushID(static_cast<int>(index));
+        if(ImGui::TreeNode("Operator", "Operator %u", index + 1)) {
+          changed |= ImGui::SliderFloat("Ratio", &op.ratio, 0.5f, 16.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+          changed |= ImGui::SliderFloat("Level", &op.level, 0.0f, 8.0f);
+          changed |= ImGui::SliderFloat("Attack", &op.envelope.attack, 0.0f, 2.0f, "%.3fs");
+          changed |= ImGui::SliderFloat("Decay", &op.envelope.decay, 0.0f, 4.0f, "%.3fs");
+          changed |= ImGui::SliderFloat("Sustain", &op.envelope.sustain, 0.0f, 1.0f);
+          changed |= ImGui::SliderFloat("Release", &op.envelope.release, 0.0f, 4.0f, "%.3fs");
+          ImGui::TreePop();
+        }
+        ImGui::PopID();
+      }
+      if(changed) context.synth.set_parameters(params);
+      ImGui::PopID();
+    }
+
+    ImGui::SeparatorText("Saturation");
+    {
+      ImGui::PushID("saturation");
+      bool enabled{context.saturation.is_enabled()};
+      if(ImGui::Checkbox("Saturate mix", &enabled)) context.saturation.set_enabled(enabled);
+      if(enabled) {
+        auto params{context.saturation.get_parameters()};
+        auto shape{static_cast<int>(params.shape)};
+        auto oversampling_index{std::countr_zero(params.oversampling)};
+        bool changed{false};
+        if(ImGui::Combo("Shape", &shape, "Soft\0Hard clip\0")) {
+          params.shape = static_cast<audio::effects::saturation::shapes>(shape);
+          changed = true;
+        }
+        if(ImGui::Combo("Oversampling", &oversampling_index, "Off\0""2x\0""4x\0""8x\0")) {
+          params.oversampling = 1u << oversampling_index;
+          changed = true;
+        }
+        changed |= ImGui::SliderFloat("Drive", &params.drive, 0.0f, 36.0f, "%.1f dB");
+        changed |= ImGui::SliderFloat("Output", &params.output, -24.0f, 0.0f, "%.1f dB");
+        if(changed) context.saturation.set_parameters(params);
+      }
+      ImGui::PopID();
+    }
+
+    ImGui::SeparatorText("Delay effects");
+    {
+      char const *interpolation_names{"Linear\0Allpass\0Cubic\0"};
+      auto const effect_toggle{[](char const *label, auto &effect){
+        bool enabled{effect.is_enabled()};
+        if(ImGui::Checkbox(label, &enabled)) effect.set_enabled(enabled);
+        return enabled;
+      }};
+
+      ImGui::PushID("echo");
+      if(effect_toggle("Echo", context.effects.echo_effect)) {
+        auto params{context.effects.echo_effect.get_parameters()};
+        bool changed{false};
+        changed |= ImGui::SliderFloat("Time", &params.time, 0.0f, audio::effects::echo::max_time, "%.3fs");
+        changed |= ImGui::SliderFloat("Feedback", &params.feedback, 0.0f, 0.95f);
+        changed |= ImGui::SliderFloat("Mix", &params.mix, 0.0f, 1.0f);
+        if(changed) context.effects.echo_effect.set_parameters(params);
+      }
+      ImGui::PopID();
+
+      ImGui::PushID("chorus");
+      if(effect_toggle("Chorus", context.effects.chorus_effect)) {
+        auto params{context.effects.chorus_effect.get_parameters()};
+        auto interpolation{static_cast<int>(params.interpolation)};
+        bool changed{false};
+        changed |= ImGui::SliderFloat("Rate", &params.rate, 0.05f, 5.0f, "%.2fHz");
+        changed |= ImGui::SliderFloat("Depth", &params.depth, 0.0f, 0.01f, "%.4fs");
+        changed |= ImGui::SliderFloat("Mix", &params.mix, 0.0f, 1.0f);
+        if(ImGui::Combo("Interpolation", &interpolation, interpolation_names)) {
+          params.interpolation = static_cast<audio::interpolations>(interpolation);
+          changed = true;
+        }
+        if(changed) context.effects.chorus_effect.set_parameters(params);
+      }
+      ImGui::PopID();
+
+      ImGui::PushID("flanger");
+      if(effect_toggle("Flanger", context.effects.flanger_effect)) {
+        auto params{context.effects.flanger_effect.get_parameters()};
+        auto interpolation{static_cast<int>(params.interpolation)};
+        bool changed{false};
+        changed |= ImGui::SliderFloat("Rate", &params.rate, 0.05f, 2.0f, "%.2fHz");
+        changed |= ImGui::SliderFloat("Feedback", &params.feedback, -0.95f, 0.95f);
+        changed |= ImGui::SliderFloat("Mix", &params.mix, 0.0f, 1.0f);
+        if(ImGui::Combo("Interpolation", &interpolation, interpolation_names)) {
+          params.interpolation = static_cast<audio::interpolations>(interpolation);
+          changed = true;
+        }
+        if(changed) context.effects.flanger_effect.set_parameters(params);
+      }
+      ImGui::PopID();
+
+      ImGui::PushID("multi_tap");
+      if(effect_toggle("Multi-tap delay", context.effects.multi_tap_effect)) {
+        auto params{context.effects.multi_tap_effect.get_parameters()};
+        if(ImGui::SliderFloat("Mix", &params.mix, 0.0f, 1.0f)) context.effects.multi_tap_effect.set_parameters(params);
+      }
+      ImGui::PopID();
+    }
   } else {
     ImGui::TextUnformatted("Autoplay disabled - click on the window to start sound generator.");
   }
 
+  ImGui::SeparatorText("Render profiler");
+  {
+    bool enabled{context.profiler.is_enabled()};
+    if(ImGui::Checkbox("Profile render passes", &enabled)) context.profiler.set_enabled(enabled);
+    if(enabled) {
+      auto const &timings{context.profiler.get_timings()};
+      std::array<char const*, render::gpu_profiler::pass_count> constexpr pass_names{"Scene", "GUI"};
+      for(unsigned int pass{0}; pass != render::gpu_profiler::pass_count; ++pass) {
+        if(timings.gpu_available) {
+          ImGui::Text("%-6s GPU %6.3fms, CPU encode %6.3fms", pass_names[pass], static_cast<double>(timings.gpu[pass]), static_cast<double>(timings.cpu[pass]));
+        } else {
+          ImGui::Text("%-6s CPU encode %6.3fms", pass_names[pass], static_cast<double>(timings.cpu[pass]));
+        }
+      }
+      if(!timings.gpu_available) ImGui::TextUnformatted("Timestamp queries unavailable, GPU times not measured.");
+    }
+  }
+
+  ImGui::SeparatorText("On-demand rendering");
+  {
+    bool on_demand{context.invalidation.is_on_demand()};
+    if(ImGui::Checkbox("Only draw frames when something changes", &on_demand)) context.invalidation.set_on_demand(on_demand);
+    ImGui::Checkbox("Animate scene", &context.animate_scene);
+    auto const &statistics{context.invalidation.get_statistics()};
+    uint64_t const frames{statistics.frames_drawn + statistics.frames_skipped};
+    ImGui::Text("Frames drawn %llu, skipped %llu (%.1f%%)",
+      static_cast<unsigned long long>(statistics.frames_drawn),
+      static_cast<unsigned long long>(statistics.frames_skipped),
+      frames == 0 ? 0.0 : 100.0 * static_cast<double>(statistics.frames_skipped) / static_cast<double>(frames)
+    );
+    for(unsigned int reason{0}; reason != render::frame_invalidation::reason_count; ++reason) {
+      ImGui::Text("  drawn for %-9s %llu",
+        render::frame_invalidation::get_name(static_cast<render::frame_invalidation::reasons>(reason)),
+        static_cast<unsigned long long>(statistics.frames_by_reason[reason])
+      );
+    }
+  }
+
   ImGui::End();
 
   ImGui::Render();                                                              // finalise draw data (actual rendering of draw data is done by the renderer later)
 }
 
+bool gui_renderer::needs_redraw() {
+  /// Whether the GUI has received input since the last check, or a widget is being interacted with, so the next frame would look different
+  return std::exchange(input_received, false) || ImGui::IsAnyItemActive();
+}
+
 }
@@ -1,9 +1,28 @@
 #pragma once
+#include <span>
 #include "logstorm/logstorm_forward.h"
+#include "audio/sample_cache.h"
 #include "clipboard.h"
 
 class ImGui_ImplWGPU_InitInfo;
 
+namespace audio {
+class capture;
+class fm_synth;
+class meter;
+class pitch_detector;
+class time_stretch;
+class voice_manager;
+}
+namespace audio::effects {
+struct chain;
+class saturation;
+}
+namespace render {
+class frame_invalidation;
+class gpu_profiler;
+}
+
 namespace gui {
 
 class gui_renderer {
@@ -11,12 +30,48 @@ class gui_renderer {
 
   clipboard clipboard;
 
+  bool input_received{false};                                                   // set by the input backend whenever an event arrives, cleared when checked
+
 public:
   gui_renderer(logstorm::manager &logger);
 
   void init(ImGui_ImplWGPU_InitInfo &wgpu_info);
 
-  void draw(bool started, float sample_rate, float &target_tone_frequency, float &target_volume, float phase, float phase_increment, float current_volume) const;
+  struct draw_context {
+    /// Everything the GUI shows and edits in a frame, in the order of its sections - values are display copies, references are edited in place
+    // tone generator
+    bool started;
+    float sample_rate;
+    float &target_tone_frequency;
+    float &target_volume;
+    float phase;
+    float phase_increment;
+    float current_volume;
+    // metering, pitch tracking and capture
+    audio::meter &master_meter;
+    audio::pitch_detector const &input_pitch;
+    bool &microphone_requested;
+    bool &follow_input_pitch;
+    audio::capture &output_capture;
+    // voices and samples
+    audio::voice_manager &voices;
+    unsigned int &voice_count;
+    unsigned int &voice_source;
+    std::span<audio::sample_cache::handle const> samples;
+    audio::time_stretch &stretch;
+    // synth and effects
+    audio::fm_synth &synth;
+    audio::effects::saturation &saturation;
+    audio::effects::chain &effects;
+    // rendering
+    render::gpu_profiler &profiler;
+    render::frame_invalidation &invalidation;
+    bool &animate_scene;
+  };
+
+  void draw(draw_context context) const;
+
+  bool needs_redraw();
 };
 
 }
@@ -11,6 +11,8 @@
 #include <emscripten.h>
 #include <emscripten/html5.h>
 #include <emscripten/val.h>
+#include <functional>
+#include <utility>
 
 namespace {
 
@@ -353,6 +355,13 @@ void update_cursor() {
   }
 }
 
+std::function<void()> input_callback;                                           // optional user callback for any input reaching imgui
+
+void notify_input() {
+  /// Call the user's input callback, if any
+  if(input_callback) input_callback();
+}
+
 } // anonymous namespace
 
 void ImGui_ImplEmscripten_Init() {
@@ -370,6 +379,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenMouseEvent const *mouse_event, void */*data*/){ // callback, event_type == EMSCRIPTEN_EVENT_MOUSEMOVE
+      notify_input();
       ImGui::GetIO().AddMousePosEvent(
         static_cast<float>(mouse_event->clientX),
         static_cast<float>(mouse_event->clientY)
@@ -382,6 +392,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenMouseEvent const *mouse_event, void */*data*/){ // callback, event_type == EMSCRIPTEN_EVENT_MOUSEDOWN
+      notify_input();
       ImGui::GetIO().AddMouseButtonEvent(translate_mousebutton(mouse_event->button), true); // translated button, down
       return true;                                                              // the event was consumed
     }
@@ -391,6 +402,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenMouseEvent const *mouse_event, void */*data*/){ // callback, event_type == EMSCRIPTEN_EVENT_MOUSEUP
+      notify_input();
       ImGui::GetIO().AddMouseButtonEvent(translate_mousebutton(mouse_event->button), false); // translated button, up
       return true;                                                              // the event was consumed
     }
@@ -400,6 +412,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenMouseEvent const *mouse_event, void */*data*/){ // callback, event_type == EMSCRIPTEN_EVENT_MOUSEENTER
+      notify_input();
       ImGui::GetIO().AddMousePosEvent(
         static_cast<float>(mouse_event->clientX),
         static_cast<float>(mouse_event->clientY)
@@ -412,6 +425,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenMouseEvent const */*mouse_event*/, void */*data*/){ // callback, event_type == EMSCRIPTEN_EVENT_MOUSELEAVE
+      notify_input();
       auto &imgui_io{ImGui::GetIO()};
       imgui_io.AddMousePosEvent(-FLT_MAX, -FLT_MAX);                            // cursor is not in the window
       imgui_io.ClearInputKeys();                                                // clear pending input keys on mouse exit
@@ -423,6 +437,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenWheelEvent const *wheel_event, void */*data*/){ // callback, event_type == EMSCRIPTEN_EVENT_WHEEL
+      notify_input();
       float scale{1.0f};
       switch(wheel_event->deltaMode) {
       case DOM_DELTA_PIXEL:                                                     // scrolling in pixels
@@ -448,6 +463,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenKeyboardEvent const *key_event, void */*data*/){ // callback, event_type == EMSCRIPTEN_EVENT_KEYDOWN
+      notify_input();
       auto const key{translate_key(key_event->code)};
       auto &imgui_io{ImGui::GetIO()};
       imgui_io.AddKeyEvent(key, true);
@@ -485,6 +501,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenKeyboardEvent const *key_event, void */*data*/){ // callback, event_type == EMSCRIPTEN_EVENT_KEYUP
+      notify_input();
       auto const key{translate_key(key_event->code)};
       auto &imgui_io{ImGui::GetIO()};
       imgui_io.AddKeyEvent(key, false);
@@ -516,6 +533,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenKeyboardEvent const *key_event, void */*data*/){ // callback, event_type == EMSCRIPTEN_EVENT_KEYPRESS
+      notify_input();
       auto &imgui_io{ImGui::GetIO()};
       imgui_io.AddInputCharactersUTF8(key_event->key);
       return imgui_io.WantCaptureKeyboard;                                      // the event was consumed only if imgui wants to capture the keyboard
@@ -526,6 +544,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenUiEvent const *event, void */*data*/) {    // event_type == EMSCRIPTEN_EVENT_RESIZE
+      notify_input();
       auto &imgui_io{ImGui::GetIO()};
       imgui_io.DisplaySize.x = static_cast<float>(event->windowInnerWidth);
       imgui_io.DisplaySize.y = static_cast<float>(event->windowInnerHeight);
@@ -537,6 +556,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenFocusEvent const */*event*/, void */*data*/) { // event_type == EMSCRIPTEN_EVENT_BLUR
+      notify_input();
       auto &imgui_io{ImGui::GetIO()};
       imgui_io.AddFocusEvent(false);
       imgui_io.ClearInputKeys();                                                // clear pending input keys on focus gain
@@ -548,6 +568,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenFocusEvent const */*event*/, void */*data*/) { // event_type == EMSCRIPTEN_EVENT_FOCUS
+      notify_input();
       auto &imgui_io{ImGui::GetIO()};
       imgui_io.AddFocusEvent(true);
       imgui_io.ClearInputKeys();                                                // clear pending input keys on focus loss - for example if you press tab to cycle to another part of the UI
@@ -559,6 +580,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenFocusEvent const */*event*/, void */*data*/) { // event_type == EMSCRIPTEN_EVENT_FOCUSIN
+      notify_input();
       auto &imgui_io{ImGui::GetIO()};
       imgui_io.AddFocusEvent(true);
       imgui_io.ClearInputKeys();                                                // clear pending input keys on focus gain
@@ -570,6 +592,7 @@ void ImGui_ImplEmscripten_Init() {
     nullptr,                                                                    // userData
     false,                                                                      // useCapture
     [](int /*event_type*/, EmscriptenFocusEvent const */*event*/, void */*data*/) { // event_type == EMSCRIPTEN_EVENT_FOCUSOUT
+      notify_input();
       auto &imgui_io{ImGui::GetIO()};
       imgui_io.AddFocusEvent(false);
       imgui_io.ClearInputKeys();                                                // clear pending input keys on focus loss - for example if you press tab to cycle to another part of the UI
@@ -602,6 +625,11 @@ void ImGui_ImplEmscripten_Shutdown() {
   imgui_io.BackendFlags &= ~ImGuiBackendFlags_HasMouseCursors;
 }
 
+void ImGui_ImplEmscripten_SetInputCallback(std::function<void()> callback) {
+  /// Set a function to call whenever an input event is passed to imgui
+  input_callback = std::move(callback);
+}
+
 void ImGui_ImplEmscripten_NewFrame() {
   /// Update any state that needs to be polled
   update_cursor();
@@ -39,6 +39,8 @@
   #error The imgui_impl_emscripten backend reqiuires Emscripten.
 #endif
 
+#include <functional>
+
 /// Initialise the Emscripten backend, setting input callbacks.  This should be called after ImGui::CreateContext();
 void ImGui_ImplEmscripten_Init();
 
@@ -47,6 +49,10 @@ void ImGui_ImplEmscripten_Init();
 /// Note also there is no obligation to ever call this, as there is not necessarily any such concept as "shutting down" when running in the browser, and we have no resources to release.  The user can just close the tab.
 void ImGui_ImplEmscripten_Shutdown();
 
+/// Set a function to call whenever an input event is passed to imgui, for example to draw the next frame only when something has happened.  Pass an empty function to clear it.
+/// This is called from within the Emscripten input callbacks, so should do as little as possible.
+void ImGui_ImplEmscripten_SetInputCallback(std::function<void()> callback);
+
 /// Call every frame to update polled input events, i.e. gamepads, and update imgui's cursors.
 /// If you aren't using gamepad input to control imgui, and you're not using browser native cursor rendering (i.e. if imgui is rendering cursors internally), you don't need to call this.
 void ImGui_ImplEmscripten_NewFrame();
@@ -19,6 +19,8 @@
 
 // CHANGELOG
 // (minor and older changes stripped away, please see git history for details)
+//  (local)     Add a second pipeline without depth-stencil state when DepthStencilFormat is set, so ImGui_ImplWGPU_RenderDrawData() can also draw into passes without a depth attachment.
+//  (local)     Write each draw list straight into the GPU buffers at its offset instead of through host staging arrays, grow buffers geometrically, and skip uploading unchanged draw data (ImGui_ImplWGPU_InitInfo::SkipUnchangedUploads).
 //  2024-10-14: Update Dawn support for change of string usages. (#8082, #8083)
 //  2024-10-07: Expose selected render state in ImGui_ImplWGPU_RenderState, which you can access in 'void* platform_io.Renderer_RenderState' during draw callbacks.
 //  2024-10-07: Changed default texture sampler to Clamp instead of Repeat/Wrap.
@@ -81,8 +83,6 @@ struct FrameResources
 {
     WGPUBuffer  IndexBuffer;
     WGPUBuffer  VertexBuffer;
-    ImDrawIdx*  IndexBufferHost;
-    ImDrawVert* VertexBufferHost;
     int         IndexBufferSize;
     int         VertexBufferSize;
 };
@@ -101,11 +101,15 @@ struct ImGui_ImplWGPU_Data
     WGPUTextureFormat       renderTargetFormat = WGPUTextureFormat_Undefined;
     WGPUTextureFormat       depthStencilFormat = WGPUTextureFormat_Undefined;
     WGPURenderPipeline      pipelineState = nullptr;
+    WGPURenderPipeline      pipelineStateNoDepth = nullptr; // For passes without a depth-stencil attachment, only created when depthStencilFormat is set
+    WGPURenderPipeline      currentPipelineState = nullptr; // Whichever of the above the current ImGui_ImplWGPU_RenderDrawData() call draws with
 
     RenderResources         renderResources;
     FrameResources*         pFrameResources = nullptr;
     unsigned int            numFramesInFlight = 0;
     unsigned int            frameIndex = UINT_MAX;
+    ImU64                   uploadedHash = 0;           // Hash of the draw data in the current frame resources' buffers
+    bool                    uploadedHashValid = false;
 };
 
 // Backend data stored in io.BackendRendererUserData to allow support for multiple Dear ImGui contexts
@@ -173,18 +177,6 @@ fn main(in: VertexOutput) -> @location(0) vec4<f32> {
 }
 )";
 
-static void SafeRelease(ImDrawIdx*& res)
-{
-    if (res)
-        delete[] res;
-    res = nullptr;
-}
-static void SafeRelease(ImDrawVert*& res)
-{
-    if (res)
-        delete[] res;
-    res = nullptr;
-}
 static void SafeRelease(WGPUBindGroupLayout& res)
 {
     if (res)
@@ -255,8 +247,6 @@ static void SafeRelease(FrameResources& res)
 {
     SafeRelease(res.IndexBuffer);
     SafeRelease(res.VertexBuffer);
-    SafeRelease(res.IndexBufferHost);
-    SafeRelease(res.VertexBufferHost);
 }
 
 static WGPUProgrammableStageDescriptor ImGui_ImplWGPU_CreateShaderModule(const char* wgsl_source)
@@ -356,7 +346,7 @@ static void ImGui_ImplWGPU_SetupRenderState(ImDrawData* draw_data, WGPURenderPas
     // Bind shader and vertex buffers
     wgpuRenderPassEncoderSetVertexBuffer(ctx, 0, fr->VertexBuffer, 0, fr->VertexBufferSize * sizeof(ImDrawVert));
     wgpuRenderPassEncoderSetIndexBuffer(ctx, fr->IndexBuffer, sizeof(ImDrawIdx) == 2 ? WGPUIndexFormat_Uint16 : WGPUIndexFormat_Uint32, 0, fr->IndexBufferSize * sizeof(ImDrawIdx));
-    wgpuRenderPassEncoderSetPipeline(ctx, bd->pipelineState);
+    wgpuRenderPassEncoderSetPipeline(ctx, bd->currentPipelineState);
     wgpuRenderPassEncoderSetBindGroup(ctx, 0, bd->renderResources.CommonBindGroup, 0, nullptr);
 
     // Setup blend factor
@@ -364,9 +354,61 @@ static void ImGui_ImplWGPU_SetupRenderState(ImDrawData* draw_data, WGPURenderPas
     wgpuRenderPassEncoderSetBlendConstant(ctx, &blend_color);
 }
 
+// Index counts are rounded up to a multiple of this, so each draw list's indices start on a 4 byte boundary as buffer writes require
+static const int ImGui_ImplWGPU_IdxAlign = 4 / (int)sizeof(ImDrawIdx);
+
+static int ImGui_ImplWGPU_AlignIdxCount(int idx_count)
+{
+    return MEMALIGN(idx_count, ImGui_ImplWGPU_IdxAlign);
+}
+
+// Double a buffer's size until it holds the required count, so a slowly growing UI doesn't reallocate every few frames
+static int ImGui_ImplWGPU_GrowBufferSize(int size, int required_size)
+{
+    if (size < 1)
+        size = 1;
+    while (size < required_size)
+        size *= 2;
+    return size;
+}
+
+// 64-bit hash of draw data, reading a word at a time: much faster than ImHashData()'s bytewise CRC32 where there is no hardware CRC, as on WebAssembly
+static ImU64 ImGui_ImplWGPU_HashData(const void* data, size_t data_size, ImU64 seed)
+{
+    const ImU64 prime = 0x100000001B3ull;
+    ImU64 hash = seed ^ 0xCBF29CE484222325ull;
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (; data_size >= sizeof(ImU64); data_size -= sizeof(ImU64), bytes += sizeof(ImU64))
+    {
+        ImU64 word;
+        memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; data_size > 0; data_size--, bytes++)
+        hash = (hash ^ *bytes) * prime;
+    return hash;
+}
+
+// Write a draw list's indices at an aligned index offset
+// An odd count of 16-bit indices would leave the write size unaligned, so the last index goes in a separate write padded to 4 bytes
+static void ImGui_ImplWGPU_WriteIndices(WGPUQueue queue, WGPUBuffer buffer, int idx_offset, const ImVector<ImDrawIdx>& indices)
+{
+    int aligned_count = indices.Size & ~(ImGui_ImplWGPU_IdxAlign - 1);
+    if (aligned_count > 0)
+        wgpuQueueWriteBuffer(queue, buffer, idx_offset * sizeof(ImDrawIdx), indices.Data, aligned_count * sizeof(ImDrawIdx));
+    if (aligned_count < indices.Size)
+    {
+        ImDrawIdx tail[ImGui_ImplWGPU_IdxAlign] = {};
+        for (int i = aligned_count; i < indices.Size; i++)
+            tail[i - aligned_count] = indices.Data[i];
+        wgpuQueueWriteBuffer(queue, buffer, (idx_offset + aligned_count) * sizeof(ImDrawIdx), tail, sizeof(tail));
+    }
+}
+
 // Render function
 // (this used to be set in io.RenderDrawListsFn and called by ImGui::Render(), but you can now call this directly from your main loop)
-void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder pass_encoder)
+void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder pass_encoder, bool pass_has_depth_stencil)
 {
     // Avoid rendering when minimized
     int fb_width = (int)(draw_data->DisplaySize.x * draw_data->FramebufferScale.x);
@@ -377,80 +419,101 @@ void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder
     // FIXME: Assuming that this only gets called once per frame!
     // If not, we can't just re-allocate the IB or VB, we'll have to do a proper allocator.
     ImGui_ImplWGPU_Data* bd = ImGui_ImplWGPU_GetBackendData();
-    bd->frameIndex = bd->frameIndex + 1;
+    bd->currentPipelineState = (pass_has_depth_stencil || !bd->pipelineStateNoDepth) ? bd->pipelineState : bd->pipelineStateNoDepth;
+
+    // Size the buffers, and hash the draw data to find whether it has changed since it was last uploaded
+    // (Buffer writes must be 4 byte aligned, so each draw list's indices start on a 4 byte boundary)
+    int total_idx_count = 0;
+    ImU64 draw_data_hash = ImGui_ImplWGPU_HashData(&draw_data->CmdListsCount, sizeof(draw_data->CmdListsCount), 0);
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* draw_list = draw_data->CmdLists[n];
+        total_idx_count += ImGui_ImplWGPU_AlignIdxCount(draw_list->IdxBuffer.Size);
+        if (!bd->initInfo.SkipUnchangedUploads)
+            continue;
+        int sizes[2] = { draw_list->VtxBuffer.Size, draw_list->IdxBuffer.Size };
+        draw_data_hash = ImGui_ImplWGPU_HashData(sizes, sizeof(sizes), draw_data_hash);
+        draw_data_hash = ImGui_ImplWGPU_HashData(draw_list->VtxBuffer.Data, draw_list->VtxBuffer.size_in_bytes(), draw_data_hash);
+        draw_data_hash = ImGui_ImplWGPU_HashData(draw_list->IdxBuffer.Data, draw_list->IdxBuffer.size_in_bytes(), draw_data_hash);
+    }
+
+    // Unchanged draw data is drawn again from the buffers it was last uploaded to
+    // (The GPU only reads them, so they can be used by several frames in flight at once)
+    bool upload = !bd->initInfo.SkipUnchangedUploads || !bd->uploadedHashValid || bd->uploadedHash != draw_data_hash;
+    if (upload)
+        bd->frameIndex = bd->frameIndex + 1;
     FrameResources* fr = &bd->pFrameResources[bd->frameIndex % bd->numFramesInFlight];
 
-    // Create and grow vertex/index buffers if needed
-    if (fr->VertexBuffer == nullptr || fr->VertexBufferSize < draw_data->TotalVtxCount)
+    if (upload)
     {
-        if (fr->VertexBuffer)
-        {
-            wgpuBufferDestroy(fr->VertexBuffer);
-            wgpuBufferRelease(fr->VertexBuffer);
-        }
-        SafeRelease(fr->VertexBufferHost);
-        fr->VertexBufferSize = draw_data->TotalVtxCount + 5000;
+        bd->uploadedHashValid = false;
 
-        WGPUBufferDescriptor vb_desc =
+        // Create and grow vertex/index buffers if needed
+        if (fr->VertexBuffer == nullptr || fr->VertexBufferSize < draw_data->TotalVtxCount)
         {
-            nullptr,
-            "Dear ImGui Vertex buffer",
+            if (fr->VertexBuffer)
+            {
+                wgpuBufferDestroy(fr->VertexBuffer);
+                wgpuBufferRelease(fr->VertexBuffer);
+            }
+            fr->VertexBufferSize = ImGui_ImplWGPU_GrowBufferSize(fr->VertexBufferSize, draw_data->TotalVtxCount);
+
+            WGPUBufferDescriptor vb_desc =
+            {
+                nullptr,
+                "Dear ImGui Vertex buffer",
 #ifdef IMGUI_IMPL_WEBGPU_BACKEND_DAWN
-            WGPU_STRLEN,
+                WGPU_STRLEN,
 #endif
-            WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
-            MEMALIGN(fr->VertexBufferSize * sizeof(ImDrawVert), 4),
-            false
-        };
-        fr->VertexBuffer = wgpuDeviceCreateBuffer(bd->wgpuDevice, &vb_desc);
-        if (!fr->VertexBuffer)
-            return;
-
-        fr->VertexBufferHost = new ImDrawVert[fr->VertexBufferSize];
-    }
-    if (fr->IndexBuffer == nullptr || fr->IndexBufferSize < draw_data->TotalIdxCount)
-    {
-        if (fr->IndexBuffer)
-        {
-            wgpuBufferDestroy(fr->IndexBuffer);
-            wgpuBufferRelease(fr->IndexBuffer);
+                WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
+                MEMALIGN(fr->VertexBufferSize * sizeof(ImDrawVert), 4),
+                false
+            };
+            fr->VertexBuffer = wgpuDeviceCreateBuffer(bd->wgpuDevice, &vb_desc);
+            if (!fr->VertexBuffer)
+                return;
         }
-        SafeRelease(fr->IndexBufferHost);
-        fr->IndexBufferSize = draw_data->TotalIdxCount + 10000;
-
-        WGPUBufferDescriptor ib_desc =
+        if (fr->IndexBuffer == nullptr || fr->IndexBufferSize < total_idx_count)
         {
-            nullptr,
-            "Dear ImGui Index buffer",
+            if (fr->IndexBuffer)
+            {
+                wgpuBufferDestroy(fr->IndexBuffer);
+                wgpuBufferRelease(fr->IndexBuffer);
+            }
+            fr->IndexBufferSize = ImGui_ImplWGPU_GrowBufferSize(fr->IndexBufferSize, total_idx_count);
+
+            WGPUBufferDescriptor ib_desc =
+            {
+                nullptr,
+                "Dear ImGui Index buffer",
 #ifdef IMGUI_IMPL_WEBGPU_BACKEND_DAWN
-            WGPU_STRLEN,
+                WGPU_STRLEN,
 #endif
-            WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
-            MEMALIGN(fr->IndexBufferSize * sizeof(ImDrawIdx), 4),
-            false
-        };
-        fr->IndexBuffer = wgpuDeviceCreateBuffer(bd->wgpuDevice, &ib_desc);
-        if (!fr->IndexBuffer)
-            return;
+                WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
+                MEMALIGN(fr->IndexBufferSize * sizeof(ImDrawIdx), 4),
+                false
+            };
+            fr->IndexBuffer = wgpuDeviceCreateBuffer(bd->wgpuDevice, &ib_desc);
+            if (!fr->IndexBuffer)
+                return;
+        }
 
-        fr->IndexBufferHost = new ImDrawIdx[fr->IndexBufferSize];
-    }
+        // Upload each draw list's vertex/index data straight into the GPU buffers at its offset
+        int vtx_offset = 0;
+        int idx_offset = 0;
+        for (int n = 0; n < draw_data->CmdListsCount; n++)
+        {
+            const ImDrawList* draw_list = draw_data->CmdLists[n];
+            if (draw_list->VtxBuffer.Size > 0)
+                wgpuQueueWriteBuffer(bd->defaultQueue, fr->VertexBuffer, vtx_offset * sizeof(ImDrawVert), draw_list->VtxBuffer.Data, draw_list->VtxBuffer.size_in_bytes()); // ImDrawVert is a multiple of 4 bytes
+            ImGui_ImplWGPU_WriteIndices(bd->defaultQueue, fr->IndexBuffer, idx_offset, draw_list->IdxBuffer);
+            vtx_offset += draw_list->VtxBuffer.Size;
+            idx_offset += ImGui_ImplWGPU_AlignIdxCount(draw_list->IdxBuffer.Size);
+        }
 
-    // Upload vertex/index data into a single contiguous GPU buffer
-    ImDrawVert* vtx_dst = (ImDrawVert*)fr->VertexBufferHost;
-    ImDrawIdx* idx_dst = (ImDrawIdx*)fr->IndexBufferHost;
-    for (int n = 0; n < draw_data->CmdListsCount; n++)
-    {
-        const ImDrawList* draw_list = draw_data->CmdLists[n];
-        memcpy(vtx_dst, draw_list->VtxBuffer.Data, draw_list->VtxBuffer.Size * sizeof(ImDrawVert));
-        memcpy(idx_dst, draw_list->IdxBuffer.Data, draw_list->IdxBuffer.Size * sizeof(ImDrawIdx));
-        vtx_dst += draw_list->VtxBuffer.Size;
-        idx_dst += draw_list->IdxBuffer.Size;
+        bd->uploadedHash = draw_data_hash;
+        bd->uploadedHashValid = bd->initInfo.SkipUnchangedUploads;
     }
-    int64_t vb_write_size = MEMALIGN((char*)vtx_dst - (char*)fr->VertexBufferHost, 4);
-    int64_t ib_write_size = MEMALIGN((char*)idx_dst - (char*)fr->IndexBufferHost, 4);
-    wgpuQueueWriteBuffer(bd->defaultQueue, fr->VertexBuffer, 0, fr->VertexBufferHost, vb_write_size);
-    wgpuQueueWriteBuffer(bd->defaultQueue, fr->IndexBuffer,  0, fr->IndexBufferHost,  ib_write_size);
 
     // Setup desired render state
     ImGui_ImplWGPU_SetupRenderState(draw_data, pass_encoder, fr);
@@ -517,7 +580,7 @@ void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder
                 wgpuRenderPassEncoderDrawIndexed(pass_encoder, pcmd->ElemCount, 1, pcmd->IdxOffset + global_idx_offset, pcmd->VtxOffset + global_vtx_offset, 0);
             }
         }
-        global_idx_offset += draw_list->IdxBuffer.Size;
+        global_idx_offset += ImGui_ImplWGPU_AlignIdxCount(draw_list->IdxBuffer.Size);
         global_vtx_offset += draw_list->VtxBuffer.Size;
     }
     platform_io.Renderer_RenderState = nullptr;
@@ -729,6 +792,11 @@ bool ImGui_ImplWGPU_CreateDeviceObjects()
     graphics_pipeline_desc.depthStencil = (bd->depthStencilFormat == WGPUTextureFormat_Undefined) ? nullptr :  &depth_stencil_state;
 
     bd->pipelineState = wgpuDeviceCreateRenderPipeline(bd->wgpuDevice, &graphics_pipeline_desc);
+    if (bd->depthStencilFormat != WGPUTextureFormat_Undefined)
+    {
+        graphics_pipeline_desc.depthStencil = nullptr;
+        bd->pipelineStateNoDepth = wgpuDeviceCreateRenderPipeline(bd->wgpuDevice, &graphics_pipeline_desc);
+    }
 
     ImGui_ImplWGPU_CreateFontsTexture();
     ImGui_ImplWGPU_CreateUniformBuffer();
@@ -766,6 +834,7 @@ void ImGui_ImplWGPU_InvalidateDeviceObjects()
         return;
 
     SafeRelease(bd->pipelineState);
+    SafeRelease(bd->pipelineStateNoDepth);
     SafeRelease(bd->renderResources);
 
     ImGuiIO& io = ImGui::GetIO();
@@ -773,6 +842,7 @@ void ImGui_ImplWGPU_InvalidateDeviceObjects()
 
     for (unsigned int i = 0; i < bd->numFramesInFlight; i++)
         SafeRelease(bd->pFrameResources[i]);
+    bd->uploadedHashValid = false;
 }
 
 bool ImGui_ImplWGPU_Init(ImGui_ImplWGPU_InitInfo* init_info)
@@ -819,8 +889,6 @@ bool ImGui_ImplWGPU_Init(ImGui_ImplWGPU_InitInfo* init_info)
         FrameResources* fr = &bd->pFrameResources[i];
         fr->IndexBuffer = nullptr;
         fr->VertexBuffer = nullptr;
-        fr->IndexBufferHost = nullptr;
-        fr->VertexBufferHost = nullptr;
         fr->IndexBufferSize = 10000;
         fr->VertexBufferSize = 5000;
     }
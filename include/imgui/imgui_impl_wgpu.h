@@ -38,6 +38,7 @@ struct ImGui_ImplWGPU_InitInfo
     WGPUTextureFormat       RenderTargetFormat = WGPUTextureFormat_Undefined;
     WGPUTextureFormat       DepthStencilFormat = WGPUTextureFormat_Undefined;
     WGPUMultisampleState    PipelineMultisampleState = {};
+    bool                    SkipUnchangedUploads = true;    // Hash each frame's vertex and index data, and draw from the previous frame's buffers without uploading when it is unchanged
 
     ImGui_ImplWGPU_InitInfo()
     {
@@ -51,7 +52,7 @@ struct ImGui_ImplWGPU_InitInfo
 IMGUI_IMPL_API bool ImGui_ImplWGPU_Init(ImGui_ImplWGPU_InitInfo* init_info);
 IMGUI_IMPL_API void ImGui_ImplWGPU_Shutdown();
 IMGUI_IMPL_API void ImGui_ImplWGPU_NewFrame();
-IMGUI_IMPL_API void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder pass_encoder);
+IMGUI_IMPL_API void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder pass_encoder, bool pass_has_depth_stencil = true); // (local) pass false to draw into a pass without the DepthStencilFormat attachment
 
 // Use if you want to reset your rendering device without losing Dear ImGui state.
 IMGUI_IMPL_API bool ImGui_ImplWGPU_CreateDeviceObjects();
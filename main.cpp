@@ -1,8 +1,30 @@
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <imgui/imgui_impl_wgpu.h>
 #include "logstorm/logstorm.h"
+#include "audio/capture.h"
+#include "audio/delay_effects.h"
+#include "audio/denormal.h"
+#include "audio/encoder.h"
+#include "audio/fm_synth.h"
+#include "audio/meter.h"
+#include "audio/mix.h"
+#include "audio/noise.h"
+#include "audio/pitch_detector.h"
+#include "audio/sample_cache.h"
+#include "audio/sample_data.h"
+#include "audio/saturation.h"
+#include "audio/time_stretch.h"
+#include "audio/voice_manager.h"
 #include "gui/gui_renderer.h"
+#include "render/bvh.h"
+#include "render/instance.h"
+#include "render/transforms.h"
 #include "render/webgpu_renderer.h"
+#include "timing/startup_trace.h"
+#include "vectorstorm/matrix/matrix3.h"
 #include "emscripten_audio.h"
 
 class game_manager {
@@ -22,16 +44,59 @@ class game_manager {
   };
 
   logstorm::manager logger{logstorm::manager::build_with_sink<logstorm::sink::emscripten_out>()}; // logging system
+  timing::startup_trace startup{logger};                                        // timeline of asynchronous startup phases, from construction to first frame and first sound
   render::webgpu_renderer renderer{logger};                                     // WebGPU rendering system
   gui::gui_renderer gui{logger};                                                // GUI top level
-  emscripten_audio audio{{
+  emscripten_audio audio{{                                                      // constructing this starts the audio worklet asynchronously, overlapping with WebGPU init
+    .inputs{1},                                                                 // for the microphone, once the user enables it
     .callbacks{
+      .startup_phase{[&](std::string_view name){
+        startup.mark(name);
+      }},
       .playback_started{[&]{
         on_playback_started();
       }},
+      .microphone_connected{[&](bool connected){
+        microphone_connecting = false;
+        microphone_connected = connected;
+        if(!connected) microphone_requested = false;                            // refused, so offer the button again
+      }},
     },
   }};
   audio_generator tone_generator;
+  audio::sample_cache samples{32 * 1024 * 1024};                                // sampled assets, decoded on first use and evicted beyond this many bytes - outlives the voices holding handles to it
+  audio::voice_manager background_voices{256};                                  // many quiet, moving sources, most of which are virtual at any one time
+  unsigned int background_voice_count{0};                                       // number of background sources requested from the GUI
+  unsigned int background_voices_started{0};
+  std::array<audio::sample_cache::handle, 3> background_samples;                // the same plucked sound in each storage format, to compare footprint and decode cost
+  unsigned int background_source{0};                                            // 0 for sine tones, then 1 + index into background_samples, then each noise colour
+  audio::time_stretch stretched_sample;                                         // a sample looped with independent speed and pitch
+  audio::fm_synth fm_voices{8};                                                 // four-operator FM, played from the GUI
+  audio::effects::saturation saturation_effect{audio.output_channels.front()};  // oversampled waveshaping on the mix, before the delays
+  audio::effects::chain delay_effects{audio.output_channels.front()};           // echo, chorus, flanger and multi-tap delay on the final mix
+  audio::meter master_meter{audio.output_channels.front()};                     // levels and loudness of the final mix
+  audio::capture output_capture{audio.output_channels.front()};                 // recorder for what the user hears, exported as WAV or FLAC
+  audio::pitch_detector input_pitch;                                            // pitch of the microphone input
+  bool microphone_requested{false};                                             // set from the GUI, so the permission prompt only appears once the user asks for it
+  bool microphone_connecting{false};                                            // waiting on the browser's permission prompt
+  bool microphone_connected{false};                                             // latched once access is granted and the input is connected
+  bool follow_input_pitch{false};                                               // drive the tone generator from the detected pitch
+
+  render::transforms scene_transforms;                                          // a spinning root with every object as its child
+  render::transforms::handle scene_root{0};
+  std::vector<render::instance> scene_objects;                                  // every object in the scene, rebuilt every frame reusing its allocation
+  std::vector<aabb3f> scene_bounds;                                             // world space bounds of each object
+  render::bvh scene_hierarchy;                                                  // over scene_bounds, refitted every frame and rebuilt when refits have degraded it
+  std::vector<uint32_t> visible_objects;                                        // indices of objects in view this frame
+  std::vector<render::instance> scene_instances;                                // the objects in view, uploaded in one batch
+  unsigned int scene_instance_count{4096};
+  bool animate_scene{true};                                                     // when off, the scene holds still so on-demand rendering can skip frames
+  float scene_time{0.0f};                                                       // seconds the scene has been animating for
+
+  std::chrono::steady_clock::time_point last_frame_time{std::chrono::steady_clock::now()};
+  std::chrono::steady_clock::time_point last_telemetry_time;                    // when the frame was last marked dirty for changing audio readouts
+
+  bool first_frame_drawn{false};
 
 public:
   game_manager();
@@ -44,10 +109,35 @@ private:
   void operator=(game_manager const&) = delete;
 
   void on_playback_started();
+  void update_background_voices();
+  void update_scene();
+  void generate_background_samples();
 };
 
 game_manager::game_manager() {
   /// Run the game
+  using modulation = audio::modulation;
+  auto &patch{background_voices.get_modulation()};                              // slow swells with gentle vibrato and tremolo
+  patch.set_envelope(0, {.attack{0.8f}, .decay{0.5f}, .sustain{0.8f}, .release{1.5f}});
+  patch.set_lfo(0, {.rate{4.5f}, .shape{modulation::lfo_shapes::sine}});
+  patch.set_lfo(1, {.rate{0.3f}, .shape{modulation::lfo_shapes::triangle}});
+  patch.set_route(0, {.source{modulation::sources::envelope}, .slot{0}, .destination{modulation::destinations::gain},  .amount{1.0f}});
+  patch.set_route(1, {.source{modulation::sources::lfo},      .slot{0}, .destination{modulation::destinations::pitch}, .amount{0.15f}});
+  patch.set_route(2, {.source{modulation::sources::lfo},      .slot{1}, .destination{modulation::destinations::gain},  .amount{0.3f}});
+  generate_background_samples();
+  stretched_sample.set_source(background_samples.front());
+  fm_voices.set_parameters({                                                    // electric piano: a bright, fast-decaying tine over a mellow body
+    .algorithm{audio::fm_synth::algorithms::two_stacks},
+    .feedback{0.3f},
+    .gain{0.15f},
+    .operators{{
+      {.ratio{1.0f},  .level{0.5f}, .envelope{.attack{0.002f}, .decay{1.2f},  .sustain{0.3f}, .release{0.4f}}},
+      {.ratio{14.0f}, .level{0.8f}, .envelope{.attack{0.002f}, .decay{0.15f}, .sustain{0.0f}, .release{0.1f}}},
+      {.ratio{1.0f},  .level{0.5f}, .envelope{.attack{0.002f}, .decay{2.0f},  .sustain{0.4f}, .release{0.5f}}},
+      {.ratio{1.0f},  .level{1.5f}, .envelope{.attack{0.002f}, .decay{0.8f},  .sustain{0.2f}, .release{0.4f}}},
+    }},
+  });
+
   renderer.init(
     [&](render::webgpu_renderer::webgpu_data const& webgpu){
       ImGui_ImplWGPU_InitInfo imgui_wgpu_info;
@@ -59,6 +149,9 @@ game_manager::game_manager() {
     },
     [&]{
       loop_main();
+    },
+    [&](std::string_view name){
+      startup.mark(name);
     }
   );
 }
@@ -70,28 +163,209 @@ game_manager::~game_manager() {
 
 void game_manager::loop_main() {
   /// Main pseudo-loop
-  gui.draw(
-    tone_generator.started,
-    tone_generator.sample_rate,
-    tone_generator.target_tone_frequency,
-    tone_generator.target_volume,
-    tone_generator.phase,
-    tone_generator.phase_increment,
-    tone_generator.current_volume
-  );
+  output_capture.poll();                                                        // offer any finished recording for download
+  samples.update();                                                             // account for finished loads and evict unused samples over budget
+  update_background_voices();
+  if(microphone_requested && !microphone_connecting && !microphone_connected) {
+    microphone_connecting = audio.connect_microphone();
+    if(!microphone_connecting) microphone_requested = false;                    // couldn't ask, so offer the button again
+  }
+  if(follow_input_pitch) {
+    float constexpr confidence_threshold{0.8f};                                 // ignore unvoiced and noisy input
+    auto const detected{input_pitch.get_result()};
+    if(detected.confidence > confidence_threshold) tone_generator.target_tone_frequency = detected.frequency;
+  }
+
+  // mark the frame dirty for whatever has changed since the last, and in on-demand mode skip encoding and submitting it if nothing has
+  using reasons = render::frame_invalidation::reasons;
+  unsigned int constexpr input_settle_frames{3};                                // some GUI changes, such as windows resizing to fit, take a few frames to appear after the input that caused them
+  auto constexpr telemetry_interval{std::chrono::milliseconds{100}};            // meters and readouts change continuously while audio runs, so refresh them at a readable rate rather than every frame
+  auto const now{std::chrono::steady_clock::now()};
+  float const frame_seconds{std::chrono::duration<float>(now - last_frame_time).count()};
+  last_frame_time = now;
+  auto &invalidation{renderer.get_invalidation()};
+  if(gui.needs_redraw()) invalidation.invalidate(reasons::input, input_settle_frames);
+  if(animate_scene) {
+    scene_time += frame_seconds;
+    invalidation.invalidate(reasons::animation);
+  }
+  if(tone_generator.started && now - last_telemetry_time >= telemetry_interval) {
+    last_telemetry_time = now;
+    invalidation.invalidate(reasons::audio);
+  }
+  if(!invalidation.begin_frame()) return;
+
+  gui.draw({
+    .started{tone_generator.started},
+    .sample_rate{tone_generator.sample_rate},
+    .target_tone_frequency{tone_generator.target_tone_frequency},
+    .target_volume{tone_generator.target_volume},
+    .phase{tone_generator.phase},
+    .phase_increment{tone_generator.phase_increment},
+    .current_volume{tone_generator.current_volume},
+    .master_meter{master_meter},
+    .input_pitch{input_pitch},
+    .microphone_requested{microphone_requested},
+    .follow_input_pitch{follow_input_pitch},
+    .output_capture{output_capture},
+    .voices{background_voices},
+    .voice_count{background_voice_count},
+    .voice_source{background_source},
+    .samples{background_samples},
+    .stretch{stretched_sample},
+    .synth{fm_voices},
+    .saturation{saturation_effect},
+    .effects{delay_effects},
+    .profiler{renderer.get_profiler()},
+    .invalidation{invalidation},
+    .animate_scene{animate_scene},
+  });
+  update_scene();
   renderer.draw();
+
+  if(!first_frame_drawn) [[unlikely]] {
+    startup.mark("Render: first frame submitted");
+    first_frame_drawn = true;
+  }
 }
 
 void game_manager::on_playback_started() {
   /// Playback started callback
   logger << "Audio: Starting playback after first user interaction";
   tone_generator.set_sample_rate(audio.get_sample_rate());
-  audio.callbacks.processing = [&](std::span<AudioSampleFrame const> /*inputs*/,
+  background_voices.set_sample_rate(audio.get_sample_rate());
+  stretched_sample.set_sample_rate(audio.get_sample_rate());
+  fm_voices.set_sample_rate(audio.get_sample_rate());
+  delay_effects.set_sample_rate(audio.get_sample_rate());
+  master_meter.set_sample_rate(audio.get_sample_rate());
+  output_capture.set_sample_rate(audio.get_sample_rate());
+  input_pitch.set_sample_rate(audio.get_sample_rate());
+  audio.callbacks.processing = [&](std::span<AudioSampleFrame const> inputs,
                                    std::span<AudioSampleFrame> outputs,
                                    std::span<AudioParamFrame const > /*params*/){
+    samples.advance_epoch();                                                    // before any sample is read, so pointers read in earlier quanta are known to be out of use
+    input_pitch.process(inputs);
     tone_generator.output(outputs);
+    background_voices.output(outputs);
+    stretched_sample.output(outputs);
+    fm_voices.output(outputs);
+    saturation_effect.output(outputs);
+    delay_effects.output(outputs);
+    master_meter.process(outputs);
+    output_capture.push(outputs);                                               // tap the final mix
   };
   tone_generator.started = true;
+  startup.mark("Audio: playback started");
+}
+
+void game_manager::update_background_voices() {
+  /// Start or stop background sources to match the requested count, and move them around the listener
+  float const time{std::chrono::duration<float>(std::chrono::steady_clock::now().time_since_epoch()).count()};
+  bool const sampled{background_source != 0 && background_source <= background_samples.size()};
+  bool const noise_source{background_source > background_samples.size()};
+  for(unsigned int i{0}; i != background_voices.get_capacity(); ++i) {
+    if(i >= background_voice_count) {
+      if(i < background_voices_started) background_voices.stop(i);
+      continue;
+    }
+    float const orbit{0.3f + 0.01f * static_cast<float>(i % 17)};               // each source orbits at its own rate, so the audible set keeps changing
+    audio::voice_manager::parameters const params{
+      .frequency{110.0f * std::exp2(static_cast<float>((i * 7) % 36) / 12.0f)}, // spread across three octaves of semitones
+      .gain{0.02f},
+      .distance{1.0f + static_cast<float>(i % 50) * (1.0f + std::sin(time * orbit + static_cast<float>(i)))},
+      .priority{1.0f},
+      .sample{sampled ? background_samples[background_source - 1] : audio::sample_cache::handle{}},
+      .noise_source{noise_source},
+      .noise_colour{noise_source ? static_cast<audio::noise::colours>(background_source - 1 - background_samples.size()) : audio::noise::colours::white},
+    };
+    if(i < background_voices_started) {
+      background_voices.update(i, params);
+    } else {
+      background_voices.start(i, params);
+    }
+  }
+  background_voices_started = background_voice_count;
+}
+
+void game_manager::update_scene() {
+  /// Lay out a spinning spiral of cubes that swell with the tone's volume, and draw those in view with a single instanced draw call
+  float const time{scene_time};
+  float constexpr two_pi{2.0f * boost::math::constants::pi<float>()};
+  float constexpr turns{20.0f};
+  float const swell{1.0f + 8.0f * tone_generator.current_volume};
+  aabb3f const cube_bounds{-1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};              // the mesh's own bounds
+  float constexpr size{0.04f};
+  vec3f const up{0.0f, 1.0f, 0.0f};
+  if(scene_transforms.size() != scene_instance_count + 1) {                     // lay out the spiral once, in the root's space, so spinning it only changes the root
+    scene_transforms.clear();
+    scene_root = scene_transforms.add();
+    for(unsigned int i{0}; i != scene_instance_count; ++i) {
+      float const fraction{static_cast<float>(i) / static_cast<float>(scene_instance_count)};
+      float const angle{fraction * turns * two_pi};
+      float const radius{0.5f + 3.5f * fraction};
+      auto const object{scene_transforms.add(scene_root)};
+      scene_transforms.set_position(object, {std::cos(angle) * radius, 0.0f, std::sin(angle) * radius});
+      scene_transforms.set_rotation(object, quatf::from_axis_rot_rad(up, -angle));
+    }
+  }
+  scene_transforms.set_rotation(scene_root, quatf::from_axis_rot_rad(up, -time * 0.3f));
+  for(unsigned int i{0}; i != scene_instance_count; ++i) {
+    float const fraction{static_cast<float>(i) / static_cast<float>(scene_instance_count)};
+    float const height{size * swell * (1.0f + std::sin(time * 3.0f + fraction * turns * two_pi * 0.25f))};
+    scene_transforms.set_scale(scene_root + 1 + i, {size, height + size, size});
+  }
+  scene_transforms.update();
+
+  scene_objects.resize(scene_instance_count);
+  scene_bounds.resize(scene_instance_count);
+  for(unsigned int i{0}; i != scene_instance_count; ++i) {
+    float const fraction{static_cast<float>(i) / static_cast<float>(scene_instance_count)};
+    float const angle{fraction * turns * two_pi + time * 0.3f};
+    scene_objects[i] = {
+      .model_matrix{scene_transforms.get_world_matrix(scene_root + 1 + i)},
+      .colour{fraction, 1.0f - fraction, 0.5f + 0.5f * std::sin(angle), 1.0f},
+    };
+    scene_bounds[i] = cube_bounds.transformed(scene_objects[i].model_matrix);
+  }
+
+  // cull against the view, refitting the hierarchy to this frame's bounds and rebuilding it only once refits have made it much slower to search
+  float constexpr rebuild_degradation{2.0f};
+  if(scene_hierarchy.get_object_count() == scene_bounds.size()) scene_hierarchy.refit(scene_bounds);
+  if(scene_hierarchy.get_object_count() != scene_bounds.size() || scene_hierarchy.get_degradation() > rebuild_degradation) {
+    scene_hierarchy.build(scene_bounds);
+  }
+  scene_hierarchy.cull(render::frustum{renderer.get_view_projection_matrix()}, visible_objects);
+  scene_instances.clear();
+  for(uint32_t const object : visible_objects) {
+    scene_instances.emplace_back(scene_objects[object]);
+  }
+  renderer.set_instances(scene_instances);
+}
+
+void game_manager::generate_background_samples() {
+  /// Synthesise a plucked string, and load it through the sample cache in each compact sample format
+  using formats = audio::sample_data::formats;
+  unsigned int constexpr sample_rate{48'000};
+  size_t constexpr period{218};                                                 // delay line length for Karplus-Strong synthesis
+  std::vector<float> pluck(sample_rate * 3 / 2);
+  uint32_t noise{0x12'34'56'78u};
+  for(size_t i{0}; i != pluck.size(); ++i) {
+    if(i < period) {                                                            // excite the string with a burst of noise
+      noise ^= noise << 13;
+      noise ^= noise >> 17;
+      noise ^= noise << 5;
+      pluck[i] = static_cast<float>(noise >> 8) * (2.0f / 16'777'216.0f) - 1.0f;
+    } else {                                                                    // averaging the last period is a lowpass in the feedback loop, so the tone decays and mellows
+      pluck[i] = 0.498f * (pluck[i - period] + pluck[i - period + 1]);
+    }
+  }
+  float constexpr root_frequency{static_cast<float>(sample_rate) / (static_cast<float>(period) + 0.5f)}; // the averaging filter adds half a sample of delay
+  auto const file{audio::encoder::wav(pluck, 1, sample_rate, audio::encoder::sample_formats::float32)}; // exact, and encoded to each format on the cache's worker
+  background_samples = {
+    samples.request("generated/pluck_float32.wav",   file, formats::float32,   root_frequency),
+    samples.request("generated/pluck_pcm16.wav",     file, formats::pcm16,     root_frequency),
+    samples.request("generated/pluck_ima_adpcm.wav", file, formats::ima_adpcm, root_frequency),
+  };
 }
 
 void game_manager::audio_generator::set_sample_rate(unsigned int new_sample_rate) {
@@ -103,17 +377,16 @@ void game_manager::audio_generator::output(std::span<AudioSampleFrame> outputs)
   // interpolate towards the target frequency and volume values
   float const target_phase_increment{target_tone_frequency * 2.0f * boost::math::constants::pi<float>() / sample_rate};
   phase_increment = phase_increment * 0.95f + 0.05f * target_phase_increment;
-  current_volume = current_volume * 0.95f + 0.05f * target_volume;
+  current_volume = audio::denormal::snap(current_volume * 0.95f + 0.05f * target_volume); // decays geometrically towards zero when muted, so keep it out of the subnormal range
 
-  // produce a sine wave tone of desired frequency to all output channels
+  // produce a sine wave tone of desired frequency into the first channel, then copy it to all other output channels
   for(auto const &output : outputs) {
-    for(int i{0}; i != output.samplesPerChannel; ++i) {
-      float const sample{static_cast<float>(std::sin(phase)) * current_volume};
+    auto const mono{audio::mix::channel(output, 0)};
+    for(auto &sample : mono) {
+      sample = static_cast<float>(std::sin(phase)) * current_volume;
       phase += phase_increment;
-      for(int channel{0}; channel != output.numberOfChannels; ++channel) {
-        output.data[channel * output.samplesPerChannel + i] = sample;
-      }
     }
+    audio::mix::upmix_mono(mono, output);
   }
 
   // range reduce to keep precision around zero
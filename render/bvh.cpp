@@ -0,0 +1,216 @@
+#include "bvh.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace render {
+
+namespace {
+
+aabb3f empty_box() {
+  /// A box that any growth replaces entirely, so bounds can be accumulated without checking validity each time
+  float constexpr infinity{std::numeric_limits<float>::infinity()};
+  return {vec3f{infinity, infinity, infinity}, vec3f{-infinity, -infinity, -infinity}};
+}
+
+void grow(aabb3f &box, aabb3f const &other) {
+  /// Branchless extend, for the inner loops
+  box.min = std::min(box.min, other.min);
+  box.max = std::max(box.max, other.max);
+}
+void grow(aabb3f &box, vec3f const &point) {
+  box.min = std::min(box.min, point);
+  box.max = std::max(box.max, point);
+}
+
+float surface_area(aabb3f const &box) {
+  /// Half the surface area of a box, which is all the heuristic needs as only ratios matter
+  if(!box.valid()) return 0.0f;
+  vec3f const size{box.size()};
+  return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+}
+
+void bvh::build(std::span<aabb3f const> const bounds) {
+  /// Build the hierarchy from scratch, splitting each node at whichever of the binned candidate planes on any axis minimises the surface area heuristic
+  auto const object_count{static_cast<uint32_t>(bounds.size())};
+  nodes.clear();
+  references.resize(object_count);
+  for(uint32_t i{0}; i != object_count; ++i) {
+    references[i] = {.bounds{bounds[i]}, .centroid{bounds[i].centre()}, .object{i}};
+  }
+  objects.resize(object_count);
+  object_bounds.resize(object_count);
+  if(object_count == 0) {
+    built_cost = cost = 0.0f;
+    return;
+  }
+  nodes.reserve(2 * object_count);                                              // a binary tree with at least one object per leaf never has more nodes than this
+
+  nodes.push_back({.bounds{}, .first{0}, .count{object_count}});
+  build_stack.clear();
+  build_stack.push_back(0);
+  while(!build_stack.empty()) {
+    uint32_t const node_index{build_stack.back()};
+    build_stack.pop_back();
+    uint32_t const first{nodes[node_index].first};
+    uint32_t const count{nodes[node_index].count};
+    auto const node_references{std::span{references}.subspan(first, count)};
+
+    aabb3f node_bounds{empty_box()};
+    aabb3f centroid_bounds{empty_box()};
+    for(auto const &reference : node_references) {
+      grow(node_bounds, reference.bounds);
+      grow(centroid_bounds, reference.centroid);
+    }
+    nodes[node_index].bounds = node_bounds;
+    if(count <= max_leaf_size) continue;
+
+    // bin the objects along all three axes in one pass
+    struct bin {
+      aabb3f bounds{empty_box()};
+      uint32_t count{0};
+    };
+    vec3f const centroid_extent{centroid_bounds.size()};
+    vec3f bin_scale;
+    for(unsigned int axis{0}; axis != 3; ++axis) {
+      bin_scale[axis] = centroid_extent[axis] > 0.0f ? static_cast<float>(bin_count) / centroid_extent[axis] : 0.0f;
+    }
+    auto const bin_index{[&](vec3f const &centroid, unsigned int const axis){
+      return static_cast<unsigned int>(std::min(static_cast<float>(bin_count - 1), (centroid[axis] - centroid_bounds.min[axis]) * bin_scale[axis]));
+    }};
+    std::array<std::array<bin, bin_count>, 3> bins{};
+    for(auto const &reference : node_references) {
+      for(unsigned int axis{0}; axis != 3; ++axis) {
+        auto &this_bin{bins[axis][bin_index(reference.centroid, axis)]};
+        grow(this_bin.bounds, reference.bounds);
+        ++this_bin.count;
+      }
+    }
+
+    // find the cheapest split over every axis's bins
+    float best_cost{std::numeric_limits<float>::max()};
+    unsigned int best_axis{0};
+    unsigned int best_split{0};                                                 // objects in bins below this go left
+    for(unsigned int axis{0}; axis != 3; ++axis) {
+      if(centroid_extent[axis] <= 0.0f) continue;                               // every centroid is level on this axis, so it can't separate them
+      // sweep from the right to find the cost of everything above each plane, then from the left to complete each candidate
+      std::array<float, bin_count> right_costs{};
+      aabb3f right_bounds{empty_box()};
+      uint32_t right_count{0};
+      for(unsigned int split{bin_count - 1}; split != 0; --split) {
+        grow(right_bounds, bins[axis][split].bounds);
+        right_count += bins[axis][split].count;
+        right_costs[split] = surface_area(right_bounds) * static_cast<float>(right_count);
+      }
+      aabb3f left_bounds{empty_box()};
+      uint32_t left_count{0};
+      for(unsigned int split{1}; split != bin_count; ++split) {
+        grow(left_bounds, bins[axis][split - 1].bounds);
+        left_count += bins[axis][split - 1].count;
+        if(left_count == 0 || left_count == count) continue;                    // not a split at all
+        float const split_cost{surface_area(left_bounds) * static_cast<float>(left_count) + right_costs[split]};
+        if(split_cost < best_cost) {
+          best_cost = split_cost;
+          best_axis = axis;
+          best_split = split;
+        }
+      }
+    }
+
+    // partition the objects in place, falling back to halving by count when no plane separates them
+    auto const begin{references.begin() + first};
+    auto const end{begin + count};
+    auto middle{begin + count / 2};
+    if(best_cost < std::numeric_limits<float>::max()) {
+      middle = std::partition(begin, end, [&](build_reference const &reference){
+        return bin_index(reference.centroid, best_axis) < best_split;
+      });
+    }
+    auto const left_count{static_cast<uint32_t>(middle - begin)};
+
+    auto const left_index{static_cast<uint32_t>(nodes.size())};
+    nodes.push_back({.bounds{}, .first{first}, .count{left_count}});
+    nodes.push_back({.bounds{}, .first{first + left_count}, .count{count - left_count}});
+    nodes[node_index].first = left_index;
+    nodes[node_index].count = 0;
+    build_stack.push_back(left_index + 1);
+    build_stack.push_back(left_index);
+  }
+  std::ranges::transform(references, objects.begin(), &build_reference::object);
+  std::ranges::transform(references, object_bounds.begin(), &build_reference::bounds);
+  update_cost();
+  built_cost = cost;
+}
+
+void bvh::refit(std::span<aabb3f const> const bounds) {
+  /// Update every node's bounds for objects that have moved, keeping the tree's shape - much cheaper than a rebuild, but the tree degrades as objects move far
+  for(size_t i{nodes.size()}; i-- != 0;) {
+    auto &this_node{nodes[i]};
+    aabb3f node_bounds{empty_box()};
+    if(this_node.count != 0) {
+      for(uint32_t position{this_node.first}; position != this_node.first + this_node.count; ++position) {
+        object_bounds[position] = bounds[objects[position]];
+        grow(node_bounds, object_bounds[position]);
+      }
+    } else {
+      node_bounds = nodes[this_node.first].bounds;
+      grow(node_bounds, nodes[this_node.first + 1].bounds);
+    }
+    this_node.bounds = node_bounds;
+  }
+  update_cost();
+}
+
+void bvh::cull(frustum const &view, std::vector<uint32_t> &visible) const {
+  /// Collect the indices of every object whose bounds, as of the last build or refit, are at least partly inside the frustum
+  visible.clear();
+  if(nodes.empty()) return;
+  traversal_stack.clear();
+  traversal_stack.push_back({.node{0}, .plane_mask{frustum::all_planes}});
+  while(!traversal_stack.empty()) {
+    auto [node_index, plane_mask]{traversal_stack.back()};
+    traversal_stack.pop_back();
+    auto const &this_node{nodes[node_index]};
+    if(view.test(this_node.bounds, plane_mask) == frustum::results::outside) continue; // once inside every plane, the mask is empty and descendants pass without testing
+    if(this_node.count != 0) {
+      for(uint32_t position{this_node.first}; position != this_node.first + this_node.count; ++position) {
+        if(unsigned int object_mask{plane_mask}; view.test(object_bounds[position], object_mask) != frustum::results::outside) {
+          visible.push_back(objects[position]);
+        }
+      }
+    } else {
+      traversal_stack.push_back({.node{this_node.first + 1}, .plane_mask{plane_mask}});
+      traversal_stack.push_back({.node{this_node.first}, .plane_mask{plane_mask}});
+    }
+  }
+}
+
+size_t bvh::get_object_count() const {
+  return objects.size();
+}
+size_t bvh::get_node_count() const {
+  return nodes.size();
+}
+float bvh::get_degradation() const {
+  /// How much more costly the tree has become to traverse through refits since it was built, as a ratio - rebuild when this grows too large
+  return built_cost > 0.0f ? cost / built_cost : 1.0f;
+}
+
+void bvh::update_cost() {
+  /// Surface area heuristic cost of the whole tree, relative to the root's area
+  if(nodes.empty()) {                                                           // built over no objects
+    cost = 0.0f;
+    return;
+  }
+  float total{0.0f};
+  for(auto const &this_node : nodes) {
+    float const area{surface_area(this_node.bounds)};
+    total += this_node.count == 0 ? area : area * static_cast<float>(this_node.count);
+  }
+  float const root_area{surface_area(nodes.front().bounds)};
+  cost = root_area > 0.0f ? total / root_area : 0.0f;
+}
+
+}
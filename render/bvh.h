@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "vectorstorm/vector/vector3.h"
+#include "vectorstorm/aabb/aabb3.h"
+#include "frustum.h"
+
+namespace render {
+
+class bvh {
+  /// Bounding volume hierarchy over per-object bounding boxes, built top-down with a binned surface area heuristic and refitted in place as objects move
+  /// Nodes are stored with every node before its children and both children adjacent, so a refit is one reverse pass and traversal needs no parent links
+public:
+  struct node {
+    aabb3f bounds;
+    uint32_t first{0};                                                          // for an interior node the index of its first child, for a leaf the position of its first object in the object list
+    uint32_t count{0};                                                          // objects in a leaf, 0 for an interior node
+  };
+
+private:
+  static unsigned int constexpr bin_count{16};                                  // candidate split planes per axis, minus one
+  static unsigned int constexpr max_leaf_size{4};
+
+  struct traversal_entry {
+    uint32_t node;
+    unsigned int plane_mask;                                                    // frustum planes the node's parent wasn't already entirely inside
+  };
+
+  struct build_reference {                                                      // an object's bounds kept alongside its index, so building partitions one contiguous array rather than chasing indices
+    aabb3f bounds;
+    vec3f centroid;
+    uint32_t object;
+  };
+
+  std::vector<node> nodes;
+  std::vector<uint32_t> objects;                                                // object indices, ordered so each leaf's are contiguous
+  std::vector<aabb3f> object_bounds;                                            // bounds of each object in the same order, copied at build and refit so culling reads them sequentially
+  std::vector<build_reference> references;                                      // scratch for building
+  std::vector<uint32_t> build_stack;                                            // scratch for building
+  mutable std::vector<traversal_entry> traversal_stack;                         // scratch for culling, kept allocated between frames
+
+  float built_cost{0.0f};                                                       // surface area heuristic cost straight after building
+  float cost{0.0f};                                                             // surface area heuristic cost after the last build or refit
+
+public:
+  void build(std::span<aabb3f const> bounds);
+  void refit(std::span<aabb3f const> bounds);
+  void cull(frustum const &view, std::vector<uint32_t> &visible) const;
+
+  size_t get_object_count() const;
+  size_t get_node_count() const;
+  float get_degradation() const;
+
+private:
+  void update_cost();
+};
+
+}
@@ -0,0 +1,59 @@
+#include "frame_invalidation.h"
+#include <algorithm>
+
+namespace render {
+
+void frame_invalidation::set_on_demand(bool const new_on_demand) {
+  on_demand = new_on_demand;
+}
+bool frame_invalidation::is_on_demand() const {
+  return on_demand;
+}
+
+void frame_invalidation::invalidate(reasons const reason, unsigned int const frames) {
+  /// Mark the next frame dirty, and optionally enough following frames for the change to settle
+  pending |= 1u << static_cast<unsigned int>(reason);
+  if(frames > 1) extra_frames = std::max(extra_frames, frames - 1);
+}
+
+bool frame_invalidation::begin_frame() {
+  /// Decide whether to draw this frame, consuming the reasons it was marked dirty - outside on-demand mode every frame is drawn
+  bool const dirty{pending != 0 || extra_frames != 0};
+  if(pending == 0 && extra_frames != 0) --extra_frames;
+  for(unsigned int reason{0}; reason != reason_count; ++reason) {
+    if(pending & (1u << reason)) ++stats.frames_by_reason[reason];
+  }
+  pending = 0;
+
+  if(dirty || !on_demand) {
+    ++stats.frames_drawn;
+    return true;
+  }
+  ++stats.frames_skipped;
+  return false;
+}
+
+frame_invalidation::statistics const &frame_invalidation::get_statistics() const {
+  return stats;
+}
+
+char const *frame_invalidation::get_name(reasons const reason) {
+  /// Human-readable name of a reason, for display
+  switch(reason) {
+  case reasons::input:
+    return "input";
+  case reasons::animation:
+    return "animation";
+  case reasons::audio:
+    return "audio";
+  case reasons::resize:
+    return "resize";
+  case reasons::resources:
+    return "resources";
+  case reasons::count:
+    break;
+  }
+  return "unknown";
+}
+
+}
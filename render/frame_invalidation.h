@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace render {
+
+class frame_invalidation {
+  /// Decides whether each frame needs drawing: subsystems mark the frame dirty when what's on screen would change, and in on-demand mode clean frames skip encoding and submission entirely
+  /// The canvas keeps showing the last frame presented to it, so a skipped frame costs nothing on the GPU
+public:
+  enum class reasons : uint8_t {
+    input,                                                                      // GUI input events, or a widget being interacted with
+    animation,                                                                  // the scene is moving
+    audio,                                                                      // displayed audio telemetry has changed
+    resize,                                                                     // the swapchain was recreated, so its contents are lost
+    resources,                                                                  // something drawn is still loading
+    count,
+  };
+  static unsigned int constexpr reason_count{static_cast<unsigned int>(reasons::count)};
+
+  struct statistics {
+    uint64_t frames_drawn{0};
+    uint64_t frames_skipped{0};
+    std::array<uint64_t, reason_count> frames_by_reason{};                      // drawn frames each reason contributed to, so it's clear what keeps the frame dirty
+  };
+
+private:
+  bool on_demand{false};
+  unsigned int pending{1u << static_cast<unsigned int>(reasons::resize)};       // a bit for each reason the next frame is dirty, starting as if resized since the new swapchain holds nothing yet
+  unsigned int extra_frames{0};                                                 // further frames to draw after the next, for changes that take several frames to settle
+  statistics stats;
+
+public:
+  void set_on_demand(bool new_on_demand);
+  bool is_on_demand() const;
+
+  void invalidate(reasons reason, unsigned int frames = 1);
+  bool begin_frame();
+
+  statistics const &get_statistics() const;
+  static char const *get_name(reasons reason);
+};
+
+}
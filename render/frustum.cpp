@@ -0,0 +1,43 @@
+#include "frustum.h"
+#include <cmath>
+
+namespace render {
+
+frustum::frustum(mat4f const &view_projection) {
+  /// Extract the planes from the matrix rows, after Gribb and Hartmann
+  /// Clip space depth is taken as -w to w, as create_frustum produces; this is a superset of WebGPU's 0 to w, so culling stays conservative
+  auto const row{[&](unsigned int const i){
+    return vec4f{view_projection.data[i], view_projection.data[4 + i], view_projection.data[8 + i], view_projection.data[12 + i]}; // the matrix is column-major
+  }};
+  vec4f const row_x{row(0)};
+  vec4f const row_y{row(1)};
+  vec4f const row_z{row(2)};
+  vec4f const row_w{row(3)};
+  planes = {
+    row_w + row_x,                                                              // left
+    row_w - row_x,                                                              // right
+    row_w + row_y,                                                              // bottom
+    row_w - row_y,                                                              // top
+    row_w + row_z,                                                              // near
+    row_w - row_z,                                                              // far
+  };
+}
+
+frustum::results frustum::test(aabb3f const &box, unsigned int &plane_mask) const {
+  /// Classify a box against the planes still set in the mask, clearing the bits of any planes it lies entirely inside
+  /// Children of a box lie inside whatever planes it does, so passing the narrowed mask down a hierarchy skips tests that can't fail
+  vec3f const centre{box.centre()};
+  vec3f const extent{box.extent()};
+  for(unsigned int i{0}; i != planes.size(); ++i) {
+    unsigned int const bit{1u << i};
+    if(!(plane_mask & bit)) continue;
+    auto const &plane{planes[i]};
+    float const distance{plane.x * centre.x + plane.y * centre.y + plane.z * centre.z + plane.w};
+    float const radius{std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z}; // the box's half-width projected onto the plane normal
+    if(distance + radius < 0.0f) return results::outside;
+    if(distance - radius >= 0.0f) plane_mask &= ~bit;
+  }
+  return plane_mask == 0 ? results::inside : results::intersecting;
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "vectorstorm/matrix/matrix4.h"
+#include "vectorstorm/vector/vector4.h"
+#include "vectorstorm/aabb/aabb3.h"
+
+namespace render {
+
+class frustum {
+  /// The six planes bounding everything a view-projection matrix can see, for culling bounding boxes on the CPU
+public:
+  enum class results : uint8_t {
+    outside,
+    intersecting,
+    inside,
+  };
+  static unsigned int constexpr all_planes{0b11'1111};                          // mask with every plane still to be tested
+
+private:
+  std::array<vec4f, 6> planes;                                                  // xyz is the inward normal, w the offset, unnormalised as only the signs of distances matter
+
+public:
+  explicit frustum(mat4f const &view_projection);
+
+  results test(aabb3f const &box, unsigned int &plane_mask) const;
+};
+
+}
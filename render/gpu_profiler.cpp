@@ -0,0 +1,126 @@
+#include "gpu_profiler.h"
+
+namespace render {
+
+namespace {
+
+float constexpr smoothing{0.1f};                                                // weight of each new frame's time in the running average
+
+void accumulate(float &average, float const sample) {
+  /// Exponential moving average, so readings are steady enough to read
+  average += (sample - average) * smoothing;
+}
+
+}
+
+void gpu_profiler::init(wgpu::Device const &device) {
+  /// Create the query set and readback ring if the device supports timestamp queries
+  gpu_available = device.HasFeature(wgpu::FeatureName::TimestampQuery);
+  results.gpu_available = gpu_available;
+  if(!gpu_available) return;
+
+  wgpu::QuerySetDescriptor query_set_descriptor{
+    .label{"Profiler query set"},
+    .type{wgpu::QueryType::Timestamp},
+    .count{query_count},
+  };
+  query_set = device.CreateQuerySet(&query_set_descriptor);
+
+  wgpu::BufferDescriptor resolve_buffer_descriptor{
+    .label{"Profiler resolve buffer"},
+    .usage{wgpu::BufferUsage::QueryResolve | wgpu::BufferUsage::CopySrc},
+    .size{readback_size},
+  };
+  resolve_buffer = device.CreateBuffer(&resolve_buffer_descriptor);
+
+  for(auto &slot : slots) {
+    wgpu::BufferDescriptor readback_buffer_descriptor{
+      .label{"Profiler readback buffer"},
+      .usage{wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst},
+      .size{readback_size},
+    };
+    slot.owner = this;
+    slot.buffer = device.CreateBuffer(&readback_buffer_descriptor);
+  }
+
+  for(unsigned int pass{0}; pass != pass_count; ++pass) {
+    timestamp_writes[pass] = {
+      .querySet{query_set},
+      .beginningOfPassWriteIndex{2 * pass},
+      .endOfPassWriteIndex{2 * pass + 1},
+    };
+  }
+}
+
+void gpu_profiler::set_enabled(bool const new_enabled) {
+  enabled = new_enabled;
+}
+bool gpu_profiler::is_enabled() const {
+  return enabled;
+}
+gpu_profiler::timings const &gpu_profiler::get_timings() const {
+  return results;
+}
+
+void gpu_profiler::begin_frame() {
+  /// Choose where this frame's timestamps will be read back - if the next slot is still in use, skip measuring GPU time this frame rather than wait
+  frame_slot = nullptr;
+  if(!enabled || !gpu_available) return;
+  auto &slot{slots[next_slot]};
+  if(slot.pending) return;
+  frame_slot = &slot;
+  next_slot = (next_slot + 1) % readback_slots;
+}
+
+wgpu::RenderPassTimestampWrites const *gpu_profiler::begin_pass(passes const pass) {
+  /// Start timing a pass on the CPU, returning the timestamp writes for its descriptor, or null if not measuring GPU time this frame
+  auto const index{static_cast<unsigned int>(pass)};
+  if(!enabled) return nullptr;
+  cpu_pass_start[index] = std::chrono::steady_clock::now();
+  return frame_slot ? &timestamp_writes[index] : nullptr;
+}
+
+void gpu_profiler::end_pass(passes const pass) {
+  /// Finish timing a pass's encoding on the CPU
+  if(!enabled) return;
+  auto const index{static_cast<unsigned int>(pass)};
+  accumulate(results.cpu[index], std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpu_pass_start[index]).count());
+}
+
+void gpu_profiler::end_frame(wgpu::CommandEncoder const &encoder) {
+  /// Resolve this frame's timestamps and copy them into its readback slot, as part of the frame's own commands
+  if(!frame_slot) return;
+  encoder.ResolveQuerySet(query_set, 0, query_count, resolve_buffer, 0);
+  encoder.CopyBufferToBuffer(resolve_buffer, 0, frame_slot->buffer, 0, readback_size);
+  frame_slot->pending = true;
+}
+
+void gpu_profiler::after_submit() {
+  /// Once the frame is submitted, request its readback slot be mapped - the callback fires when the GPU has finished with it
+  if(!frame_slot) return;
+  frame_slot->buffer.MapAsync(wgpu::MapMode::Read, 0, readback_size, [](WGPUBufferMapAsyncStatus status_c, void *data){
+    /// Buffer mapped callback
+    auto &slot{*static_cast<readback_slot*>(data)};
+    if(static_cast<wgpu::BufferMapAsyncStatus>(status_c) == wgpu::BufferMapAsyncStatus::Success) {
+      slot.owner->read_slot(slot);
+    }
+    slot.pending = false;
+  }, frame_slot);
+  frame_slot = nullptr;
+}
+
+void gpu_profiler::read_slot(readback_slot &slot) {
+  /// Convert a mapped slot's timestamp pairs from nanoseconds to per-pass times, and release the slot
+  auto const *timestamps{static_cast<uint64_t const*>(slot.buffer.GetConstMappedRange(0, readback_size))};
+  if(timestamps) {
+    for(unsigned int pass{0}; pass != pass_count; ++pass) {
+      uint64_t const begin{timestamps[2 * pass]};
+      uint64_t const end{timestamps[2 * pass + 1]};
+      if(end < begin) continue;                                                 // timestamps may be reset between passes, as when the GPU changes power state
+      accumulate(results.gpu[pass], static_cast<float>(end - begin) * 1.0e-6f);
+    }
+  }
+  slot.buffer.Unmap();
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <webgpu/webgpu_cpp.h>
+
+namespace render {
+
+class gpu_profiler {
+  /// Per-pass GPU and CPU encode times, from timestamp queries written at the start and end of each render pass
+  /// Timestamps are resolved into a ring of readback buffers mapped asynchronously, so results arrive a few frames late but never stall the GPU
+  /// Without the timestamp-query feature, only CPU encode times are measured
+public:
+  enum class passes : uint8_t {
+    scene,
+    gui,
+    count,
+  };
+  static unsigned int constexpr pass_count{static_cast<unsigned int>(passes::count)};
+
+  struct timings {                                                              // smoothed, in milliseconds
+    std::array<float, pass_count> gpu{};
+    std::array<float, pass_count> cpu{};
+    bool gpu_available{false};                                                  // false without timestamp queries, when only CPU times are measured
+  };
+
+private:
+  static unsigned int constexpr query_count{2 * pass_count};                    // a beginning and end timestamp per pass
+  static unsigned int constexpr readback_slots{4};                              // frames of results that may be awaiting mapping at once
+  static uint64_t constexpr readback_size{query_count * sizeof(uint64_t)};
+
+  struct readback_slot {
+    gpu_profiler *owner{nullptr};                                               // for the map callback
+    wgpu::Buffer buffer;
+    bool pending{false};                                                        // copied into or mapping, so not yet free for another frame
+  };
+
+  bool enabled{false};
+  bool gpu_available{false};
+
+  wgpu::QuerySet query_set;
+  wgpu::Buffer resolve_buffer;                                                  // queries can only be resolved into a buffer that can't be mapped, so are copied on from here
+  std::array<readback_slot, readback_slots> slots;
+  unsigned int next_slot{0};
+  readback_slot *frame_slot{nullptr};                                           // where this frame's timestamps go, or null if not measuring GPU time this frame
+  std::array<wgpu::RenderPassTimestampWrites, pass_count> timestamp_writes;
+
+  std::array<std::chrono::steady_clock::time_point, pass_count> cpu_pass_start;
+  timings results;
+
+public:
+  void init(wgpu::Device const &device);
+
+  void set_enabled(bool new_enabled);
+  bool is_enabled() const;
+  timings const &get_timings() const;
+
+  void begin_frame();
+  wgpu::RenderPassTimestampWrites const *begin_pass(passes pass);
+  void end_pass(passes pass);
+  void end_frame(wgpu::CommandEncoder const &encoder);
+  void after_submit();
+
+private:
+  void read_slot(readback_slot &slot);
+};
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "vectorstorm/matrix/matrix4.h"
+#include "vectorstorm/vector/vector4.h"
+
+namespace render {
+
+struct instance {                                                               // per-object data, read by the vertex shader once per instance
+  mat4f model_matrix;                                                           // object to world transform, including any scale
+  vec4f colour;                                                                 // multiplies the mesh's vertex colour
+};
+static_assert(sizeof(instance) == sizeof(instance::model_matrix) + sizeof(instance::colour)); // make sure the struct is packed
+
+}
@@ -0,0 +1,217 @@
+#include "pipeline_cache.h"
+#include <cstring>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <magic_enum/magic_enum.hpp>
+#include "logstorm/manager.h"
+
+namespace render {
+
+namespace {
+
+class serialiser {
+  /// Byte string of each field in turn, so struct padding never contributes
+  std::vector<std::byte> bytes;
+
+public:
+  void add_bytes(void const *data, size_t size) {
+    /// Append raw bytes
+    auto const *first{static_cast<std::byte const*>(data)};
+    bytes.insert(bytes.end(), first, first + size);
+  }
+
+  template<typename T> requires std::is_scalar_v<T>
+  void add(T const value) {
+    /// Append a number, enum, bool or handle
+    add_bytes(&value, sizeof(value));
+  }
+
+  void add(char const *string) {
+    /// Strings are hashed by content, with a null pointer distinct from an empty string
+    if(!string) {
+      add(uint8_t{0});
+      return;
+    }
+    add(uint8_t{1});
+    auto const length{std::strlen(string)};
+    add(length);
+    add_bytes(string, length);
+  }
+
+  std::vector<std::byte> get() && {
+    return std::move(bytes);
+  }
+};
+
+uint64_t hash(std::span<std::byte const> const bytes) {
+  /// 64-bit FNV-1a
+  uint64_t state{0xcb'f2'9c'e4'84'22'23'25ull};
+  for(auto const byte : bytes) {
+    state ^= static_cast<uint64_t>(byte);
+    state *= 0x100'00'00'01'b3ull;
+  }
+  return state;
+}
+
+}
+
+pipeline_cache::pipeline_cache(logstorm::manager &this_logger)
+  : logger{this_logger} {
+  /// Construct an empty cache, to be initialised once a device is available
+}
+
+void pipeline_cache::init(wgpu::Device const &new_device) {
+  /// Set the device all shader modules and pipelines are created on
+  device = new_device;
+}
+
+wgpu::ShaderModule const &pipeline_cache::get_shader_module(std::string_view const source, char const *label) {
+  /// Compile a shader module, or return the one already compiled from identical source
+  auto [it, inserted]{shader_modules.try_emplace(std::string{source})};
+  if(!inserted) return it->second;
+
+  wgpu::ShaderModuleWGSLDescriptor shader_module_wgsl_decriptor;
+  shader_module_wgsl_decriptor.code = it->first.c_str();                        // the descriptor takes a null-terminated string
+  wgpu::ShaderModuleDescriptor shader_module_descriptor{
+    .nextInChain{&shader_module_wgsl_decriptor},
+    .label{label},
+  };
+  it->second = device.CreateShaderModule(&shader_module_descriptor);
+  return it->second;
+}
+
+pipeline_cache::key pipeline_cache::request(wgpu::RenderPipelineDescriptor const &descriptor) {
+  /// Start creating a pipeline unless one with the same descriptor already exists or is on its way, returning the key to fetch it with
+  auto signature{serialise_descriptor(descriptor)};
+  key pipeline_key{hash(signature)};
+  auto [it, inserted]{pipelines.try_emplace(pipeline_key)};
+  while(!inserted) {
+    if(it->second.signature == signature) return pipeline_key;
+    std::tie(it, inserted) = pipelines.try_emplace(++pipeline_key);             // a different descriptor with the same hash: probe for the next free key
+  }
+
+  auto &new_entry{it->second};
+  new_entry.owner = this;
+  new_entry.signature = std::move(signature);
+  new_entry.layout = descriptor.layout;
+  new_entry.vertex_module = descriptor.vertex.module;
+  if(descriptor.fragment) new_entry.fragment_module = descriptor.fragment->module;
+  logger << "WebGPU: Creating render pipeline " << (descriptor.label ? descriptor.label : "") << " asynchronously";
+  device.CreateRenderPipelineAsync(
+    &descriptor,
+    [](WGPUCreatePipelineAsyncStatus status_c, WGPURenderPipeline pipeline_ptr, char const *message, void *data){
+      /// Render pipeline created callback
+      auto &this_entry{*static_cast<entry*>(data)};
+      auto &this_logger{this_entry.owner->logger};
+      if(auto const status{static_cast<wgpu::CreatePipelineAsyncStatus>(status_c)}; status != wgpu::CreatePipelineAsyncStatus::Success) {
+        this_logger << "ERROR: WebGPU render pipeline creation failure, status " << magic_enum::enum_name(status) << ": " << (message ? message : "");
+        this_entry.state = states::failed;
+        return;
+      }
+      this_entry.pipeline = wgpu::RenderPipeline::Acquire(pipeline_ptr);
+      this_entry.state = states::ready;
+    },
+    &new_entry
+  );
+  return pipeline_key;
+}
+
+pipeline_cache::states pipeline_cache::get_state(key const pipeline_key) const {
+  /// Find out whether a requested pipeline is ready yet - keys never requested count as failed
+  auto const it{pipelines.find(pipeline_key)};
+  if(it == pipelines.end()) return states::failed;
+  return it->second.state;
+}
+
+wgpu::RenderPipeline const *pipeline_cache::get(key const pipeline_key) const {
+  /// Return a pipeline if it is ready to use, or null if it is still compiling or failed
+  auto const it{pipelines.find(pipeline_key)};
+  if(it == pipelines.end() || it->second.state != states::ready) return nullptr;
+  return &it->second.pipeline;
+}
+
+std::vector<std::byte> pipeline_cache::serialise_descriptor(wgpu::RenderPipelineDescriptor const &descriptor) {
+  /// Serialise every part of a descriptor that affects the pipeline built from it - labels are ignored, and the layout and shader modules are identified by handle
+  serialiser serialised;
+  auto const add_shader{[&](wgpu::ShaderModule const &module, char const *entry_point, size_t constant_count, wgpu::ConstantEntry const *constants){
+    serialised.add(reinterpret_cast<uintptr_t>(module.Get()));                  // modules from get_shader_module() are unique per source
+    serialised.add(entry_point);
+    serialised.add(constant_count);
+    for(size_t i{0}; i != constant_count; ++i) {
+      serialised.add(constants[i].key);
+      serialised.add(constants[i].value);
+    }
+  }};
+  auto const add_stencil_face{[&](wgpu::StencilFaceState const &face){
+    serialised.add(face.compare);
+    serialised.add(face.failOp);
+    serialised.add(face.depthFailOp);
+    serialised.add(face.passOp);
+  }};
+  auto const add_blend_component{[&](wgpu::BlendComponent const &component){
+    serialised.add(component.operation);
+    serialised.add(component.srcFactor);
+    serialised.add(component.dstFactor);
+  }};
+
+  serialised.add(reinterpret_cast<uintptr_t>(descriptor.layout.Get()));
+
+  auto const &vertex{descriptor.vertex};
+  add_shader(vertex.module, vertex.entryPoint, vertex.constantCount, vertex.constants);
+  serialised.add(vertex.bufferCount);
+  for(size_t i{0}; i != vertex.bufferCount; ++i) {
+    auto const &buffer{vertex.buffers[i]};
+    serialised.add(buffer.arrayStride);
+    serialised.add(buffer.stepMode);
+    serialised.add(buffer.attributeCount);
+    for(size_t j{0}; j != buffer.attributeCount; ++j) {
+      serialised.add(buffer.attributes[j].format);
+      serialised.add(buffer.attributes[j].offset);
+      serialised.add(buffer.attributes[j].shaderLocation);
+    }
+  }
+
+  serialised.add(descriptor.primitive.topology);
+  serialised.add(descriptor.primitive.stripIndexFormat);
+  serialised.add(descriptor.primitive.frontFace);
+  serialised.add(descriptor.primitive.cullMode);
+
+  serialised.add(descriptor.depthStencil != nullptr);
+  if(auto const *depth_stencil{descriptor.depthStencil}) {
+    serialised.add(depth_stencil->format);
+    serialised.add(depth_stencil->depthWriteEnabled);
+    serialised.add(depth_stencil->depthCompare);
+    add_stencil_face(depth_stencil->stencilFront);
+    add_stencil_face(depth_stencil->stencilBack);
+    serialised.add(depth_stencil->stencilReadMask);
+    serialised.add(depth_stencil->stencilWriteMask);
+    serialised.add(depth_stencil->depthBias);
+    serialised.add(depth_stencil->depthBiasSlopeScale);
+    serialised.add(depth_stencil->depthBiasClamp);
+  }
+
+  serialised.add(descriptor.multisample.count);
+  serialised.add(descriptor.multisample.mask);
+  serialised.add(descriptor.multisample.alphaToCoverageEnabled);
+
+  serialised.add(descriptor.fragment != nullptr);
+  if(auto const *fragment{descriptor.fragment}) {
+    add_shader(fragment->module, fragment->entryPoint, fragment->constantCount, fragment->constants);
+    serialised.add(fragment->targetCount);
+    for(size_t i{0}; i != fragment->targetCount; ++i) {
+      auto const &target{fragment->targets[i]};
+      serialised.add(target.format);
+      serialised.add(target.writeMask);
+      serialised.add(target.blend != nullptr);
+      if(target.blend) {
+        add_blend_component(target.blend->color);
+        add_blend_component(target.blend->alpha);
+      }
+    }
+  }
+  return std::move(serialised).get();
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+#include "logstorm/logstorm_forward.h"
+
+namespace render {
+
+class pipeline_cache {
+  /// Render pipelines keyed by a hash of everything that determines them - shader modules, entry points, layout, vertex buffers, formats and fixed-function state
+  /// Pipelines are created asynchronously, so several can compile in parallel while frames keep drawing, and a descriptor already requested is never built again
+  /// Each entry keeps the full descriptor it was built from to compare on a hash hit, and holds the objects it refers to, so their handles can't be reused while it exists
+public:
+  using key = uint64_t;
+
+  enum class states : uint8_t {
+    pending,
+    ready,
+    failed,
+  };
+
+private:
+  logstorm::manager &logger;
+
+  struct entry {
+    pipeline_cache *owner{nullptr};                                             // for the creation callback
+    states state{states::pending};
+    wgpu::RenderPipeline pipeline;
+    std::vector<std::byte> signature;                                           // the descriptor serialised field by field
+    wgpu::PipelineLayout layout;                                                // referenced by handle in the signature
+    wgpu::ShaderModule vertex_module;
+    wgpu::ShaderModule fragment_module;
+  };
+
+  wgpu::Device device;
+  std::unordered_map<std::string, wgpu::ShaderModule> shader_modules;           // keyed by source, so identical source always gives the same module
+  std::unordered_map<key, entry> pipelines;                                     // elements never move once inserted, so callbacks can safely point at them
+
+public:
+  pipeline_cache(logstorm::manager &logger);
+
+  void init(wgpu::Device const &device);
+
+  wgpu::ShaderModule const &get_shader_module(std::string_view source, char const *label = nullptr);
+
+  key request(wgpu::RenderPipelineDescriptor const &descriptor);
+  states get_state(key pipeline_key) const;
+  wgpu::RenderPipeline const *get(key pipeline_key) const;
+
+private:
+  static std::vector<std::byte> serialise_descriptor(wgpu::RenderPipelineDescriptor const &descriptor);
+};
+
+}
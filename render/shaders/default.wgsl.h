@@ -4,35 +4,62 @@
 
 namespace render::shaders {
 
-inline constexpr char const *default_wgsl{R"081f8b92eef0a2c7(struct vertex_input {
+inline constexpr char const *default_wgsl{R"6ca37dd483641362(struct vertex_input {
   @location(0) position: vec3f,
   @location(1) normal: vec3f,
   @location(2) colour: vec4f,
 };
+struct compact_vertex_input {
+  @location(0) position: vec4f,
+  @location(1) normal: vec2f,
+  @location(2) colour: vec4f,
+};
+struct instance_input {
+  @location(3) model_matrix_0: vec4f,
+  @location(4) model_matrix_1: vec4f,
+  @location(5) model_matrix_2: vec4f,
+  @location(6) model_matrix_3: vec4f,
+  @location(7) colour: vec4f,
+};
 struct vertex_output {
   @builtin(position) position: vec4f,
   @location(1) @interpolate(flat, first) colour: vec4f,
 };
 struct uniform_struct {
-  model_view_projection_matrix: mat4x4f,
-  normal_matrix: mat3x3f,
+  view_projection_matrix: mat4x4f,
 };
 @group(0) @binding(0) var<uniform> uniforms: uniform_struct;
 const light_dir = vec3f(0.872872, 0.218218, -0.436436);
 const ambient = 0.5f;
-@vertex
-fn vs_main(in: vertex_input) -> vertex_output {
+fn decode_octahedral(encoded: vec2f) -> vec3f {
+  var normal = vec3f(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  let fold = max(-normal.z, 0.0);
+  normal.x += select(fold, -fold, normal.x >= 0.0);
+  normal.y += select(fold, -fold, normal.y >= 0.0);
+  return normalize(normal);
+}
+fn shade(position: vec3f, normal: vec3f, vertex_colour: vec4f, instance: instance_input) -> vertex_output {
   var out: vertex_output;
-  out.position = uniforms.model_view_projection_matrix * vec4f(in.position, 1.0);
-  let transformed_normal = uniforms.normal_matrix * in.normal;
+  let model_matrix = mat4x4f(instance.model_matrix_0, instance.model_matrix_1, instance.model_matrix_2, instance.model_matrix_3);
+  out.position = uniforms.view_projection_matrix * model_matrix * vec4f(position, 1.0);
+  let transformed_normal = normalize((model_matrix * vec4f(normal, 0.0)).xyz);
   let diffuse_intensity = (max(dot(transformed_normal, light_dir), 0.0) * (1.0 - ambient)) + ambient;
-  out.colour = vec4f(in.colour.rgb * diffuse_intensity, in.colour.a);
+  let colour = vertex_colour * instance.colour;
+  out.colour = vec4f(colour.rgb * diffuse_intensity, colour.a);
   return out;
 }
+@vertex
+fn vs_main(in: vertex_input, instance: instance_input) -> vertex_output {
+  return shade(in.position, in.normal, in.colour, instance);
+}
+@vertex
+fn vs_main_compact(in: compact_vertex_input, instance: instance_input) -> vertex_output {
+  return shade(in.position.xyz, decode_octahedral(in.normal), in.colour, instance);
+}
 @fragment
 fn fs_main(in: vertex_output) -> @location(0) vec4f {
   return in.colour;
 }
-)081f8b92eef0a2c7"};
+)6ca37dd483641362"};
 
 } // namespace render::shaders
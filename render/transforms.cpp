@@ -0,0 +1,248 @@
+#include "transforms.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include "simd/simd.h"
+
+namespace render {
+
+namespace {
+
+struct batch_columns {                                                          // the rotation and scale part of a batch of local matrices, one array of lanes per element
+  std::array<std::array<float, simd::width>, 9> elements;                       // column-major, three columns of three rows
+};
+
+void compose_local(float const *rotation_x,
+                   float const *rotation_y,
+                   float const *rotation_z,
+                   float const *rotation_w,
+                   float const *scale_x,
+                   float const *scale_y,
+                   float const *scale_z,
+                   batch_columns &out) {
+  /// Scaled rotation matrices for a batch of entries, the same as quatf::transform() * mat4f::create_scale() for each lane
+  simd::batch const one{simd::broadcast(1.0f)};
+  simd::batch const two{simd::broadcast(2.0f)};
+  simd::batch const x{simd::load(rotation_x)};
+  simd::batch const y{simd::load(rotation_y)};
+  simd::batch const z{simd::load(rotation_z)};
+  simd::batch const w{simd::load(rotation_w)};
+  simd::batch const sx{simd::load(scale_x)};
+  simd::batch const sy{simd::load(scale_y)};
+  simd::batch const sz{simd::load(scale_z)};
+
+  simd::batch const x2{x * two};
+  simd::batch const y2{y * two};
+  simd::batch const z2{z * two};
+  simd::batch const xx{x * x2};
+  simd::batch const yy{y * y2};
+  simd::batch const zz{z * z2};
+  simd::batch const xy{x * y2};
+  simd::batch const xz{x * z2};
+  simd::batch const yz{y * z2};
+  simd::batch const wx{w * x2};
+  simd::batch const wy{w * y2};
+  simd::batch const wz{w * z2};
+
+  simd::store(out.elements[0].data(), (one - (yy + zz)) * sx);
+  simd::store(out.elements[1].data(), (xy + wz) * sx);
+  simd::store(out.elements[2].data(), (xz - wy) * sx);
+  simd::store(out.elements[3].data(), (xy - wz) * sy);
+  simd::store(out.elements[4].data(), (one - (xx + zz)) * sy);
+  simd::store(out.elements[5].data(), (yz + wx) * sy);
+  simd::store(out.elements[6].data(), (xz + wy) * sz);
+  simd::store(out.elements[7].data(), (yz - wx) * sz);
+  simd::store(out.elements[8].data(), (one - (xx + yy)) * sz);
+}
+
+struct batch_matrices {                                                         // a batch of 4x4 matrices, one array of lanes per element
+  std::array<std::array<float, simd::width>, 16> elements;                      // column-major, in the same order as mat4f::data
+};
+
+void compose_world(batch_columns const &local,
+                   float const *position_x,
+                   float const *position_y,
+                   float const *position_z,
+                   batch_matrices const &parent,
+                   batch_matrices &out) {
+  /// Parent * local for a batch of entries, the same as mat4f::operator*() for each lane, with local's bottom row always 0, 0, 0, 1
+  std::array<simd::batch, 16> parent_elements;
+  for(size_t i{0}; i != parent_elements.size(); ++i) {
+    parent_elements[i] = simd::load(parent.elements[i].data());
+  }
+  for(size_t column{0}; column != 3; ++column) {
+    simd::batch const x{simd::load(local.elements[column * 3 + 0].data())};
+    simd::batch const y{simd::load(local.elements[column * 3 + 1].data())};
+    simd::batch const z{simd::load(local.elements[column * 3 + 2].data())};
+    for(size_t row{0}; row != 4; ++row) {
+      simd::store(out.elements[column * 4 + row].data(), simd::multiply_add(z, parent_elements[8 + row], simd::multiply_add(y, parent_elements[4 + row], x * parent_elements[row])));
+    }
+  }
+  simd::batch const x{simd::load(position_x)};
+  simd::batch const y{simd::load(position_y)};
+  simd::batch const z{simd::load(position_z)};
+  for(size_t row{0}; row != 4; ++row) {
+    simd::store(out.elements[12 + row].data(), simd::multiply_add(z, parent_elements[8 + row], simd::multiply_add(y, parent_elements[4 + row], x * parent_elements[row])) + parent_elements[12 + row]);
+  }
+}
+
+}
+
+transforms::handle transforms::add(handle const parent) {
+  /// Add an identity transform as a root or the child of an existing entry, returning its handle
+  assert(parent == no_parent || parent < count);
+  if(count == parents.size()) {                                                 // grow by a whole batch, padded with identity transforms so batches can always be read in full
+    size_t const new_size{parents.size() + simd::width};
+    position_x.resize(new_size, 0.0f);
+    position_y.resize(new_size, 0.0f);
+    position_z.resize(new_size, 0.0f);
+    rotation_x.resize(new_size, 0.0f);
+    rotation_y.resize(new_size, 0.0f);
+    rotation_z.resize(new_size, 0.0f);
+    rotation_w.resize(new_size, 1.0f);
+    scale_x.resize(new_size, 1.0f);
+    scale_y.resize(new_size, 1.0f);
+    scale_z.resize(new_size, 1.0f);
+    parents.resize(new_size, no_parent);
+    local_dirty.resize(new_size, 0);
+    world_changed.resize(new_size, 0);
+    world_matrices.resize(new_size);
+  }
+  handle const entry{count++};
+  parents[entry] = parent;
+  local_dirty[entry] = 1;
+  return entry;
+}
+
+void transforms::clear() {
+  /// Remove all entries, keeping the storage allocated
+  count = 0;
+  updated_count = 0;
+  std::fill(position_x.begin(), position_x.end(), 0.0f);
+  std::fill(position_y.begin(), position_y.end(), 0.0f);
+  std::fill(position_z.begin(), position_z.end(), 0.0f);
+  std::fill(rotation_x.begin(), rotation_x.end(), 0.0f);
+  std::fill(rotation_y.begin(), rotation_y.end(), 0.0f);
+  std::fill(rotation_z.begin(), rotation_z.end(), 0.0f);
+  std::fill(rotation_w.begin(), rotation_w.end(), 1.0f);
+  std::fill(scale_x.begin(), scale_x.end(), 1.0f);
+  std::fill(scale_y.begin(), scale_y.end(), 1.0f);
+  std::fill(scale_z.begin(), scale_z.end(), 1.0f);
+  std::fill(local_dirty.begin(), local_dirty.end(), 0);
+  std::fill(world_changed.begin(), world_changed.end(), 0);
+}
+
+transforms::handle transforms::size() const {
+  return count;
+}
+
+void transforms::set_position(handle const entry, vec3f const &position) {
+  assert(entry < count);
+  position_x[entry] = position.x;
+  position_y[entry] = position.y;
+  position_z[entry] = position.z;
+  local_dirty[entry] = 1;
+}
+
+void transforms::set_rotation(handle const entry, quatf const &rotation) {
+  assert(entry < count);
+  rotation_x[entry] = rotation.v.x;
+  rotation_y[entry] = rotation.v.y;
+  rotation_z[entry] = rotation.v.z;
+  rotation_w[entry] = rotation.w;
+  local_dirty[entry] = 1;
+}
+
+void transforms::set_scale(handle const entry, vec3f const &scale) {
+  assert(entry < count);
+  scale_x[entry] = scale.x;
+  scale_y[entry] = scale.y;
+  scale_z[entry] = scale.z;
+  local_dirty[entry] = 1;
+}
+
+void transforms::update() {
+  /// Recompose the world matrix of every entry whose own transform or any ancestor's has changed, a batch at a time
+  /// Batches with no changes are skipped, otherwise the whole batch's local and world matrices are composed together and only the changed lanes are written out
+  std::array<float, 16> constexpr identity{
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f,
+  };
+  updated_count = 0;
+  batch_columns columns;
+  batch_matrices parent_matrices{};
+  batch_matrices world_columns;
+  for(handle first{0}; first < count; first += simd::width) {
+    handle const last{std::min(first + static_cast<handle>(simd::width), count)};
+    bool any_changed{false};
+    for(handle entry{first}; entry != last; ++entry) {
+      handle const parent{parents[entry]};
+      bool const changed{local_dirty[entry] || (parent != no_parent && world_changed[parent])}; // parents come first, so theirs is already settled this update
+      world_changed[entry] = changed;
+      any_changed |= changed;
+    }
+    if(!any_changed) continue;
+
+    for(handle entry{first}; entry != last; ++entry) {
+      handle const parent{parents[entry]};
+      auto const &parent_matrix{parent == no_parent || parent >= first ? identity : world_matrices[parent].data}; // a parent in this same batch isn't composed yet, so is applied afterwards
+      for(size_t i{0}; i != parent_matrix.size(); ++i) {
+        parent_matrices.elements[i][entry - first] = parent_matrix[i];
+      }
+    }
+
+    compose_local(&rotation_x[first],
+                  &rotation_y[first],
+                  &rotation_z[first],
+                  &rotation_w[first],
+                  &scale_x[first],
+                  &scale_y[first],
+                  &scale_z[first],
+                  columns);
+    compose_world(columns,
+                  &position_x[first],
+                  &position_y[first],
+                  &position_z[first],
+                  parent_matrices,
+                  world_columns);
+
+    for(handle entry{first}; entry != last; ++entry) {
+      if(!world_changed[entry]) continue;
+      local_dirty[entry] = 0;
+      ++updated_count;
+      auto const lane{entry - first};
+      auto &world{world_matrices[entry]};
+      for(size_t i{0}; i != world.data.size(); ++i) {
+        world.data[i] = world_columns.elements[i][lane];
+      }
+      handle const parent{parents[entry]};
+      if(parent != no_parent && parent >= first) {                              // composed against identity above, so this is still the local matrix - the parent lane was written earlier in this loop
+        world = world_matrices[parent] * world;
+      }
+    }
+  }
+}
+
+mat4f const &transforms::get_world_matrix(handle const entry) const {
+  assert(entry < count);
+  return world_matrices[entry];
+}
+
+std::span<mat4f const> transforms::get_world_matrices() const {
+  /// World matrices of all entries, indexed by handle
+  return {world_matrices.data(), count};
+}
+
+bool transforms::was_updated(handle const entry) const {
+  /// Whether the last update recomposed this entry's world matrix
+  assert(entry < count);
+  return world_changed[entry];
+}
+
+transforms::handle transforms::get_updated_count() const {
+  return updated_count;
+}
+
+}
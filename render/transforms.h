@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+#include "vectorstorm/vector/vector3.h"
+#include "vectorstorm/matrix/matrix4.h"
+#include "vectorstorm/quat/quat.h"
+
+namespace render {
+
+class transforms {
+  /// Positions, rotations and scales of many objects in a parent hierarchy, stored as structure-of-arrays and composed into world matrices in SIMD batches
+  /// Only entries whose own transform or an ancestor's changed since the last update are recomposed, and each parent is added before its children, so one forward pass resolves the whole hierarchy
+public:
+  using handle = uint32_t;
+  static handle constexpr no_parent{std::numeric_limits<handle>::max()};
+
+private:
+  handle count{0};                                                              // entries in use - the arrays are padded beyond this to a whole number of batches with identity transforms
+
+  std::vector<float> position_x;
+  std::vector<float> position_y;
+  std::vector<float> position_z;
+  std::vector<float> rotation_x;                                                // unit quaternion, imaginary part
+  std::vector<float> rotation_y;
+  std::vector<float> rotation_z;
+  std::vector<float> rotation_w;                                                // unit quaternion, real part
+  std::vector<float> scale_x;
+  std::vector<float> scale_y;
+  std::vector<float> scale_z;
+
+  std::vector<handle> parents;                                                  // always less than the entry's own handle, or no_parent
+  std::vector<uint8_t> local_dirty;                                             // set when the entry's own position, rotation or scale changes
+  std::vector<uint8_t> world_changed;                                           // set by the last update for each entry whose world matrix it recomposed
+  std::vector<mat4f> world_matrices;
+  handle updated_count{0};                                                      // entries recomposed by the last update
+
+public:
+  handle add(handle parent = no_parent);
+  void clear();
+  handle size() const;
+
+  void set_position(handle entry, vec3f const &position);
+  void set_rotation(handle entry, quatf const &rotation);
+  void set_scale(handle entry, vec3f const &scale);
+
+  void update();
+
+  mat4f const &get_world_matrix(handle entry) const;
+  std::span<mat4f const> get_world_matrices() const;
+  bool was_updated(handle entry) const;
+  handle get_updated_count() const;
+};
+
+}
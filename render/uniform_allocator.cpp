@@ -0,0 +1,89 @@
+#include "uniform_allocator.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <stdexcept>
+
+namespace render {
+
+void uniform_allocator::init(wgpu::Device const &new_device,
+                             wgpu::BindGroupLayout const &new_layout,
+                             uint64_t const new_binding_size,
+                             unsigned int const initial_allocations) {
+  /// Create the buffer and its bind group, sized for a number of allocations per frame
+  device = new_device;
+  layout = new_layout;
+  binding_size = new_binding_size;
+
+  wgpu::SupportedLimits device_limits;
+  if(!device.GetLimits(&device_limits)) throw std::runtime_error{"WebGPU: Could not query device limits"};
+  alignment = device_limits.limits.minUniformBufferOffsetAlignment;
+
+  create_buffer(align(binding_size) * initial_allocations);
+  staging.reserve(static_cast<size_t>(capacity));
+}
+
+void uniform_allocator::begin_frame() {
+  /// Start packing a new frame's uniforms from the beginning of the staging area
+  staging.clear();
+}
+
+void uniform_allocator::flush(wgpu::Queue const &queue) {
+  /// Upload everything allocated this frame with one write, growing the buffer first if the frame outgrew it
+  if(staging.empty()) return;
+  if(staging.size() > capacity) {
+    create_buffer(align(std::bit_ceil(staging.size())));                        // grow geometrically, so a slowly growing count doesn't reallocate every frame
+  }
+  queue.WriteBuffer(
+    buffer,                                                                     // buffer
+    0,                                                                          // offset
+    staging.data(),                                                             // data
+    staging.size()                                                              // size
+  );
+}
+
+void uniform_allocator::bind(wgpu::RenderPassEncoder const &encoder, uint32_t const group_index, allocation const slice) const {
+  /// Bind the bind group at the offset of a slice allocated and flushed this frame
+  uint32_t const dynamic_offset{slice};
+  encoder.SetBindGroup(group_index, bind_group, 1, &dynamic_offset);            // groupIndex, group, dynamicOffsetCount, dynamicOffsets
+}
+
+uint64_t uniform_allocator::align(uint64_t const size) const {
+  /// Round a size up to the offset alignment
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+uniform_allocator::allocation uniform_allocator::reserve(uint64_t const size) {
+  /// Claim the next aligned slice of staging, large enough for both the data and the binding that reads it
+  assert(size <= binding_size);
+  uint64_t const offset{align(staging.size())};
+  staging.resize(static_cast<size_t>(offset + std::max(size, binding_size)));   // the gap up to the aligned offset is left zeroed
+  return static_cast<allocation>(offset);
+}
+
+void uniform_allocator::create_buffer(uint64_t const new_capacity) {
+  /// Create or recreate the buffer at the given size, and the bind group that views it
+  capacity = new_capacity;
+  wgpu::BufferDescriptor buffer_descriptor{
+    .label{"Uniform allocator buffer"},
+    .usage{wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Uniform},
+    .size{capacity},
+  };
+  buffer = device.CreateBuffer(&buffer_descriptor);
+
+  wgpu::BindGroupEntry bind_group_entry{
+    .binding{0},
+    .buffer{buffer},
+    .offset{0},                                                                 // the dynamic offset is added to this when binding
+    .size{binding_size},
+  };
+  wgpu::BindGroupDescriptor bind_group_descriptor{
+    .label{"Uniform allocator bind group"},
+    .layout{layout},
+    .entryCount{1},                                                             // must correspond to layout
+    .entries{&bind_group_entry},
+  };
+  bind_group = device.CreateBindGroup(&bind_group_descriptor);
+}
+
+}
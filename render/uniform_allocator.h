@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <webgpu/webgpu_cpp.h>
+
+namespace render {
+
+class uniform_allocator {
+  /// Per-frame linear allocator for uniform blocks: each frame's blocks are packed into aligned slices of one host staging area, uploaded with a single buffer write, and bound through one bind group with dynamic offsets
+  /// One region is rewritten every frame: Queue::WriteBuffer is ordered on the queue after the commands already submitted, so earlier frames read their own uniforms before the write lands
+public:
+  using allocation = uint32_t;                                                  // offset of a slice within the buffer
+
+private:
+  wgpu::Device device;
+  wgpu::BindGroupLayout layout;
+  uint64_t binding_size{0};                                                     // bytes visible to the shader at each offset
+  uint64_t alignment{256};                                                      // the device's minimum uniform buffer offset alignment
+
+  wgpu::Buffer buffer;
+  wgpu::BindGroup bind_group;
+  uint64_t capacity{0};                                                         // bytes in the buffer, grown geometrically as needed
+  std::vector<std::byte> staging;                                               // this frame's blocks at their aligned offsets, kept allocated between frames
+
+public:
+  void init(wgpu::Device const &device, wgpu::BindGroupLayout const &layout, uint64_t binding_size, unsigned int initial_allocations);
+
+  void begin_frame();
+  template<typename T>
+  allocation allocate(T const &data);
+  void flush(wgpu::Queue const &queue);
+  void bind(wgpu::RenderPassEncoder const &encoder, uint32_t group_index, allocation slice) const;
+
+private:
+  uint64_t align(uint64_t size) const;
+  allocation reserve(uint64_t size);
+  void create_buffer(uint64_t new_capacity);
+};
+
+template<typename T>
+uniform_allocator::allocation uniform_allocator::allocate(T const &data) {
+  /// Copy a uniform block into the next aligned slice of this frame, returning the slice to bind it from once flushed
+  static_assert(std::is_trivially_copyable_v<T>, "uniform blocks are copied bytewise");
+  allocation const slice{reserve(sizeof(T))};
+  std::memcpy(&staging[slice], &data, sizeof(T));
+  return slice;
+}
+
+}
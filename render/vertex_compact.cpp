@@ -0,0 +1,82 @@
+#include "vertex_compact.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace render {
+
+namespace {
+
+int16_t to_snorm16(float const value) {
+  /// Quantise a value in [-1, 1] to a signed normalised 16-bit integer
+  return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32'767.0f));
+}
+
+uint8_t to_unorm8(float const value) {
+  /// Quantise a value in [0, 1] to an unsigned normalised 8-bit integer
+  return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+}
+
+uint16_t pack_half(float const value) {
+  /// Convert to an IEEE half float, rounding to nearest even, with overflow to infinity and underflow through subnormals to zero
+  /// After Fabian Giesen's float_to_half_fast3_rtne
+  uint32_t constexpr float_infinity{255u << 23};
+  uint32_t constexpr half_overflow{(127u + 16u) << 23};                         // smallest float that rounds to half infinity
+  uint32_t constexpr half_normal_min{113u << 23};                               // smallest float that is a normal half
+  uint32_t constexpr subnormal_magic{((127u - 15u) + (23u - 10u) + 1u) << 23};  // adding this float aligns a subnormal's mantissa to the half's, letting the FPU round it
+
+  uint32_t bits{std::bit_cast<uint32_t>(value)};
+  auto const sign{static_cast<uint16_t>((bits >> 16) & 0x80'00u)};
+  bits &= 0x7f'ff'ff'ffu;
+
+  uint32_t half;
+  if(bits >= half_overflow) {
+    half = bits > float_infinity ? 0x7e'00u : 0x7c'00u;                         // NaN stays NaN, anything else becomes infinity
+  } else if(bits < half_normal_min) {
+    half = std::bit_cast<uint32_t>(std::bit_cast<float>(bits) + std::bit_cast<float>(subnormal_magic)) - subnormal_magic;
+  } else {
+    uint32_t const mantissa_odd{(bits >> 13) & 1u};
+    bits += ((15u - 127u) << 23) + 0xf'ffu;                                     // rebias the exponent and round half up...
+    bits += mantissa_odd;                                                       // ...or to even on a tie
+    half = bits >> 13;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+vec4<uint16_t> pack_position(vec3f const &position) {
+  /// Pack a position as half floats, accurate to about one part in 2000 of its magnitude
+  return {pack_half(position.x), pack_half(position.y), pack_half(position.z), pack_half(1.0f)};
+}
+
+vec2<int16_t> pack_normal(vec3f const &normal) {
+  /// Octahedral encoding: project the unit normal onto an octahedron, then fold the lower half out over the upper so the whole sphere covers a square
+  /// Unlike quantising x, y and z separately, precision is spread almost evenly over every direction
+  float const length_l1{std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z)};
+  if(length_l1 <= 0.0f) return {0, 0};                                          // a zero normal has no direction, so decodes as +z
+  vec2f projected{normal.x / length_l1, normal.y / length_l1};
+  if(normal.z < 0.0f) {
+    projected = {
+      (1.0f - std::abs(projected.y)) * std::copysign(1.0f, projected.x),
+      (1.0f - std::abs(projected.x)) * std::copysign(1.0f, projected.y),
+    };
+  }
+  return {to_snorm16(projected.x), to_snorm16(projected.y)};
+}
+
+vec4<uint8_t> pack_colour(vec4f const &colour) {
+  /// Pack a colour with 8 bits per channel
+  return {to_unorm8(colour.r), to_unorm8(colour.g), to_unorm8(colour.b), to_unorm8(colour.a)};
+}
+
+vertex_compact pack_vertex(vertex const &source) {
+  /// Pack a full precision vertex into the compact format
+  return {
+    .position{pack_position(source.position)},
+    .normal{pack_normal(source.normal)},
+    .colour{pack_colour(source.colour)},
+  };
+}
+
+}
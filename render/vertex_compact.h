@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include "vectorstorm/vector/vector2.h"
+#include "vectorstorm/vector/vector3.h"
+#include "vectorstorm/vector/vector4.h"
+#include "vertex.h"
+
+struct vertex_compact {                                                         // 16 bytes against 40 for a full vertex, decoded by vs_main_compact
+  vec4<uint16_t> position;                                                      // half floats, Float16x4 with w unused
+  vec2<int16_t> normal;                                                         // octahedral encoding, Snorm16x2
+  vec4<uint8_t> colour;                                                         // Unorm8x4
+};
+static_assert(sizeof(vertex_compact) == sizeof(vertex_compact::position) + sizeof(vertex_compact::normal) + sizeof(vertex_compact::colour)); // make sure the struct is packed
+
+namespace render {
+
+uint16_t pack_half(float value);
+vec4<uint16_t> pack_position(vec3f const &position);
+vec2<int16_t> pack_normal(vec3f const &normal);
+vec4<uint8_t> pack_colour(vec4f const &colour);
+vertex_compact pack_vertex(vertex const &source);
+
+}
@@ -1,6 +1,8 @@
 #include "webgpu_renderer.h"
 #include "logstorm/manager.h"
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <set>
 #include <string>
 #include <vector>
@@ -10,6 +12,7 @@
 #include <imgui/imgui_impl_wgpu.h>
 #include <magic_enum/magic_enum.hpp>
 #include "vertex.h"
+#include "vertex_compact.h"
 #include "triangle_index.h"
 #include "uniforms.h"
 #include "shaders/default.wgsl.h"
@@ -92,7 +95,8 @@ std::string enum_wgpu_name(Tcpp enum_in) {
 }
 
 webgpu_renderer::webgpu_renderer(logstorm::manager &this_logger)
-  : logger{this_logger} {
+  : logger{this_logger},
+    pipelines{this_logger} {
   /// Construct a WebGPU renderer and populate those members that don't require delayed init
   if(!webgpu.instance) throw std::runtime_error{"Could not initialize WebGPU"};
 
@@ -118,11 +122,15 @@ webgpu_renderer::webgpu_renderer(logstorm::manager &this_logger)
   state = states::ready_to_init;
 }
 
-void webgpu_renderer::init(std::function<void(webgpu_data const&)> &&this_postinit_callback, std::function<void()> &&this_main_loop_callback) {
+void webgpu_renderer::init(std::function<void(webgpu_data const&)> &&this_postinit_callback,
+                           std::function<void()> &&this_main_loop_callback,
+                           std::function<void(std::string_view)> &&this_startup_phase_callback) {
   /// Initialise the WebGPU system
   assert(state == states::ready_to_init);
   postinit_callback = this_postinit_callback;
   main_loop_callback = this_main_loop_callback;
+  startup_phase_callback = this_startup_phase_callback;
+  mark_startup_phase("WebGPU: requesting adapter");
 
   {
     // request an adapter
@@ -147,6 +155,7 @@ void webgpu_renderer::init(std::function<void(webgpu_data const&)> &&this_postin
         auto &adapter{webgpu.adapter};
         adapter = wgpu::Adapter::Acquire(adapter_ptr);
         if(!adapter) throw std::runtime_error{"WebGPU: Could not acquire adapter"};
+        renderer.mark_startup_phase("WebGPU: adapter acquired");
 
         // report surface and adapter capabilities
         #ifdef DEBUG_WEBGPU
@@ -259,15 +268,13 @@ void webgpu_renderer::init(std::function<void(webgpu_data const&)> &&this_postin
         // specify required features for the device
         std::set<wgpu::FeatureName> required_features{
           wgpu::FeatureName::Depth32FloatStencil8,
-          #ifndef NDEBUG
-            wgpu::FeatureName::TimestampQuery,
-          #endif // NDEBUG
           wgpu::FeatureName::TextureCompressionBC,
           wgpu::FeatureName::IndirectFirstInstance,
         };
         std::set<wgpu::FeatureName> desired_features{
           wgpu::FeatureName::ShaderF16,
           wgpu::FeatureName::Float32Filterable,
+          wgpu::FeatureName::TimestampQuery,                                    // for the GPU profiler, which falls back to CPU timings without it
         };
 
         std::vector<wgpu::FeatureName> required_features_arr;
@@ -416,6 +423,7 @@ void webgpu_renderer::init(std::function<void(webgpu_data const&)> &&this_postin
             }
             auto &device{webgpu.device};
             device = wgpu::Device::Acquire(device_ptr);
+            renderer.mark_startup_phase("WebGPU: device acquired");
 
             // report device capabilities
             std::set<wgpu::FeatureName> device_features;
@@ -485,6 +493,7 @@ void webgpu_renderer::init(std::function<void(webgpu_data const&)> &&this_postin
             );
 
             renderer.state = states::ready_to_configure;
+            renderer.wait_to_configure_loop();                                  // configure immediately, rather than waiting up to a frame for the polling loop to notice
           },
           data
         );
@@ -501,6 +510,11 @@ void webgpu_renderer::init(std::function<void(webgpu_data const&)> &&this_postin
   }, this, 0, false);                                                           // loop function, user data, FPS (0 to use browser requestAnimationFrame mechanism), don't simulate infinite loop
 }
 
+void webgpu_renderer::mark_startup_phase(std::string_view const name) const {
+  /// Notify the startup trace, if any, that an initialisation stage has completed
+  if(startup_phase_callback) startup_phase_callback(name);
+}
+
 void webgpu_renderer::init_swapchain() {
   /// Create or recreate the swapchain for the current viewport size
   wgpu::SwapChainDescriptor swapchain_descriptor{
@@ -545,6 +559,84 @@ void webgpu_renderer::init_depth_texture() {
   }
 }
 
+void webgpu_renderer::init_scene() {
+  /// Upload the static geometry once, and create the uniform allocator and instance buffer, so drawing a frame allocates nothing
+  std::array<vertex, 8> const vertex_data{{
+    {{-1.0f, -1.0f, -1.0f}, { 0.0f, -1.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}},  // bottom face normal & colour
+    {{+1.0f, -1.0f, -1.0f}, {+1.0f,  0.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}},  // right face normal & colour
+    {{+1.0f, +1.0f, -1.0f}, { 0.0f,  0.0f, -1.0f}, {1.0f, 0.75f, 0.0f, 1.0f}},  // front face normal & colour
+    {{-1.0f, +1.0f, -1.0f}, {-1.0f,  0.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}},  // left face normal & colour
+    {{-1.0f, -1.0f, +1.0f}, { 0.0f,  0.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}},  // normal & colour not used
+    {{+1.0f, -1.0f, +1.0f}, { 0.0f,  0.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}},  // normal & colour not used
+    {{+1.0f, +1.0f, +1.0f}, { 0.0f, +1.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}},  // top face normal & colour
+    {{-1.0f, +1.0f, +1.0f}, { 0.0f,  0.0f, +1.0f}, {1.0f, 0.75f, 0.0f, 1.0f}},  // back face normal & colour
+  }};
+  std::array<triangle_index, 12> const index_data{{
+    {0, 1, 5}, {0, 5, 4},                                                       // bottom face (y = -1)
+    {1, 6, 5}, {1, 2, 6},                                                       // right face (x = +1)
+    {2, 1, 0}, {2, 0, 3},                                                       // front face (z = -1)
+    {3, 0, 4}, {3, 4, 7},                                                       // left face (x = -1)
+    {6, 3, 7}, {6, 2, 3},                                                       // top face (y = +1)
+    {7, 4, 5}, {7, 5, 6},                                                       // back face (z = +1)
+  }};
+  static_assert(sizeof(index_data) % 4 == 0, "buffer writes must be a multiple of four bytes, so pad uint16 index data to an even number of triangles");
+  scene.index_count = static_cast<uint32_t>(index_data.size() * triangle_index::size());
+
+  // vertex buffer, in whichever vertex format the scene is drawn with
+  {
+    std::array<vertex_compact, vertex_data.size()> vertex_data_compact;
+    std::span<std::byte const> vertex_bytes{std::as_bytes(std::span{vertex_data})};
+    if(scene.vertex_format == vertex_formats::compact) {
+      std::ranges::transform(vertex_data, vertex_data_compact.begin(), pack_vertex);
+      vertex_bytes = std::as_bytes(std::span{vertex_data_compact});
+    }
+
+    wgpu::BufferDescriptor vertex_buffer_descriptor{
+      .label{"Vertex buffer 1"},
+      .usage{wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex},
+      .size{vertex_bytes.size()},
+    };
+    scene.vertex_buffer = webgpu.device.CreateBuffer(&vertex_buffer_descriptor);
+    webgpu.queue.WriteBuffer(
+      scene.vertex_buffer,                                                      // buffer
+      0,                                                                        // offset
+      vertex_bytes.data(),                                                      // data
+      vertex_bytes.size()                                                       // size
+    );
+  }
+
+  // index buffer
+  {
+    wgpu::BufferDescriptor index_buffer_descriptor{
+      .label{"Index buffer 1"},
+      .usage{wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Index},
+      .size{sizeof(index_data)},
+    };
+    scene.index_buffer = webgpu.device.CreateBuffer(&index_buffer_descriptor);
+    webgpu.queue.WriteBuffer(
+      scene.index_buffer,                                                       // buffer
+      0,                                                                        // offset
+      index_data.data(),                                                        // data
+      sizeof(index_data)                                                        // size
+    );
+  }
+
+  scene.frame_uniforms.init(webgpu.device, webgpu.bind_group_layout, sizeof(uniforms), 64); // room for 64 uniform blocks a frame before growing
+
+  init_instance_buffer(1024);
+}
+
+void webgpu_renderer::init_instance_buffer(uint32_t const capacity) {
+  /// Create or recreate the instance buffer to hold the given number of instances
+  wgpu::BufferDescriptor instance_buffer_descriptor{
+    .label{"Instance buffer 1"},
+    .usage{wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex},
+    .size{capacity * sizeof(instance)},
+  };
+  scene.instance_buffer = webgpu.device.CreateBuffer(&instance_buffer_descriptor);
+  scene.instance_capacity = capacity;
+}
+
 void webgpu_renderer::wait_to_configure_loop() {
   /// Check if initialisation has completed and the WebGPU system is ready for configuration
   /// Since init occurs asynchronously, some emscripten ticks are needed before this becomes true
@@ -556,10 +648,12 @@ void webgpu_renderer::wait_to_configure_loop() {
   emscripten_cancel_main_loop();
 
   configure();
+  mark_startup_phase("WebGPU: configured");
 
   if(postinit_callback) {
     logger << "WebGPU: Configuration complete, running post-init tasks";
     postinit_callback(webgpu);                                                  // perform any user-provided post-init tasks before launching the main loop
+    mark_startup_phase("WebGPU: post-init tasks complete");
   }
 
   logger << "WebGPU: Launching main loop";
@@ -593,13 +687,8 @@ void webgpu_renderer::configure() {
 
   logger << "WebGPU assembling shaders";
   {
-    wgpu::ShaderModuleWGSLDescriptor shader_module_wgsl_decriptor;
-    shader_module_wgsl_decriptor.code = render::shaders::default_wgsl;
-    wgpu::ShaderModuleDescriptor shader_module_descriptor{
-      .nextInChain{&shader_module_wgsl_decriptor},
-      .label{"Shader module 1"},
-    };
-    wgpu::ShaderModule shader_module{webgpu.device.CreateShaderModule(&shader_module_descriptor)};
+    pipelines.init(webgpu.device);
+    wgpu::ShaderModule const &shader_module{pipelines.get_shader_module(render::shaders::default_wgsl, "Shader module 1")};
 
     logger << "WebGPU configuring pipeline";
 
@@ -620,10 +709,63 @@ void webgpu_renderer::configure() {
         .shaderLocation{2},
       },
     };
-    wgpu::VertexBufferLayout vertex_buffer_layout{
-      .arrayStride{sizeof(vertex)},
-      .attributeCount{vertex_attributes.size()},
-      .attributes{vertex_attributes.data()},
+    std::array vertex_attributes_compact{
+      wgpu::VertexAttribute{
+        .format{wgpu::VertexFormat::Float16x4},
+        .offset{offsetof(vertex_compact, position)},
+        .shaderLocation{0},
+      },
+      wgpu::VertexAttribute{
+        .format{wgpu::VertexFormat::Snorm16x2},
+        .offset{offsetof(vertex_compact, normal)},
+        .shaderLocation{1},
+      },
+      wgpu::VertexAttribute{
+        .format{wgpu::VertexFormat::Unorm8x4},
+        .offset{offsetof(vertex_compact, colour)},
+        .shaderLocation{2},
+      },
+    };
+    std::array instance_attributes{
+      wgpu::VertexAttribute{                                                    // a mat4x4f attribute takes four locations, one per column
+        .format{wgpu::VertexFormat::Float32x4},
+        .offset{offsetof(instance, model_matrix) + 0 * sizeof(vec4f)},
+        .shaderLocation{3},
+      },
+      wgpu::VertexAttribute{
+        .format{wgpu::VertexFormat::Float32x4},
+        .offset{offsetof(instance, model_matrix) + 1 * sizeof(vec4f)},
+        .shaderLocation{4},
+      },
+      wgpu::VertexAttribute{
+        .format{wgpu::VertexFormat::Float32x4},
+        .offset{offsetof(instance, model_matrix) + 2 * sizeof(vec4f)},
+        .shaderLocation{5},
+      },
+      wgpu::VertexAttribute{
+        .format{wgpu::VertexFormat::Float32x4},
+        .offset{offsetof(instance, model_matrix) + 3 * sizeof(vec4f)},
+        .shaderLocation{6},
+      },
+      wgpu::VertexAttribute{
+        .format{wgpu::VertexFormat::Float32x4},
+        .offset{offsetof(instance, colour)},
+        .shaderLocation{7},
+      },
+    };
+    std::array vertex_buffer_layouts{
+      wgpu::VertexBufferLayout{                                                 // slot 0: the mesh, stepped per vertex
+        .arrayStride{sizeof(vertex)},
+        .stepMode{wgpu::VertexStepMode::Vertex},
+        .attributeCount{vertex_attributes.size()},
+        .attributes{vertex_attributes.data()},
+      },
+      wgpu::VertexBufferLayout{                                                 // slot 1: instances, stepped once per instance
+        .arrayStride{sizeof(instance)},
+        .stepMode{wgpu::VertexStepMode::Instance},
+        .attributeCount{instance_attributes.size()},
+        .attributes{instance_attributes.data()},
+      },
     };
 
     wgpu::BlendState blend_state{
@@ -668,6 +810,7 @@ void webgpu_renderer::configure() {
       .visibility{wgpu::ShaderStage::Vertex},
       .buffer{                                                                  // BufferBindingLayout
         .type{wgpu::BufferBindingType::Uniform},
+        .hasDynamicOffset{true},                                                // bound at an offset into the uniform allocator's buffer
         .minBindingSize{sizeof(uniforms)},
       },
       .sampler{},                                                               // SamplerBindingLayout
@@ -696,8 +839,8 @@ void webgpu_renderer::configure() {
         .entryPoint{"vs_main"},
         .constantCount{0},
         .constants{nullptr},
-        .bufferCount{1},
-        .buffers{&vertex_buffer_layout},
+        .bufferCount{vertex_buffer_layouts.size()},
+        .buffers{vertex_buffer_layouts.data()},
       },
       .primitive{                                                               // PrimitiveState
         .cullMode{wgpu::CullMode::Back},
@@ -706,9 +849,26 @@ void webgpu_renderer::configure() {
       .multisample{},
       .fragment{&fragment_state},
     };
-    webgpu.pipeline = webgpu.device.CreateRenderPipeline(&render_pipeline_descriptor);
+    if(scene.vertex_format == vertex_formats::compact) {
+      // the compact vertex format variant differs only in its mesh layout and the vertex entry point that decodes it
+      vertex_buffer_layouts[0] = {
+        .arrayStride{sizeof(vertex_compact)},
+        .stepMode{wgpu::VertexStepMode::Vertex},
+        .attributeCount{vertex_attributes_compact.size()},
+        .attributes{vertex_attributes_compact.data()},
+      };
+      render_pipeline_descriptor.label = "Render pipeline compact";
+      render_pipeline_descriptor.vertex.entryPoint = "vs_main_compact";
+    }
+    scene.pipeline = pipelines.request(render_pipeline_descriptor);             // only the variant the scene draws with is built, and the first frames draw without it until it's ready
   }
 
+  logger << "WebGPU creating scene buffers";
+  init_scene();
+
+  logger << "WebGPU initialising profiler";
+  profiler.init(webgpu.device);
+
   logger << "WebGPU creating depth texture";
   init_depth_texture();
 
@@ -720,6 +880,7 @@ void webgpu_renderer::configure() {
 
       renderer.init_swapchain();
       renderer.init_depth_texture();
+      renderer.invalidation.invalidate(frame_invalidation::reasons::resize);
       return true;                                                              // the event was consumed
     })
   );
@@ -727,6 +888,25 @@ void webgpu_renderer::configure() {
   state = states::ready_to_draw;
 }
 
+void webgpu_renderer::set_instances(std::span<instance const> const instances) {
+  /// Replace the set of instances drawn each frame, uploading them all at once - the cost scales with the data, not the number of objects
+  assert(state == states::ready_to_draw);
+  auto const count{static_cast<uint32_t>(instances.size())};
+  if(count > scene.instance_capacity) {
+    logger << "WebGPU: Growing instance buffer to hold " << std::bit_ceil(count) << " instances";
+    init_instance_buffer(std::bit_ceil(count));                                 // grow geometrically, so a slowly growing count doesn't reallocate every frame
+  }
+  if(count != 0) {
+    webgpu.queue.WriteBuffer(
+      scene.instance_buffer,                                                    // buffer
+      0,                                                                        // offset
+      instances.data(),                                                         // data
+      instances.size_bytes()                                                    // size
+    );
+  }
+  scene.instance_count = count;
+}
+
 void webgpu_renderer::draw() {
   /// Draw a frame
   assert(state == states::ready_to_draw);
@@ -739,8 +919,11 @@ void webgpu_renderer::draw() {
     };
     wgpu::CommandEncoder command_encoder{webgpu.device.CreateCommandEncoder(&command_encoder_descriptor)};
 
+    profiler.begin_frame();
+    bool const separate_gui_pass{profiler.is_enabled()};                        // the GUI only gets a pass of its own when profiling, so it can be timed apart from the scene
+
     {
-      // set up render pass
+      // set up scene render pass
       wgpu::RenderPassColorAttachment render_pass_colour_attachment{
         .view{texture_view},
         .loadOp{wgpu::LoadOp::Clear},
@@ -751,126 +934,70 @@ void webgpu_renderer::draw() {
       wgpu::RenderPassDepthStencilAttachment render_pass_depth_stencil_attachment{
         .view{webgpu.depth_texture_view},
         .depthLoadOp{wgpu::LoadOp::Clear},
-        .depthStoreOp{wgpu::StoreOp::Store},
+        .depthStoreOp{wgpu::StoreOp::Discard},                                  // nothing reads depth after this pass
         .depthClearValue{1.0f},
       };
       wgpu::RenderPassDescriptor render_pass_descriptor{
-        .label{"Render pass 1"},
+        .label{"Scene render pass"},
         .colorAttachmentCount{1},
         .colorAttachments{&render_pass_colour_attachment},
         .depthStencilAttachment{&render_pass_depth_stencil_attachment},
+        .timestampWrites{profiler.begin_pass(gpu_profiler::passes::scene)},
       };
       wgpu::RenderPassEncoder render_pass_encoder{command_encoder.BeginRenderPass(&render_pass_descriptor)};
 
-      render_pass_encoder.SetPipeline(webgpu.pipeline);                         // select which render pipeline to use
-
-      // set up test buffers
-      std::vector<vertex> vertex_data{
-        {{-1.0f, -1.0f, -1.0f}, { 0.0f, -1.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}}, // bottom face normal & colour
-        {{+1.0f, -1.0f, -1.0f}, {+1.0f,  0.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}}, // right face normal & colour
-        {{+1.0f, +1.0f, -1.0f}, { 0.0f,  0.0f, -1.0f}, {1.0f, 0.75f, 0.0f, 1.0f}}, // front face normal & colour
-        {{-1.0f, +1.0f, -1.0f}, {-1.0f,  0.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}}, // left face normal & colour
-        {{-1.0f, -1.0f, +1.0f}, { 0.0f,  0.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}}, // normal & colour not used
-        {{+1.0f, -1.0f, +1.0f}, { 0.0f,  0.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}}, // normal & colour not used
-        {{+1.0f, +1.0f, +1.0f}, { 0.0f, +1.0f,  0.0f}, {1.0f, 0.75f, 0.0f, 1.0f}}, // top face normal & colour
-        {{-1.0f, +1.0f, +1.0f}, { 0.0f,  0.0f, +1.0f}, {1.0f, 0.75f, 0.0f, 1.0f}}, // back face normal & colour
-      };
-      std::vector<triangle_index> index_data{
-        {0, 1, 5}, {0, 5, 4},                                                   // bottom face (y = -1)
-        {1, 6, 5}, {1, 2, 6},                                                   // right face (x = +1)
-        {2, 1, 0}, {2, 0, 3},                                                   // front face (z = -1)
-        {3, 0, 4}, {3, 4, 7},                                                   // left face (x = -1)
-        {6, 3, 7}, {6, 2, 3},                                                   // top face (y = +1)
-        {7, 4, 5}, {7, 5, 6},                                                   // back face (z = +1)
+      uniforms uniform_data{
+        get_view_projection_matrix(),
       };
 
-      // set up matrices
-      static vec2f angles;
-      angles.x += 0.01f;                                                        // constant slow spin
-      quatf model_rotation{quatf::from_euler_angles_rad(0.0, angles.x, 0.0)};
+      // pack this frame's uniforms and upload them in one write, then bind the persistent geometry and instances
+      scene.frame_uniforms.begin_frame();
+      auto const view_uniforms{scene.frame_uniforms.allocate(uniform_data)};
+      scene.frame_uniforms.flush(webgpu.queue);
+
+      if(auto const *pipeline{pipelines.get(scene.pipeline)}; pipeline && scene.instance_count != 0) { // until the pipeline finishes compiling, the pass just clears
+        render_pass_encoder.SetPipeline(*pipeline);                             // select which render pipeline to use
+        render_pass_encoder.SetVertexBuffer(0, scene.vertex_buffer, 0, scene.vertex_buffer.GetSize()); // slot, buffer, offset, size
+        render_pass_encoder.SetIndexBuffer(scene.index_buffer, wgpu::IndexFormat::Uint16, 0, scene.index_buffer.GetSize()); // buffer, format, offset, size
+        scene.frame_uniforms.bind(render_pass_encoder, 0, view_uniforms);       // each further object with its own uniforms costs one allocation and one rebind here
+        render_pass_encoder.SetVertexBuffer(1, scene.instance_buffer, 0, scene.instance_count * sizeof(instance)); // slot, buffer, offset, size
+        render_pass_encoder.DrawIndexed(scene.index_count, scene.instance_count); // indexCount, instanceCount, firstIndex = 0, baseVertex = 0, firstInstance = 0
+      } else if(pipelines.get_state(scene.pipeline) == pipeline_cache::states::pending) {
+        invalidation.invalidate(frame_invalidation::reasons::resources);        // keep drawing until the pipeline is ready, so the scene appears as soon as it can
+      }
+
+      if(!separate_gui_pass) {
+        ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), render_pass_encoder.Get()); // render the outstanding GUI draw data over the scene
+      }
 
-      vec3f camera_pos{0.0f, 2.0f, -5.0f};
-      camera_pos.rotate_rad_x(angles.y);
-
-      mat4f projection{make_projection_matrix(static_cast<vec2f>(window.viewport_size))};
-      mat4f look_at{mat4f::create_look_at(
-        camera_pos,                                                             // eye pos
-        {0.0f, 0.0f, 0.0f},                                                     // target pos
-        {0.0f, 1.0f, 0.0f}                                                      // up dir
-      )};
+      render_pass_encoder.End();
+      profiler.end_pass(gpu_profiler::passes::scene);
+    }
 
-      uniforms uniform_data{
-        projection * look_at * model_rotation.transform(),
-        mat3fwgpu{model_rotation.rotmatrix()},
+    if(separate_gui_pass) {
+      // set up GUI render pass, drawing over the scene in its own pass so it can be timed separately - without depth, which the GUI doesn't test against
+      wgpu::RenderPassColorAttachment render_pass_colour_attachment{
+        .view{texture_view},
+        .loadOp{wgpu::LoadOp::Load},
+        .storeOp{wgpu::StoreOp::Store},
       };
 
-      // vertex buffer
-      wgpu::BufferDescriptor vertex_buffer_descriptor{
-        .label{"Vertex buffer 1"},
-        .usage{wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex},
-        .size{vertex_data.size() * sizeof(vertex_data[0])},
-      };
-      wgpu::Buffer vertex_buffer{webgpu.device.CreateBuffer(&vertex_buffer_descriptor)};
-      webgpu.queue.WriteBuffer(
-        vertex_buffer,                                                          // buffer
-        0,                                                                      // offset
-        vertex_data.data(),                                                     // data
-        vertex_data.size() * sizeof(vertex_data[0])                             // size
-      );
-
-      // index buffer
-      wgpu::BufferDescriptor index_buffer_descriptor{
-        .label{"Index buffer 1"},
-        .usage{wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Index},
-        .size{index_data.size() * sizeof(index_data[0])},
-      };
-      wgpu::Buffer index_buffer{webgpu.device.CreateBuffer(&index_buffer_descriptor)};
-      webgpu.queue.WriteBuffer(
-        index_buffer,                                                           // buffer
-        0,                                                                      // offset
-        index_data.data(),                                                      // data
-        index_data.size() * sizeof(index_data[0])                               // size
-      );
-
-      // uniform buffer
-      wgpu::BufferDescriptor uniform_buffer_desecriptor{
-        .label{"Uniform buffer 1"},
-        .usage{wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Uniform},
-        .size{sizeof(uniform_data)},
-      };
-      wgpu::Buffer uniform_buffer{webgpu.device.CreateBuffer(&uniform_buffer_desecriptor)};
-      webgpu.queue.WriteBuffer(
-        uniform_buffer,                                                         // buffer
-        0,                                                                      // offset
-        &uniform_data,                                                          // data
-        sizeof(uniform_data)                                                    // size
-      );
-
-      // uniform bind group
-      wgpu::BindGroupEntry bind_group_entry{
-        .binding{0},
-        .buffer{uniform_buffer},
-        .size{sizeof(uniforms)},
-      };
-      wgpu::BindGroupDescriptor bind_group_descriptor{
-        .label{"Bind group 1"},
-        .layout{webgpu.bind_group_layout},
-        .entryCount{1},                                                         // must correspond to layout
-        .entries{&bind_group_entry},
+      wgpu::RenderPassDescriptor render_pass_descriptor{
+        .label{"GUI render pass"},
+        .colorAttachmentCount{1},
+        .colorAttachments{&render_pass_colour_attachment},
+        .timestampWrites{profiler.begin_pass(gpu_profiler::passes::gui)},
       };
-      wgpu::BindGroup bind_group{webgpu.device.CreateBindGroup(&bind_group_descriptor)};
-
-      render_pass_encoder.SetVertexBuffer(0, vertex_buffer, 0, vertex_buffer.GetSize()); // slot, buffer, offset, size
-      render_pass_encoder.SetIndexBuffer(index_buffer, wgpu::IndexFormat::Uint16, 0, index_buffer.GetSize()); // buffer, format, offset, size
-      render_pass_encoder.SetBindGroup(0, bind_group);                          // groupIndex, group, dynamicOffsetCount = 0, dynamicOffsets = nullptr
-      render_pass_encoder.DrawIndexed(index_data.size() * decltype(index_data)::value_type::size()); // indexCount, instanceCount = 1, firstIndex = 0, baseVertex = 0, firstInstance = 0
+      wgpu::RenderPassEncoder render_pass_encoder{command_encoder.BeginRenderPass(&render_pass_descriptor)};
 
-      ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), render_pass_encoder.Get()); // render the outstanding GUI draw data
+      ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), render_pass_encoder.Get(), false); // render the outstanding GUI draw data, with the GUI pipeline built without depth
 
-      // TODO: add timestamp query: https://eliemichel.github.io/LearnWebGPU/advanced-techniques/benchmarking/time.html
       render_pass_encoder.End();
+      profiler.end_pass(gpu_profiler::passes::gui);
     }
 
+    profiler.end_frame(command_encoder);
+
     command_encoder.InsertDebugMarker("Debug marker 1");
 
     wgpu::CommandBufferDescriptor command_buffer_descriptor {
@@ -892,9 +1019,30 @@ void webgpu_renderer::draw() {
     //);
 
     webgpu.queue.Submit(1, &command_buffer);
+    profiler.after_submit();
   }
 }
 
+mat4f webgpu_renderer::get_view_projection_matrix() const {
+  /// Combined camera and projection matrix for the current viewport, as the scene is drawn with
+  vec3f const camera_pos{0.0f, 2.0f, -5.0f};
+
+  mat4f projection{make_projection_matrix(static_cast<vec2f>(window.viewport_size))};
+  mat4f look_at{mat4f::create_look_at(
+    camera_pos,                                                                 // eye pos
+    {0.0f, 0.0f, 0.0f},                                                         // target pos
+    {0.0f, 1.0f, 0.0f}                                                          // up dir
+  )};
+  return projection * look_at;
+}
+
+gpu_profiler &webgpu_renderer::get_profiler() {
+  return profiler;
+}
+frame_invalidation &webgpu_renderer::get_invalidation() {
+  return invalidation;
+}
+
 wgpu::Device const &webgpu_renderer::get_device() const {
   assert(state == states::ready_to_draw);
   return webgpu.device;
@@ -1,10 +1,19 @@
 #pragma once
 
+#include <array>
 #include <functional>
+#include <span>
+#include <string_view>
 #include <emscripten/em_types.h>
 #include <webgpu/webgpu_cpp.h>
 #include "logstorm/logstorm_forward.h"
+#include "vectorstorm/matrix/matrix4.h"
 #include "vectorstorm/vector/vector2.h"
+#include "frame_invalidation.h"
+#include "gpu_profiler.h"
+#include "instance.h"
+#include "pipeline_cache.h"
+#include "uniform_allocator.h"
 
 namespace render {
 
@@ -19,7 +28,6 @@ public:
     wgpu::Device device;                                                        // WebGPU device once it has been acquired
     wgpu::Queue queue;                                                          // the queue for this device, once it has been acquired
     wgpu::BindGroupLayout bind_group_layout;                                    // layout for the uniform bind group
-    wgpu::RenderPipeline pipeline;                                              // the render pipeline currently in use
 
     wgpu::SwapChain swapchain;                                                  // the swapchain providing a texture view to render to
 
@@ -45,23 +53,51 @@ public:
 
 private:
   webgpu_data webgpu;
+  pipeline_cache pipelines;
 
   struct window_data {
     vec2ui viewport_size;                                                       // our idea of the size of the viewport we render to, in real pixels
     float device_pixel_ratio{1.0f};
   } window;
 
+  enum class vertex_formats : uint8_t {
+    full,                                                                       // struct vertex, all floats
+    compact,                                                                    // struct vertex_compact, under half the size
+  };
+
+  struct scene_data {                                                           // GPU resources created once at configure time and reused every frame
+    vertex_formats vertex_format{vertex_formats::compact};
+    pipeline_cache::key pipeline{0};                                            // the pipeline matching the vertex format
+    wgpu::Buffer vertex_buffer;
+    wgpu::Buffer index_buffer;
+    uint32_t index_count{0};
+    uniform_allocator frame_uniforms;                                           // every uniform block drawn this frame, uploaded together and bound by dynamic offset
+    wgpu::Buffer instance_buffer;                                               // per-instance transforms and colours, rewritten in one upload whenever they change
+    uint32_t instance_capacity{0};                                              // instances the buffer can hold, grown geometrically as needed
+    uint32_t instance_count{0};
+  } scene;
+
+  gpu_profiler profiler;
+  frame_invalidation invalidation;                                              // whether the next frame needs drawing, marked dirty here on resize and while the scene is loading
+
   std::function<void(webgpu_data const&)> postinit_callback;                    // the callback that is called once when init completes (it cannot return normally because of emscripten's loop mechanism)
   std::function<void()> main_loop_callback;                                     // the callback that is called repeatedly for the main loop after init
+  std::function<void(std::string_view)> startup_phase_callback;                 // optional callback notified as each asynchronous init stage completes, for startup tracing
 
 public:
   webgpu_renderer(logstorm::manager &logger);
 
-  void init(std::function<void(webgpu_data const&)> &&postinit_callback, std::function<void()> &&main_loop_callback);
+  void init(std::function<void(webgpu_data const&)> &&postinit_callback,
+            std::function<void()> &&main_loop_callback,
+            std::function<void(std::string_view)> &&startup_phase_callback = {});
 
 private:
+  void mark_startup_phase(std::string_view name) const;
+
   void init_swapchain();
   void init_depth_texture();
+  void init_scene();
+  void init_instance_buffer(uint32_t capacity);
 
   void wait_to_configure_loop();
   void configure();
@@ -69,8 +105,12 @@ private:
   void update_imgui_size();
 
 public:
+  void set_instances(std::span<instance const> instances);
   void draw();
 
+  mat4f get_view_projection_matrix() const;
+  gpu_profiler &get_profiler();
+  frame_invalidation &get_invalidation();
   wgpu::Device const &get_device() const;
   wgpu::TextureFormat get_surface_preferred_format() const;
   wgpu::TextureFormat get_depth_texture_format() const;
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#if defined(__wasm_simd128__)
+  #include <wasm_simd128.h>
+#elif defined(__AVX__)
+  #include <immintrin.h>
+#elif defined(__SSE4_1__)
+  #include <smmintrin.h>
+#elif defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+namespace simd {
+
+/// Widest float vector available on the target, with the minimal set of operations needed by the audio and render kernels
+/// Selection order prefers native wasm simd128 over Emscripten's SSE/AVX emulation, then AVX, then SSE2, then scalar
+#if defined(__wasm_simd128__)
+  using native_type = v128_t;
+  size_t constexpr width{4};
+#elif defined(__AVX__)
+  using native_type = __m256;
+  size_t constexpr width{8};
+#elif defined(__SSE2__)
+  using native_type = __m128;
+  size_t constexpr width{4};
+#else
+  #warning "No SIMD instruction set available, SIMD kernels will use scalar code - check your compilation flags."
+  using native_type = float;
+  size_t constexpr width{1};
+#endif
+
+/// Unsigned 32-bit integer lanes, as many as the float batch has, for counter-based generators and other bit manipulation
+/// AVX without AVX2 has no 256-bit integer operations, so there the lanes are handled as two SSE halves
+#if defined(__wasm_simd128__)
+  using native_uint_type = v128_t;
+#elif defined(__AVX2__)
+  using native_uint_type = __m256i;
+#elif defined(__AVX__)
+  struct native_uint_type {
+    __m128i low;
+    __m128i high;
+  };
+#elif defined(__SSE2__)
+  using native_uint_type = __m128i;
+#else
+  using native_uint_type = uint32_t;
+#endif
+
+struct batch {
+  native_type value;
+};
+
+struct uint_batch {
+  native_uint_type value;
+};
+
+inline batch load(float const *source) noexcept __attribute__((__always_inline__));
+inline batch load(float const *source) noexcept {
+  /// Unaligned load of width consecutive floats
+  #if defined(__wasm_simd128__)
+    return {wasm_v128_load(source)};
+  #elif defined(__AVX__)
+    return {_mm256_loadu_ps(source)};
+  #elif defined(__SSE2__)
+    return {_mm_loadu_ps(source)};
+  #else
+    return {*source};
+  #endif
+}
+
+inline void store(float *destination, batch const source) noexcept __attribute__((__always_inline__));
+inline void store(float *destination, batch const source) noexcept {
+  /// Unaligned store of width consecutive floats
+  #if defined(__wasm_simd128__)
+    wasm_v128_store(destination, source.value);
+  #elif defined(__AVX__)
+    _mm256_storeu_ps(destination, source.value);
+  #elif defined(__SSE2__)
+    _mm_storeu_ps(destination, source.value);
+  #else
+    *destination = source.value;
+  #endif
+}
+
+inline batch broadcast(float const value) noexcept __attribute__((__always_inline__));
+inline batch broadcast(float const value) noexcept {
+  /// Set all lanes to the same value
+  #if defined(__wasm_simd128__)
+    return {wasm_f32x4_splat(value)};
+  #elif defined(__AVX__)
+    return {_mm256_set1_ps(value)};
+  #elif defined(__SSE2__)
+    return {_mm_set1_ps(value)};
+  #else
+    return {value};
+  #endif
+}
+
+inline batch operator+(batch const lhs, batch const rhs) noexcept __attribute__((__always_inline__));
+inline batch operator+(batch const lhs, batch const rhs) noexcept {
+  #if defined(__wasm_simd128__)
+    return {wasm_f32x4_add(lhs.value, rhs.value)};
+  #elif defined(__AVX__)
+    return {_mm256_add_ps(lhs.value, rhs.value)};
+  #elif defined(__SSE2__)
+    return {_mm_add_ps(lhs.value, rhs.value)};
+  #else
+    return {lhs.value + rhs.value};
+  #endif
+}
+
+inline batch operator-(batch const lhs, batch const rhs) noexcept __attribute__((__always_inline__));
+inline batch operator-(batch const lhs, batch const rhs) noexcept {
+  #if defined(__wasm_simd128__)
+    return {wasm_f32x4_sub(lhs.value, rhs.value)};
+  #elif defined(__AVX__)
+    return {_mm256_sub_ps(lhs.value, rhs.value)};
+  #elif defined(__SSE2__)
+    return {_mm_sub_ps(lhs.value, rhs.value)};
+  #else
+    return {lhs.value - rhs.value};
+  #endif
+}
+
+inline batch operator*(batch const lhs, batch const rhs) noexcept __attribute__((__always_inline__));
+inline batch operator*(batch const lhs, batch const rhs) noexcept {
+  #if defined(__wasm_simd128__)
+    return {wasm_f32x4_mul(lhs.value, rhs.value)};
+  #elif defined(__AVX__)
+    return {_mm256_mul_ps(lhs.value, rhs.value)};
+  #elif defined(__SSE2__)
+    return {_mm_mul_ps(lhs.value, rhs.value)};
+  #else
+    return {lhs.value * rhs.value};
+  #endif
+}
+
+inline batch multiply_add(batch const lhs, batch const rhs, batch const addend) noexcept __attribute__((__always_inline__));
+inline batch multiply_add(batch const lhs, batch const rhs, batch const addend) noexcept {
+  /// lhs * rhs + addend - not fused, so results match across all targets
+  return lhs * rhs + addend;
+}
+
+inline batch max(batch const lhs, batch const rhs) noexcept __attribute__((__always_inline__));
+inline batch max(batch const lhs, batch const rhs) noexcept {
+  /// Lane-wise maximum
+  #if defined(__wasm_simd128__)
+    return {wasm_f32x4_pmax(lhs.value, rhs.value)};
+  #elif defined(__AVX__)
+    return {_mm256_max_ps(lhs.value, rhs.value)};
+  #elif defined(__SSE2__)
+    return {_mm_max_ps(lhs.value, rhs.value)};
+  #else
+    return {lhs.value > rhs.value ? lhs.value : rhs.value};
+  #endif
+}
+
+inline batch abs(batch const source) noexcept __attribute__((__always_inline__));
+inline batch abs(batch const source) noexcept {
+  /// Lane-wise absolute value, by clearing the sign bit
+  #if defined(__wasm_simd128__)
+    return {wasm_f32x4_abs(source.value)};
+  #elif defined(__AVX__)
+    return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), source.value)};
+  #elif defined(__SSE2__)
+    return {_mm_andnot_ps(_mm_set1_ps(-0.0f), source.value)};
+  #else
+    return {source.value < 0.0f ? -source.value : source.value};
+  #endif
+}
+
+inline batch floor(batch const source) noexcept __attribute__((__always_inline__));
+inline batch floor(batch const source) noexcept {
+  /// Lane-wise round towards negative infinity - without SSE4.1 this is only valid within the int32 range
+  #if defined(__wasm_simd128__)
+    return {wasm_f32x4_floor(source.value)};
+  #elif defined(__AVX__)
+    return {_mm256_floor_ps(source.value)};
+  #elif defined(__SSE4_1__)
+    return {_mm_floor_ps(source.value)};
+  #elif defined(__SSE2__)
+    __m128 const truncated{_mm_cvtepi32_ps(_mm_cvttps_epi32(source.value))};    // rounds towards zero, so step down where that rounded a negative value up
+    return {_mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, source.value), _mm_set1_ps(1.0f)))};
+  #else
+    return {std::floor(source.value)};
+  #endif
+}
+
+inline uint_batch broadcast_uint(uint32_t const value) noexcept __attribute__((__always_inline__));
+inline uint_batch broadcast_uint(uint32_t const value) noexcept {
+  /// Set all integer lanes to the same value
+  #if defined(__wasm_simd128__)
+    return {wasm_u32x4_splat(value)};
+  #elif defined(__AVX2__)
+    return {_mm256_set1_epi32(static_cast<int32_t>(value))};
+  #elif defined(__AVX__)
+    return {{_mm_set1_epi32(static_cast<int32_t>(value)), _mm_set1_epi32(static_cast<int32_t>(value))}};
+  #elif defined(__SSE2__)
+    return {_mm_set1_epi32(static_cast<int32_t>(value))};
+  #else
+    return {value};
+  #endif
+}
+
+inline uint_batch sequence(uint32_t const start) noexcept __attribute__((__always_inline__));
+inline uint_batch sequence(uint32_t const start) noexcept {
+  /// Consecutive values from start, one per lane, wrapping at 2^32
+  #if defined(__wasm_simd128__)
+    return {wasm_i32x4_add(wasm_u32x4_splat(start), wasm_i32x4_make(0, 1, 2, 3))};
+  #elif defined(__AVX2__)
+    return {_mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(start)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))};
+  #elif defined(__AVX__)
+    return {{_mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(start)), _mm_setr_epi32(0, 1, 2, 3)), _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(start)), _mm_setr_epi32(4, 5, 6, 7))}};
+  #elif defined(__SSE2__)
+    return {_mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(start)), _mm_setr_epi32(0, 1, 2, 3))};
+  #else
+    return {start};
+  #endif
+}
+
+inline uint_batch operator+(uint_batch const lhs, uint_batch const rhs) noexcept __attribute__((__always_inline__));
+inline uint_batch operator+(uint_batch const lhs, uint_batch const rhs) noexcept {
+  /// Lane-wise addition, wrapping at 2^32
+  #if defined(__wasm_simd128__)
+    return {wasm_i32x4_add(lhs.value, rhs.value)};
+  #elif defined(__AVX2__)
+    return {_mm256_add_epi32(lhs.value, rhs.value)};
+  #elif defined(__AVX__)
+    return {{_mm_add_epi32(lhs.value.low, rhs.value.low), _mm_add_epi32(lhs.value.high, rhs.value.high)}};
+  #elif defined(__SSE2__)
+    return {_mm_add_epi32(lhs.value, rhs.value)};
+  #else
+    return {lhs.value + rhs.value};
+  #endif
+}
+
+inline uint_batch operator*(uint_batch const lhs, uint_batch const rhs) noexcept __attribute__((__always_inline__));
+inline uint_batch operator*(uint_batch const lhs, uint_batch const rhs) noexcept {
+  /// Lane-wise multiplication, keeping the low 32 bits
+  #if defined(__wasm_simd128__)
+    return {wasm_i32x4_mul(lhs.value, rhs.value)};
+  #elif defined(__AVX2__)
+    return {_mm256_mullo_epi32(lhs.value, rhs.value)};
+  #elif defined(__AVX__)
+    return {{_mm_mullo_epi32(lhs.value.low, rhs.value.low), _mm_mullo_epi32(lhs.value.high, rhs.value.high)}};
+  #elif defined(__SSE4_1__)
+    return {_mm_mullo_epi32(lhs.value, rhs.value)};
+  #elif defined(__SSE2__)
+    __m128i const even{_mm_mul_epu32(lhs.value, rhs.value)};                    // SSE2 only multiplies lanes 0 and 2 into 64-bit results, so do the odd lanes separately and interleave the low halves
+    __m128i const odd{_mm_mul_epu32(_mm_srli_epi64(lhs.value, 32), _mm_srli_epi64(rhs.value, 32))};
+    return {_mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)))};
+  #else
+    return {lhs.value * rhs.value};
+  #endif
+}
+
+inline uint_batch operator^(uint_batch const lhs, uint_batch const rhs) noexcept __attribute__((__always_inline__));
+inline uint_batch operator^(uint_batch const lhs, uint_batch const rhs) noexcept {
+  #if defined(__wasm_simd128__)
+    return {wasm_v128_xor(lhs.value, rhs.value)};
+  #elif defined(__AVX2__)
+    return {_mm256_xor_si256(lhs.value, rhs.value)};
+  #elif defined(__AVX__)
+    return {{_mm_xor_si128(lhs.value.low, rhs.value.low), _mm_xor_si128(lhs.value.high, rhs.value.high)}};
+  #elif defined(__SSE2__)
+    return {_mm_xor_si128(lhs.value, rhs.value)};
+  #else
+    return {lhs.value ^ rhs.value};
+  #endif
+}
+
+inline uint_batch operator>>(uint_batch const source, int const shift) noexcept __attribute__((__always_inline__));
+inline uint_batch operator>>(uint_batch const source, int const shift) noexcept {
+  /// Lane-wise logical shift right, filling with zeros
+  #if defined(__wasm_simd128__)
+    return {wasm_u32x4_shr(source.value, static_cast<uint32_t>(shift))};
+  #elif defined(__AVX2__)
+    return {_mm256_srli_epi32(source.value, shift)};
+  #elif defined(__AVX__)
+    return {{_mm_srli_epi32(source.value.low, shift), _mm_srli_epi32(source.value.high, shift)}};
+  #elif defined(__SSE2__)
+    return {_mm_srli_epi32(source.value, shift)};
+  #else
+    return {source.value >> shift};
+  #endif
+}
+
+inline uint_batch shift_right_signed(uint_batch const source, int const shift) noexcept __attribute__((__always_inline__));
+inline uint_batch shift_right_signed(uint_batch const source, int const shift) noexcept {
+  /// Lane-wise arithmetic shift right, treating each lane as a signed 32-bit integer and filling with its sign bit
+  #if defined(__wasm_simd128__)
+    return {wasm_i32x4_shr(source.value, static_cast<uint32_t>(shift))};
+  #elif defined(__AVX2__)
+    return {_mm256_srai_epi32(source.value, shift)};
+  #elif defined(__AVX__)
+    return {{_mm_srai_epi32(source.value.low, shift), _mm_srai_epi32(source.value.high, shift)}};
+  #elif defined(__SSE2__)
+    return {_mm_srai_epi32(source.value, shift)};
+  #else
+    return {static_cast<uint32_t>(static_cast<int32_t>(source.value) >> shift)};
+  #endif
+}
+
+inline batch to_float_signed(uint_batch const source) noexcept __attribute__((__always_inline__));
+inline batch to_float_signed(uint_batch const source) noexcept {
+  /// Convert each lane to a float, treating it as a signed 32-bit integer
+  #if defined(__wasm_simd128__)
+    return {wasm_f32x4_convert_i32x4(source.value)};
+  #elif defined(__AVX2__)
+    return {_mm256_cvtepi32_ps(source.value)};
+  #elif defined(__AVX__)
+    return {_mm256_cvtepi32_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(source.value.low), source.value.high, 1))};
+  #elif defined(__SSE2__)
+    return {_mm_cvtepi32_ps(source.value)};
+  #else
+    return {static_cast<float>(static_cast<int32_t>(source.value))};
+  #endif
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+/// Native stand-in for Emscripten's Wasm Workers header, running each worker as a std::thread, so code that owns a worker can be built for native tests and benchmarks
+/// Only the calls the project makes are provided, and each worker runs the one function posted to it
+/// Signatures match Emscripten's, so a pointer posted as an int, as on wasm32, must point into the low 2GB - see emscripten_stub::make_int_addressable()
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+#include <sys/mman.h>
+
+using emscripten_wasm_worker_t = int;
+
+namespace emscripten_stub {
+
+inline std::deque<std::thread> &workers() {
+  /// Every worker created, indexed by id - 1, so 0 stays free to mean no worker
+  static std::deque<std::thread> threads;
+  return threads;
+}
+
+template<typename T>
+struct int_addressable_deleter {
+  void operator()(T *object) const {
+    object->~T();
+    munmap(object, sizeof(T));
+  }
+};
+
+template<typename T, typename... Args>
+std::unique_ptr<T, int_addressable_deleter<T>> make_int_addressable(Args &&...args) {
+  /// Construct an object in the low 2GB of the address space, so its address survives being posted to a worker as an int
+  void *const memory{mmap(nullptr, sizeof(T), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0)};
+  if(memory == MAP_FAILED) throw std::bad_alloc{};
+  return std::unique_ptr<T, int_addressable_deleter<T>>{new(memory) T(std::forward<Args>(args)...)};
+}
+
+}
+
+inline emscripten_wasm_worker_t emscripten_malloc_wasm_worker(size_t /*stack_size*/) {
+  emscripten_stub::workers().emplace_back();
+  return static_cast<emscripten_wasm_worker_t>(emscripten_stub::workers().size());
+}
+
+inline void emscripten_wasm_worker_post_function_vi(emscripten_wasm_worker_t const id, void (*function)(int), int const argument) {
+  emscripten_stub::workers()[static_cast<size_t>(id - 1)] = std::thread{function, argument};
+}
+
+inline void emscripten_wasm_worker_sleep(int64_t const nanoseconds) {
+  std::this_thread::sleep_for(std::chrono::nanoseconds{nanoseconds});
+}
+
+inline void emscripten_terminate_wasm_worker(emscripten_wasm_worker_t const id) {
+  /// Native threads can't be killed, so this waits for the worker's function to return
+  auto &thread{emscripten_stub::workers()[static_cast<size_t>(id - 1)]};
+  if(thread.joinable()) thread.join();
+}
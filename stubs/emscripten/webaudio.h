@@ -0,0 +1,15 @@
+#pragma once
+
+/// Native stand-in for Emscripten's Web Audio header, declaring only the frame types the DSP code reads, so it can be built for native tests and benchmarks
+/// Layouts match emscripten/webaudio.h
+
+struct AudioSampleFrame {
+  int numberOfChannels;
+  int samplesPerChannel;
+  float *data;                                                                  // planar, numberOfChannels * samplesPerChannel samples
+};
+
+struct AudioParamFrame {
+  int length;                                                                   // 1 for a constant value over the quantum, otherwise one value per frame
+  float *data;
+};
@@ -0,0 +1,304 @@
+#define BOOST_TEST_MODULE encoder
+#include <boost/test/included/unit_test.hpp>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "audio/encoder.h"
+
+namespace {
+
+unsigned int constexpr channels{2};
+unsigned int constexpr sample_rate{48'000};
+size_t constexpr frames{sample_rate + 123};                                     // not a whole number of FLAC blocks, so the short final block is covered too
+size_t constexpr silent_frames{5'000};
+
+std::vector<float> render_tone() {
+  /// A second of silence followed by a 440Hz sine, inverted on the right channel
+  std::vector<float> samples(frames * channels);
+  for(size_t frame{silent_frames}; frame != frames; ++frame) {
+    auto const phase{2.0 * std::numbers::pi * 440.0 * static_cast<double>(frame) / sample_rate};
+    auto const value{static_cast<float>(0.5 * std::sin(phase))};
+    samples[frame * channels]     = value;
+    samples[frame * channels + 1] = -value;
+  }
+  return samples;
+}
+
+uint32_t read_le(std::span<uint8_t const> const bytes, size_t const offset, unsigned int const byte_count) {
+  /// Read an unsigned little-endian integer at a byte offset
+  uint32_t value{0};
+  for(unsigned int i{0}; i != byte_count; ++i) {
+    value |= static_cast<uint32_t>(bytes[offset + i]) << (i * 8);
+  }
+  return value;
+}
+
+std::string_view read_tag(std::span<uint8_t const> const bytes, size_t const offset) {
+  /// Read a four-character chunk tag at a byte offset
+  return {reinterpret_cast<char const*>(&bytes[offset]), 4};
+}
+
+void check_dither_bounds(std::span<float const> const samples, std::span<int16_t const> const decoded) {
+  /// Each dithered sample must lie within the triangular dither's +-1 LSB plus rounding of the exact value, and silence must stay within one step of zero
+  BOOST_REQUIRE_EQUAL(decoded.size(), samples.size());
+  double error_sum{0.0};
+  unsigned int nonzero_errors{0};
+  for(size_t i{0}; i != samples.size(); ++i) {
+    double const error{decoded[i] - static_cast<double>(samples[i]) * 32'767.0};
+    BOOST_REQUIRE_LE(std::abs(error), 1.5);
+    if(i < silent_frames * channels) BOOST_REQUIRE_LE(std::abs(decoded[i]), 1);
+    error_sum += error;
+    if(std::abs(error) > 0.5) ++nonzero_errors;
+  }
+  BOOST_CHECK_LT(std::abs(error_sum / static_cast<double>(samples.size())), 0.01); // dither adds no DC offset
+  BOOST_CHECK_GT(nonzero_errors, samples.size() / 10);                          // and is actually applied, rather than plain rounding
+}
+
+class bit_reader {
+  /// Big-endian bitstream reader, the counterpart of the encoder's FLAC bit writer
+  std::span<uint8_t const> bytes;
+  size_t position{0};                                                           // in bits
+
+public:
+  explicit bit_reader(std::span<uint8_t const> const this_bytes, size_t const byte_offset)
+    : bytes{this_bytes},
+      position{byte_offset * 8} {
+  }
+
+  uint32_t read(unsigned int const bits) {
+    /// Read an unsigned value of up to 32 bits, most significant first
+    uint32_t value{0};
+    for(unsigned int i{0}; i != bits; ++i, ++position) {
+      BOOST_REQUIRE_LT(position / 8, bytes.size());
+      value = (value << 1) | ((bytes[position / 8] >> (7 - position % 8)) & 1u);
+    }
+    return value;
+  }
+
+  int32_t read_signed(unsigned int const bits) {
+    /// Read a two's complement signed value
+    uint32_t const value{read(bits)};
+    return static_cast<int32_t>(value << (32 - bits)) >> (32 - bits);
+  }
+
+  uint32_t read_unary() {
+    /// Count zeros up to the terminating one
+    uint32_t zeros{0};
+    while(read(1) == 0) ++zeros;
+    return zeros;
+  }
+
+  void align() {
+    position = (position + 7) / 8 * 8;
+  }
+
+  size_t get_byte_offset() const {
+    return position / 8;
+  }
+};
+
+uint8_t crc8(std::span<uint8_t const> const bytes) {
+  /// FLAC frame header CRC, computed independently of the encoder's
+  uint8_t crc{0};
+  for(auto const byte : bytes) {
+    crc ^= byte;
+    for(unsigned int bit{0}; bit != 8; ++bit) {
+      crc = static_cast<uint8_t>((crc & 0x80u) ? (crc << 1) ^ 0x07u : crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint16_t crc16(std::span<uint8_t const> const bytes) {
+  /// FLAC frame CRC, computed independently of the encoder's
+  uint16_t crc{0};
+  for(auto const byte : bytes) {
+    crc ^= static_cast<uint16_t>(byte << 8);
+    for(unsigned int bit{0}; bit != 8; ++bit) {
+      crc = static_cast<uint16_t>((crc & 0x80'00u) ? (crc << 1) ^ 0x80'05u : crc << 1);
+    }
+  }
+  return crc;
+}
+
+std::vector<int16_t> decode_flac(std::span<uint8_t const> const bytes) {
+  /// Decode the subset of FLAC the encoder produces - constant, verbatim and fixed-predictor subframes with a single Rice partition - back to interleaved samples, checking every header field and CRC on the way
+  BOOST_REQUIRE_GE(bytes.size(), 42u);
+  BOOST_REQUIRE_EQUAL(read_tag(bytes, 0), "fLaC");
+
+  bit_reader reader{bytes, 4};
+  BOOST_CHECK_EQUAL(reader.read(1), 1u);                                        // last metadata block
+  BOOST_CHECK_EQUAL(reader.read(7), 0u);                                        // STREAMINFO
+  BOOST_CHECK_EQUAL(reader.read(24), 34u);
+  uint32_t const block_size{reader.read(16)};
+  BOOST_CHECK_EQUAL(reader.read(16), block_size);
+  reader.read(48);                                                              // frame sizes
+  BOOST_CHECK_EQUAL(reader.read(20), sample_rate);
+  BOOST_CHECK_EQUAL(reader.read(3) + 1, channels);
+  BOOST_CHECK_EQUAL(reader.read(5) + 1, 16u);
+  BOOST_CHECK_EQUAL(reader.read(4), 0u);
+  BOOST_CHECK_EQUAL(reader.read(32), frames);
+  reader.read(32);                                                              // MD5 signature
+  reader.read(32);
+  reader.read(32);
+  reader.read(32);
+
+  std::vector<int16_t> samples;
+  std::vector<int32_t> channel_samples;
+  for(uint32_t frame_number{0}; reader.get_byte_offset() != bytes.size(); ++frame_number) {
+    size_t const frame_start{reader.get_byte_offset()};
+    BOOST_REQUIRE_EQUAL(reader.read(14), 0b11'1111'1111'1110u);                 // sync code
+    BOOST_CHECK_EQUAL(reader.read(2), 0u);                                      // reserved, fixed blocksize
+    BOOST_CHECK_EQUAL(reader.read(4), 0b0111u);                                 // 16-bit block size at the end of the header
+    BOOST_CHECK_EQUAL(reader.read(4), 0u);                                      // sample rate from STREAMINFO
+    BOOST_CHECK_EQUAL(reader.read(4) + 1, channels);
+    BOOST_CHECK_EQUAL(reader.read(3), 0b100u);                                  // 16 bits per sample
+    BOOST_CHECK_EQUAL(reader.read(1), 0u);
+    uint32_t coded_number{reader.read(8)};
+    if(coded_number >= 0x80u) {                                                 // extended UTF-8 style: leading ones count the bytes
+      unsigned int continuation_bytes{0};
+      while(coded_number & (0x40u >> continuation_bytes)) ++continuation_bytes;
+      coded_number &= 0x3Fu >> continuation_bytes;
+      for(unsigned int i{0}; i != continuation_bytes; ++i) {
+        coded_number = (coded_number << 6) | (reader.read(8) & 0x3Fu);
+      }
+    }
+    BOOST_CHECK_EQUAL(coded_number, frame_number);
+    uint32_t const samples_in_block{reader.read(16) + 1};
+    BOOST_REQUIRE_LE(samples_in_block, block_size);
+    auto const header_crc{crc8(bytes.subspan(frame_start, reader.get_byte_offset() - frame_start))};
+    BOOST_CHECK_EQUAL(reader.read(8), header_crc);
+
+    size_t const block_start{samples.size()};
+    samples.resize(block_start + samples_in_block * channels);
+    channel_samples.resize(samples_in_block);
+    for(unsigned int channel{0}; channel != channels; ++channel) {
+      BOOST_REQUIRE_EQUAL(reader.read(1), 0u);                                  // zero padding
+      uint32_t const type{reader.read(6)};
+      BOOST_REQUIRE_EQUAL(reader.read(1), 0u);                                  // no wasted bits
+      if(type == 0b000000) {                                                    // constant
+        std::fill(channel_samples.begin(), channel_samples.end(), reader.read_signed(16));
+      } else if(type == 0b000001) {                                             // verbatim
+        for(auto &sample : channel_samples) {
+          sample = reader.read_signed(16);
+        }
+      } else {
+        BOOST_REQUIRE_EQUAL(type & ~0b111u, 0b001000u);                         // fixed predictor
+        unsigned int const order{type & 0b111u};
+        BOOST_REQUIRE_LE(order, 4u);
+        for(unsigned int i{0}; i != order; ++i) {
+          channel_samples[i] = reader.read_signed(16);
+        }
+        BOOST_REQUIRE_EQUAL(reader.read(2), 0u);                                // Rice with 4-bit parameters
+        BOOST_REQUIRE_EQUAL(reader.read(4), 0u);                                // a single partition
+        unsigned int const parameter{reader.read(4)};
+        for(size_t i{order}; i != samples_in_block; ++i) {
+          uint32_t const folded{(reader.read_unary() << parameter) | reader.read(parameter)};
+          auto const residual{static_cast<int32_t>(folded >> 1) ^ -static_cast<int32_t>(folded & 1u)};
+          auto const &s{channel_samples};
+          int32_t prediction{0};
+          switch(order) {
+          case 0:
+            break;
+          case 1:
+            prediction = s[i - 1];
+            break;
+          case 2:
+            prediction = 2 * s[i - 1] - s[i - 2];
+            break;
+          case 3:
+            prediction = 3 * s[i - 1] - 3 * s[i - 2] + s[i - 3];
+            break;
+          default:
+            prediction = 4 * s[i - 1] - 6 * s[i - 2] + 4 * s[i - 3] - s[i - 4];
+            break;
+          }
+          channel_samples[i] = prediction + residual;
+        }
+      }
+      for(size_t i{0}; i != samples_in_block; ++i) {
+        BOOST_REQUIRE(channel_samples[i] >= -32'768 && channel_samples[i] <= 32'767);
+        samples[block_start + i * channels + channel] = static_cast<int16_t>(channel_samples[i]);
+      }
+    }
+
+    reader.align();
+    auto const frame_crc{crc16(bytes.subspan(frame_start, reader.get_byte_offset() - frame_start))};
+    BOOST_CHECK_EQUAL(reader.read(16), frame_crc);
+  }
+  return samples;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(wav_float32_is_bit_exact) {
+  auto const samples{render_tone()};
+  auto const bytes{audio::encoder::wav(samples, channels, sample_rate, audio::encoder::sample_formats::float32)};
+  size_t constexpr header_size{12 + 8 + 18 + 12 + 8};
+  size_t const data_size{samples.size() * sizeof(float)};
+  BOOST_REQUIRE_EQUAL(bytes.size(), header_size + data_size);
+
+  BOOST_CHECK_EQUAL(read_tag(bytes, 0), "RIFF");
+  BOOST_CHECK_EQUAL(read_le(bytes, 4, 4), bytes.size() - 8);
+  BOOST_CHECK_EQUAL(read_tag(bytes, 8), "WAVE");
+  BOOST_CHECK_EQUAL(read_tag(bytes, 12), "fmt ");
+  BOOST_CHECK_EQUAL(read_le(bytes, 16, 4), 18u);
+  BOOST_CHECK_EQUAL(read_le(bytes, 20, 2), 3u);                                 // WAVE_FORMAT_IEEE_FLOAT
+  BOOST_CHECK_EQUAL(read_le(bytes, 22, 2), channels);
+  BOOST_CHECK_EQUAL(read_le(bytes, 24, 4), sample_rate);
+  BOOST_CHECK_EQUAL(read_le(bytes, 28, 4), sample_rate * channels * 4);
+  BOOST_CHECK_EQUAL(read_le(bytes, 32, 2), channels * 4);
+  BOOST_CHECK_EQUAL(read_le(bytes, 34, 2), 32u);
+  BOOST_CHECK_EQUAL(read_le(bytes, 36, 2), 0u);
+  BOOST_CHECK_EQUAL(read_tag(bytes, 38), "fact");
+  BOOST_CHECK_EQUAL(read_le(bytes, 42, 4), 4u);
+  BOOST_CHECK_EQUAL(read_le(bytes, 46, 4), frames);
+  BOOST_CHECK_EQUAL(read_tag(bytes, 50), "data");
+  BOOST_CHECK_EQUAL(read_le(bytes, 54, 4), data_size);
+  BOOST_CHECK(std::memcmp(&bytes[header_size], samples.data(), data_size) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(wav_pcm16_is_dithered_within_bounds) {
+  auto const samples{render_tone()};
+  auto const bytes{audio::encoder::wav(samples, channels, sample_rate, audio::encoder::sample_formats::pcm16)};
+  size_t constexpr header_size{12 + 8 + 16 + 8};
+  size_t const data_size{samples.size() * sizeof(int16_t)};
+  BOOST_REQUIRE_EQUAL(bytes.size(), header_size + data_size);
+
+  BOOST_CHECK_EQUAL(read_tag(bytes, 0), "RIFF");
+  BOOST_CHECK_EQUAL(read_le(bytes, 4, 4), bytes.size() - 8);
+  BOOST_CHECK_EQUAL(read_tag(bytes, 8), "WAVE");
+  BOOST_CHECK_EQUAL(read_tag(bytes, 12), "fmt ");
+  BOOST_CHECK_EQUAL(read_le(bytes, 16, 4), 16u);
+  BOOST_CHECK_EQUAL(read_le(bytes, 20, 2), 1u);                                 // WAVE_FORMAT_PCM
+  BOOST_CHECK_EQUAL(read_le(bytes, 22, 2), channels);
+  BOOST_CHECK_EQUAL(read_le(bytes, 24, 4), sample_rate);
+  BOOST_CHECK_EQUAL(read_le(bytes, 28, 4), sample_rate * channels * 2);
+  BOOST_CHECK_EQUAL(read_le(bytes, 32, 2), channels * 2);
+  BOOST_CHECK_EQUAL(read_le(bytes, 34, 2), 16u);
+  BOOST_CHECK_EQUAL(read_tag(bytes, 36), "data");
+  BOOST_CHECK_EQUAL(read_le(bytes, 40, 4), data_size);
+
+  std::vector<int16_t> decoded(samples.size());
+  for(size_t i{0}; i != decoded.size(); ++i) {
+    decoded[i] = static_cast<int16_t>(read_le(bytes, header_size + i * 2, 2));
+  }
+  check_dither_bounds(samples, decoded);
+}
+
+BOOST_AUTO_TEST_CASE(flac_decodes_to_the_dithered_pcm16) {
+  auto const samples{render_tone()};
+  auto const bytes{audio::encoder::flac(samples, channels, sample_rate)};
+  BOOST_CHECK_LT(bytes.size(), samples.size() * sizeof(int16_t) / 2);           // a pure tone compresses well
+  auto const decoded{decode_flac(bytes)};
+  check_dither_bounds(samples, decoded);
+
+  auto const wav_bytes{audio::encoder::wav(samples, channels, sample_rate, audio::encoder::sample_formats::pcm16)};
+  size_t constexpr wav_header_size{12 + 8 + 16 + 8};
+  for(size_t i{0}; i != decoded.size(); ++i) {                                  // both formats share the same seeded dither, so they agree exactly
+    BOOST_REQUIRE_EQUAL(decoded[i], static_cast<int16_t>(read_le(wav_bytes, wav_header_size + i * 2, 2)));
+  }
+}
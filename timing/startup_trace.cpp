@@ -0,0 +1,33 @@
+#include "startup_trace.h"
+#include <iomanip>
+#include "logstorm/logstorm.h"
+
+namespace timing {
+
+startup_trace::startup_trace(logstorm::manager &this_logger)
+  : logger{this_logger} {
+  /// Begin a startup trace, taking the current time as the origin
+  phases.reserve(16);
+}
+
+void startup_trace::mark(std::string_view const name) {
+  /// Record the completion of a named startup phase, and log its timing
+  /// Phases from independent asynchronous subsystems interleave in the order they actually complete
+  clock::time_point const now{clock::now()};
+  auto const &current_phase{phases.emplace_back(phase{
+    .name{std::string{name}},
+    .since_start{now - start_time},
+    .since_previous{now - previous_time},
+  })};
+  previous_time = now;
+
+  logger << "Startup: " << std::fixed << std::setprecision(1) << std::setw(7) << current_phase.since_start.count() << "ms"
+         << " (+" << current_phase.since_previous.count() << "ms) "
+         << current_phase.name;
+}
+
+std::vector<startup_trace::phase> const &startup_trace::get_phases() const {
+  return phases;
+}
+
+}
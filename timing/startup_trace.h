@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "logstorm/logstorm_forward.h"
+
+namespace timing {
+
+class startup_trace {
+  logstorm::manager &logger;
+
+public:
+  using clock = std::chrono::steady_clock;
+  using duration = std::chrono::duration<float, std::milli>;
+
+  struct phase {
+    std::string name;                                                           // human-readable name of the completed phase, prefixed by subsystem
+    duration since_start{};                                                     // time from trace construction to completion of this phase
+    duration since_previous{};                                                  // time from the previously completed phase to this one
+  };
+
+private:
+  clock::time_point const start_time{clock::now()};                             // trace origin, as early as possible in application startup
+  clock::time_point previous_time{start_time};
+  std::vector<phase> phases;
+
+public:
+  startup_trace(logstorm::manager &logger);
+
+  void mark(std::string_view name);
+
+  std::vector<phase> const &get_phases() const;
+};
+
+}